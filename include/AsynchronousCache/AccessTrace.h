@@ -0,0 +1,340 @@
+/** @file *//********************************************************************************************************
+
+                                                    AccessTrace.h
+
+                                            Copyright 2006, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/AsynchronousCache/AccessTrace.h#1 $
+
+    $NoKeywords: $
+
+********************************************************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+//! Calls recorded in an access trace
+enum AccessOp
+{
+    ACCESS_REQUEST,             //!< Request(key)
+    ACCESS_REQUEST_DEADLINE,    //!< Request(key, deadline)
+    ACCESS_PREFETCH,            //!< Prefetch(key)
+    ACCESS_GET,                 //!< Get(key)
+    ACCESS_RELEASE,             //!< Release(key, forceEviction)
+    ACCESS_RELEASE_POINTER,     //!< Release(pElement, forceEviction). The key of the element is recorded.
+    ACCESS_CLEAR,               //!< Clear()
+    ACCESS_UPDATE,              //!< Update()
+    ACCESS_OP_COUNT             //!< Number of operations
+};
+
+//! A call recorded in an access trace
+struct AccessRecord
+{
+    //! Flags of a record
+    enum
+    {
+        FLAG_RESULT = 1,        //!< The call succeeded (Request and Prefetch) or returned an element (Get)
+        FLAG_FORCE  = 2         //!< The element was released with forced eviction
+    };
+
+    AccessOp op;                //!< The call
+    std::uint64_t time;         //!< When the call was made, in nanoseconds since the trace started
+    unsigned flags;             //!< Flags
+    std::string key;            //!< Bytes of the key, as encoded by AccessKeyCodec (empty for Clear() and Update())
+    std::uint64_t size;         //!< Size of the element as returned by SizeOf() (Request and Prefetch only)
+    std::uint64_t deadline;     //!< Nanoseconds from the call to the deadline (ACCESS_REQUEST_DEADLINE only)
+};
+
+//! Encodes the keys recorded in an access trace.
+//!
+//! The default encoding is the bytes of the key, so it requires a trivially copyable key. Specialize this class to
+//! record other types of keys. Lookups with other types (see AsynchronousCache) are converted to keys first.
+
+template <typename Key>
+struct AccessKeyCodec
+{
+    //! Appends the bytes of a key to a string
+    template <typename K>
+    static void Encode(K const & key, std::string & bytes)
+    {
+        static_assert(std::is_trivially_copyable<Key>::value, "Specialize AccessKeyCodec to record this key type");
+        Key const & k = key;
+        bytes.append(reinterpret_cast<char const *>(&k), sizeof(k));
+    }
+};
+
+//! Encodes the keys recorded in an access trace. A string is recorded as its characters.
+
+template <typename Char, typename Traits, typename Allocator>
+struct AccessKeyCodec<std::basic_string<Char, Traits, Allocator>>
+{
+    //! Appends the bytes of a key to a string
+    template <typename K>
+    static void Encode(K const & key, std::string & bytes)
+    {
+        std::basic_string_view<Char, Traits> k(key);
+        bytes.append(reinterpret_cast<char const *>(k.data()), k.size() * sizeof(Char));
+    }
+};
+
+//! Writes an access trace to a file.
+//!
+//! The trace is compact: a header, followed by one record per call. Each record is the operation (1 byte), the
+//! time since the previous record, the flags (1 byte), and for operations with a key, the length and bytes of the
+//! key, and then the size and deadline if the operation has them. Numbers are variable-length (7 bits per byte,
+//! least significant first), so most records take only a few bytes more than their keys.
+//!
+//! @note	This class cannot be copied or assigned. It is not thread-safe.
+
+class AccessTraceWriter
+{
+public:
+
+    //! Constructor. The file is not owned.
+    explicit AccessTraceWriter(std::FILE * pFile);
+
+    AccessTraceWriter(AccessTraceWriter const &) = delete;              // Prevent copying
+    AccessTraceWriter & operator =(AccessTraceWriter const &) = delete; // Prevent assignment
+
+    //! Writes a record
+    void Write(AccessOp op,
+               unsigned flags,
+               std::string const & key,
+               std::uint64_t size     = 0,
+               std::uint64_t deadline = 0);
+
+    //! Returns the number of nanoseconds since the trace started
+    std::uint64_t Now() const;
+
+    //! Returns false if a write has failed
+    bool IsGood() const { return m_good; }
+
+private:
+
+    // Appends a variable-length number
+    void PutNumber(std::uint64_t value);
+
+    std::FILE * m_pFile;                            // The file
+    std::chrono::steady_clock::time_point m_start;  // When the trace started
+    std::uint64_t m_last;                           // Time of the last record
+    std::string m_buffer;                           // The record being written
+    bool m_good;                                    // False if a write has failed
+};
+
+//! Reads an access trace written by AccessTraceWriter.
+//!
+//! @note	This class cannot be copied or assigned.
+
+class AccessTraceReader
+{
+public:
+
+    //! Constructor. The file is not owned.
+    explicit AccessTraceReader(std::FILE * pFile);
+
+    AccessTraceReader(AccessTraceReader const &) = delete;              // Prevent copying
+    AccessTraceReader & operator =(AccessTraceReader const &) = delete; // Prevent assignment
+
+    //! Reads the next record. Returns false at the end of the trace or if the trace is corrupt.
+    bool Read(AccessRecord & record);
+
+    //! Returns false if the header or a record is corrupt
+    bool IsGood() const { return m_good; }
+
+private:
+
+    // Reads a variable-length number
+    bool GetNumber(std::uint64_t & value);
+
+    // Appends bytes to a string
+    bool GetBytes(std::uint64_t length, std::string & bytes);
+
+    std::FILE * m_pFile;    // The file
+    std::uint64_t m_time;   // Time of the last record
+    bool m_good;            // False if the trace is corrupt
+};
+
+static char const ACCESS_TRACE_MAGIC[8] = { 'A', 'C', 'T', 'R', 'A', 'C', 'E', '1' }; //!< First bytes of a trace
+
+//! @param	pFile	The file to write to. The header is written immediately.
+
+inline AccessTraceWriter::AccessTraceWriter(std::FILE * pFile)
+    : m_pFile(pFile),
+    m_start(std::chrono::steady_clock::now()),
+    m_last(0),
+    m_good(true)
+{
+    m_good = std::fwrite(ACCESS_TRACE_MAGIC, 1, sizeof(ACCESS_TRACE_MAGIC), m_pFile) == sizeof(ACCESS_TRACE_MAGIC);
+}
+
+//! @param	op			The call
+//! @param	flags		Flags (see AccessRecord)
+//! @param	key			Bytes of the key (ignored for Clear() and Update())
+//! @param	size		Size of the element (Request and Prefetch only)
+//! @param	deadline	Nanoseconds from the call to the deadline (ACCESS_REQUEST_DEADLINE only)
+
+inline void AccessTraceWriter::Write(AccessOp op,
+                                     unsigned flags,
+                                     std::string const & key,
+                                     std::uint64_t size /* = 0*/,
+                                     std::uint64_t deadline /* = 0*/)
+{
+    std::uint64_t now = Now();
+
+    m_buffer.clear();
+    m_buffer.push_back((char)op);
+    PutNumber(now - m_last);
+    m_buffer.push_back((char)flags);
+    if (op != ACCESS_CLEAR && op != ACCESS_UPDATE)
+    {
+        PutNumber(key.size());
+        m_buffer.append(key);
+    }
+    if (op == ACCESS_REQUEST || op == ACCESS_REQUEST_DEADLINE || op == ACCESS_PREFETCH)
+    {
+        PutNumber(size);
+    }
+    if (op == ACCESS_REQUEST_DEADLINE)
+    {
+        PutNumber(deadline);
+    }
+    m_last = now;
+
+    if (std::fwrite(m_buffer.data(), 1, m_buffer.size(), m_pFile) != m_buffer.size())
+    {
+        m_good = false;
+    }
+}
+
+inline std::uint64_t AccessTraceWriter::Now() const
+{
+    return (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                                                                               m_start).count();
+}
+
+inline void AccessTraceWriter::PutNumber(std::uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        m_buffer.push_back((char)(value | 0x80));
+        value >>= 7;
+    }
+    m_buffer.push_back((char)value);
+}
+
+//! @param	pFile	The file to read from. The header is read immediately.
+
+inline AccessTraceReader::AccessTraceReader(std::FILE * pFile)
+    : m_pFile(pFile),
+    m_time(0)
+{
+    char magic[sizeof(ACCESS_TRACE_MAGIC)];
+    m_good = std::fread(magic, 1, sizeof(magic), m_pFile) == sizeof(magic) &&
+             std::memcmp(magic, ACCESS_TRACE_MAGIC, sizeof(magic)) == 0;
+}
+
+//! @param	record	Receives the record
+
+inline bool AccessTraceReader::Read(AccessRecord & record)
+{
+    if (!m_good)
+    {
+        return false;
+    }
+
+    int op = std::fgetc(m_pFile);
+    if (op == EOF)
+    {
+        return false;   // The end of the trace
+    }
+
+    // A record that is cut off or has an unknown operation means the trace is corrupt
+
+    m_good = false;
+
+    std::uint64_t delta;
+    int           flags;
+    if (op >= ACCESS_OP_COUNT || !GetNumber(delta) || (flags = std::fgetc(m_pFile)) == EOF)
+    {
+        return false;
+    }
+
+    record.op       = (AccessOp)op;
+    record.time     = m_time += delta;
+    record.flags    = (unsigned)flags;
+    record.size     = 0;
+    record.deadline = 0;
+    record.key.clear();
+
+    if (op != ACCESS_CLEAR && op != ACCESS_UPDATE)
+    {
+        std::uint64_t length;
+        if (!GetNumber(length))
+        {
+            return false;
+        }
+        if (!GetBytes(length, record.key))
+        {
+            return false;
+        }
+    }
+    if ((op == ACCESS_REQUEST || op == ACCESS_REQUEST_DEADLINE || op == ACCESS_PREFETCH) && !GetNumber(record.size))
+    {
+        return false;
+    }
+    if (op == ACCESS_REQUEST_DEADLINE && !GetNumber(record.deadline))
+    {
+        return false;
+    }
+
+    m_good = true;
+    return true;
+}
+
+inline bool AccessTraceReader::GetNumber(std::uint64_t & value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        int c = std::fgetc(m_pFile);
+        if (c == EOF)
+        {
+            return false;
+        }
+        value |= (std::uint64_t)(c & 0x7f) << shift;
+        if ((c & 0x80) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The bytes are read in chunks, so a corrupt length fails at the end of the file instead of allocating the length up
+// front.
+
+inline bool AccessTraceReader::GetBytes(std::uint64_t length, std::string & bytes)
+{
+    char chunk[4096];
+    while (length > 0)
+    {
+        std::size_t n = (std::size_t)std::min<std::uint64_t>(length, sizeof(chunk));
+        if (std::fread(chunk, 1, n, m_pFile) != n)
+        {
+            return false;
+        }
+        bytes.append(chunk, n);
+        length -= n;
+    }
+    return true;
+}
@@ -0,0 +1,257 @@
+/** @file *//********************************************************************************************************
+
+                                                       Arena.h
+
+                                            Copyright 2006, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/AsynchronousCache/Arena.h#1 $
+
+    $NoKeywords: $
+
+********************************************************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <new>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+//! Kinds of pages backing an arena
+enum PageKind
+{
+    PAGE_UNKNOWN,           //!< Not known (e.g. the memory comes from the heap)
+    PAGE_NORMAL,            //!< Normal pages
+    PAGE_TRANSPARENT_HUGE,  //!< Normal pages, which the kernel may back with transparent huge pages
+    PAGE_HUGE_TLB           //!< Explicit huge pages (MAP_HUGETLB)
+};
+
+//! A block of memory allocated from the heap.
+//!
+//! An arena is the memory managed by a storage allocator (see SlabAllocator). This arena gets its memory from the
+//! global heap.
+//!
+//! @note	This class cannot be copied or assigned.
+
+class HeapArena
+{
+public:
+
+    //! Constructor
+    explicit HeapArena(std::size_t size)
+        : m_pMemory(::operator new(size)),
+        m_size(size)
+    {
+    }
+
+    //! Destructor
+    ~HeapArena()
+    {
+        ::operator delete(m_pMemory);
+    }
+
+    HeapArena(HeapArena const &) = delete;              // Prevent copying
+    HeapArena & operator =(HeapArena const &) = delete; // Prevent assignment
+
+    //! Returns the address of the memory
+    void * GetMemory() const { return m_pMemory; }
+
+    //! Returns the size of the memory
+    std::size_t GetSize() const { return m_size; }
+
+    //! Returns the size of the pages backing the memory. The heap does not say, so this function returns 0.
+    std::size_t GetPageSize() const { return 0; }
+
+    //! Returns the kind of pages backing the memory. The heap does not say, so this function returns PAGE_UNKNOWN.
+    PageKind GetPageKind() const { return PAGE_UNKNOWN; }
+
+private:
+
+    void * m_pMemory;       // The memory
+    std::size_t m_size;     // Size of the memory
+};
+
+//! A block of memory backed by huge pages, if possible.
+//!
+//! Large element storage accessed at random suffers from TLB misses. This arena reduces them by mapping its memory
+//! with huge pages. It first tries explicit huge pages (MAP_HUGETLB), which must have been reserved by the system
+//! administrator. If there are not enough, it maps normal pages and asks for transparent huge pages (MADV_HUGEPAGE).
+//! If transparent huge pages are disabled, the memory is backed by normal pages. GetPageSize() and GetPageKind()
+//! return the size and kind of the pages actually used. The storage allocators and StorageCache pass them on, so
+//! they can be reported with the cache's metrics (see PrometheusExporter).
+//!
+//! Transparent huge pages are assembled by the kernel when it can, so memory backed by them may still be partly
+//! backed by normal pages. On systems other than Linux, the memory comes from the heap and the page size is unknown.
+//!
+//! @note	This class cannot be copied or assigned.
+
+class HugePageArena
+{
+public:
+
+    //! Constructor
+    explicit HugePageArena(std::size_t size);
+
+    //! Destructor
+    ~HugePageArena();
+
+    HugePageArena(HugePageArena const &) = delete;              // Prevent copying
+    HugePageArena & operator =(HugePageArena const &) = delete; // Prevent assignment
+
+    //! Returns the address of the memory
+    void * GetMemory() const { return m_pMemory; }
+
+    //! Returns the size of the memory
+    std::size_t GetSize() const { return m_size; }
+
+    //! Returns the size of the pages backing the memory, or 0 if it is not known
+    std::size_t GetPageSize() const { return m_pageSize; }
+
+    //! Returns true if the memory is backed by explicit (reserved) huge pages
+    bool IsHugeTlb() const { return m_hugeTlb; }
+
+    //! Returns the kind of pages backing the memory
+    PageKind GetPageKind() const { return m_pageKind; }
+
+private:
+
+    // Returns the size of a huge page, or 0 if huge pages are not supported
+    static std::size_t HugePageSize();
+
+    // Returns true if transparent huge pages may be used for memory that asks for them
+    static bool TransparentHugePagesEnabled();
+
+    void * m_pMemory;           // The memory
+    std::size_t m_size;         // Size of the memory
+    std::size_t m_mappedSize;   // Size of the mapping (a multiple of the page size)
+    std::size_t m_pageSize;     // Size of the pages backing the memory
+    bool m_hugeTlb;             // True if the memory is mapped with MAP_HUGETLB
+    PageKind m_pageKind;        // Kind of the pages backing the memory
+};
+
+//! @param	size	Size of the memory. The memory actually mapped is rounded up to a multiple of the page size.
+//!
+//! @throw	std::bad_alloc	The memory cannot be mapped
+
+inline HugePageArena::HugePageArena(std::size_t size)
+    : m_pMemory(0),
+    m_size(size),
+    m_mappedSize(0),
+    m_pageSize(0),
+    m_hugeTlb(false),
+    m_pageKind(PAGE_UNKNOWN)
+{
+#if defined(__linux__)
+    std::size_t hugePageSize = HugePageSize();
+    std::size_t pageSize     = (std::size_t)sysconf(_SC_PAGESIZE);
+
+    // Try explicit huge pages first
+
+    if (hugePageSize > 0)
+    {
+        m_mappedSize = (size + hugePageSize - 1) / hugePageSize * hugePageSize;
+        void * p     = mmap(0, m_mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED)
+        {
+            m_pMemory  = p;
+            m_pageSize = hugePageSize;
+            m_hugeTlb  = true;
+            m_pageKind = PAGE_HUGE_TLB;
+            return;
+        }
+    }
+
+    // Otherwise, map normal pages and ask for transparent huge pages. The mapping is aligned to a huge page so that
+    // the kernel can back all of it with huge pages.
+
+    std::size_t alignment = (hugePageSize > 0) ? hugePageSize : pageSize;
+    m_mappedSize = (size + alignment - 1) / alignment * alignment;
+
+    std::size_t reserved = m_mappedSize + alignment - pageSize;
+    void *      p        = mmap(0, reserved, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+    {
+        throw std::bad_alloc();
+    }
+
+    char * pBegin   = static_cast<char *>(p);
+    char * pAligned = pBegin + (alignment - (std::size_t)pBegin % alignment) % alignment;
+    if (pAligned > pBegin)
+    {
+        munmap(pBegin, pAligned - pBegin);
+    }
+    if (pBegin + reserved > pAligned + m_mappedSize)
+    {
+        munmap(pAligned + m_mappedSize, pBegin + reserved - (pAligned + m_mappedSize));
+    }
+    m_pMemory = pAligned;
+
+    if (hugePageSize > 0 && TransparentHugePagesEnabled() && madvise(m_pMemory, m_mappedSize, MADV_HUGEPAGE) == 0)
+    {
+        m_pageSize = hugePageSize;
+        m_pageKind = PAGE_TRANSPARENT_HUGE;
+    }
+    else
+    {
+        m_pageSize = pageSize;
+        m_pageKind = PAGE_NORMAL;
+    }
+#else
+    m_pMemory    = ::operator new(size);
+    m_mappedSize = size;
+#endif
+}
+
+inline HugePageArena::~HugePageArena()
+{
+#if defined(__linux__)
+    munmap(m_pMemory, m_mappedSize);
+#else
+    ::operator delete(m_pMemory);
+#endif
+}
+
+inline std::size_t HugePageArena::HugePageSize()
+{
+    std::size_t size = 0;
+#if defined(__linux__)
+    if (std::FILE * pFile = std::fopen("/proc/meminfo", "r"))
+    {
+        char line[256];
+        while (std::fgets(line, sizeof(line), pFile))
+        {
+            unsigned long kb;
+            if (std::sscanf(line, "Hugepagesize: %lu kB", &kb) == 1)
+            {
+                size = (std::size_t)kb * 1024;
+                break;
+            }
+        }
+        std::fclose(pFile);
+    }
+#endif
+    return size;
+}
+
+inline bool HugePageArena::TransparentHugePagesEnabled()
+{
+    bool enabled = false;
+#if defined(__linux__)
+    if (std::FILE * pFile = std::fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r"))
+    {
+        char line[256];
+        if (std::fgets(line, sizeof(line), pFile))
+        {
+            enabled = (std::strstr(line, "[never]") == 0);
+        }
+        std::fclose(pFile);
+    }
+#endif
+    return enabled;
+}
@@ -13,16 +13,35 @@
 
 #pragma once
 
+#include "KeyHash.h"
+#include "LatencyHistogram.h"
+#include "MissRatioEstimator.h"
+#include "PrefetchPredictor.h"
+#include "Tracer.h"
+
 #include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <functional>
 #include <list>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 //! Asynchronous Cache.
 //!
 //! @param	Element     Type of the elements stored in the cache
 //! @param	Key         Type of a key for accessing an element in the cache
-//!						KeyType must implement operator==().
+//!						KeyType must implement operator==(). It may be move-only.
 //! @param	Handle      Type of an element handle. This is the type of the value returned by Load().
 //!						The default type is <tt>void *</tt>.
+//! @param	Hash        Hash function for keys. The default is KeyHash. Looking up an element with a value of another
+//!						type requires a transparent hash function (one with a member type named @c is_transparent),
+//!						which hashes the value the same as the equal key.
+//! @param	Tracer      Receives an event on every change of state of an entry (see NullTracer). The default is
+//!						NullTracer, which compiles away entirely.
 //!
 //! @note	This class is an abstract base class and must be derived from in order to be used.
 //! @note	This class (and any derived from it) cannot be copied or assigned.
@@ -35,6 +54,27 @@
 //!		- A request may fail if there is not enough room in the cache.
 //!		- An element may be "prefetched". A prefetched element is loaded and immediately released so that it is
 //!			in the cache, but it must still be requested.
+//!		- The number of concurrent loads and the load bandwidth may be limited. Loads that exceed the limits wait
+//!			in a queue until Update() starts them, earliest deadline first. A request may specify a deadline (the
+//!			time by which the element is needed). Requests without a deadline are never queued, and prefetches are
+//!			queued behind all requests.
+//!		- Requested elements become available when Get() finds that they have been loaded, or in a batch when
+//!			Update() is called. Lazy promotion may be disabled so that Get() only reads the state of an entry.
+//!		- A PrefetchPredictor may be attached to the cache. The predictor watches the requests and the cache
+//!			automatically prefetches the elements it predicts will be requested next.
+//!		- A MissRatioEstimator may be attached to the cache. The estimator samples the requests and estimates how
+//!			the miss ratio would change with the size of the cache, so that budgets can be adjusted at runtime.
+//!		- Elements may be looked up with any type that can be compared to a key with operator==() and hashed by a
+//!			transparent hash function (e.g. a std::string_view for std::string keys), without constructing a key.
+//!			A key is constructed from it only when a new entry is added to the cache. Keys may also be moved into
+//!			the cache.
+//!		- The hash of each key is stored with its entry, and lookups compare the hashes before the keys, so keys
+//!			are only compared when they are very likely to match.
+//!		- The cache counts the outcomes of its operations. It may also keep histograms of the time taken by loads
+//!			(see SetLatencyHistograms()): from a request to the element becoming available, and from a prefetch to
+//!			the element being loaded.
+//!		- A snapshot of the entries (their keys, states, sizes, ages, and request counts) may be copied out of the
+//!			cache, hottest first, e.g. to dump the hot keys periodically.
 //!
 //! Implementation:
 //!
@@ -47,9 +87,14 @@
 //!		- HasRoomFor()
 //!		- GetElement()
 //!
-//!	The requirements for these functions are listed in the functions' documentation.
-
-template <typename Element, typename Key, typename Handle = void *>
+//!	The requirements for these functions are listed in the functions' documentation. SizeOf() may optionally be
+//!	overloaded to enable bandwidth limiting, PollCompletedLoads() may optionally be overloaded to report
+//!	completed loads in a batch, EvictionMakesRoomFor() may optionally be overloaded to help choose which
+//!	elements to evict, UpdateStorage() may optionally be overloaded to do incremental work in Update(), and
+//!	Discard() may optionally be overloaded to unload elements that are not expected to be needed again.
+
+template <typename Element, typename Key, typename Handle = void *, typename Hash = KeyHash<Key>,
+          typename Tracer = NullTracer>
 class AsynchronousCache
 {
 private:
@@ -69,11 +114,19 @@ public:
         };
 
         // Constructor
-        Entry(Key const & k, Handle const & t, State s)
-            :   key(k),
+        template <typename K>
+        Entry(K && k, std::size_t h, Handle const & t, State s)
+            :   key(std::forward<K>(k)),
+            hash(h),
             state(s),
             handle(t),
-            pElement(0)
+            pElement(0),
+            size(0),
+            accesses(0),
+            queued(false),
+            loading(false),
+            stalled(false),
+            flight(0)
         {
         }
 
@@ -83,9 +136,18 @@ public:
         }
 
         Key key;                    // The key for finding this entry
+        std::size_t hash;           // Hash of the key
         State state;                // The state of the entry
         Handle handle;              // Handle returned by Load(), used to identify an element.
         Element * pElement;         // The element represented by this entry
+        std::size_t size;           // Size of the element as returned by SizeOf()
+        unsigned long long accesses;    // Number of requests for the element
+        bool queued;                // True if the entry is waiting for a load slot (Load() has not been called)
+        bool loading;               // True if Load() has been called but the element is not loaded yet
+        bool stalled;               // True if the entry is queued and there was no room to start it
+        std::size_t flight;         // Index of the entry in the list of loads in flight (if it is loading)
+        std::chrono::steady_clock::time_point deadline; // When the element is needed (if it is queued)
+        std::chrono::steady_clock::time_point fetched;  // When the element was last requested or prefetched
 
         // A functor which returns true if an entry has the specified pointer
 
@@ -100,17 +162,20 @@ public:
             Element const * m_pElement;
         };
 
-        // A functor which returns true if an entry has the specified key
+        // A functor which returns true if an entry has the specified key (and hash). The key is not copied, and it
+        // is only compared if the hash matches.
 
+        template <typename K>
         struct key_equals
         {
-            key_equals(Key const & key) : m_key(key) {}
+            key_equals(K const & key, std::size_t hash) : m_key(key), m_hash(hash) {}
             bool operator ()(Entry const & entry)
             {
-                return entry.key == m_key;
+                return entry.hash == m_hash && entry.key == m_key;
             }
 
-            Key m_key;
+            K const & m_key;
+            std::size_t m_hash;
         };
 
         // A functor which returns true if an entry has the specified handle
@@ -130,29 +195,201 @@ public:
     //! List of cache entries
     typedef std::list<Entry>  EntryList;
 
+    // A queued load
+    struct Pending
+    {
+        std::chrono::steady_clock::time_point deadline; // When the element is needed
+        unsigned long long sequence;                    // Order in which the load was queued
+        typename EntryList::iterator pEntry;            // The queued entry
+
+        // A functor which returns true if the first load should be started after the second one
+        struct later
+        {
+            bool operator ()(Pending const & a, Pending const & b) const
+            {
+                return (b.deadline < a.deadline) || (!(a.deadline < b.deadline) && b.sequence < a.sequence);
+            }
+        };
+
+        // A functor which returns true if a load is for the specified entry
+        struct entry_equals
+        {
+            entry_equals(typename EntryList::iterator const & pEntry) : m_pEntry(pEntry) {}
+            bool operator ()(Pending const & pending) const
+            {
+                return pending.pEntry == m_pEntry;
+            }
+
+            typename EntryList::iterator m_pEntry;
+        };
+    };
+
+    //! Queue of pending loads, organized as a heap with the earliest deadline at the front
+    typedef std::vector<Pending> PendingQueue;
+
+    // Hashes the handles of the loads in flight. If std::hash<Handle> is not defined, every handle hashes to 0.
+    struct HandleHash
+    {
+        std::size_t operator ()(Handle const & handle) const
+        {
+            if constexpr (std::is_default_constructible<std::hash<Handle>>::value)
+            {
+                return std::hash<Handle>()(handle);
+            }
+            else
+            {
+                return 0;
+            }
+        }
+    };
+
+    //! Index of the loads in flight by their handles
+    typedef std::unordered_map<Handle, typename EntryList::iterator, HandleHash> FlightIndex;
+
+    // Determines whether a K can be used to look up an element: it must be comparable to a key, and it must not be
+    // a pointer to an element (which would be ambiguous with Release(Element const *)).
+
+    template <typename K, typename = void>
+    struct is_lookup_key : std::false_type
+    {
+    };
+
+    template <typename K>
+    struct is_lookup_key<K, decltype(void(std::declval<Key const &>() == std::declval<K const &>()))>
+        : std::integral_constant<bool, !std::is_convertible<K const &, Element const *>::value>
+    {
+    };
+
+    // Determines whether the hash function hashes values other than keys
+    template <typename H, typename = void>
+    struct is_transparent : std::false_type
+    {
+    };
+
+    template <typename H>
+    struct is_transparent<H, std::void_t<typename H::is_transparent>> : std::true_type
+    {
+    };
+
+    // Enables an overload for lookups with a key of another type
+    template <typename K>
+    using if_lookup_key = typename std::enable_if<is_lookup_key<K>::value && !std::is_same<K, Key>::value>::type;
+
 public:
 
     class BackDoor;
     friend class BackDoor;
 
-    typedef ElementType Element;        //!< Type of the element stored in the cache
-    typedef KeyType Key;                //!< Type of the element key
-    typedef HandleType Handle;          //!< Type of the internal element handle
+    typedef Element ElementType;        //!< Type of the element stored in the cache
+    typedef Key KeyType;                //!< Type of the element key
+    typedef Handle HandleType;          //!< Type of the internal element handle
+    typedef std::chrono::steady_clock::time_point TimePoint;    //!< Type of a deadline
+    typedef void const * EntryRef;      //!< Identifies an entry to a derived class (see SetEntry())
+
+    //! The number of entries in each state, their sizes, and the memory used by the cache itself
+    struct Usage
+    {
+        std::size_t requested;          //!< Number of requested elements that are not available yet
+        std::size_t prefetched;         //!< Number of prefetched elements that have not been requested
+        std::size_t available;          //!< Number of available elements
+        std::size_t released;           //!< Number of released elements
+        std::size_t requestedBytes;     //!< Total size of the requested elements (as returned by SizeOf())
+        std::size_t prefetchedBytes;    //!< Total size of the prefetched elements
+        std::size_t availableBytes;     //!< Total size of the available elements
+        std::size_t releasedBytes;      //!< Total size of the released elements
+        std::size_t overheadBytes;      //!< Memory used by the cache's entries, queues, and scratch space
+    };
+
+    //! Counts of the outcomes of the cache's operations since the cache was constructed (or the counts were reset)
+    struct Statistics
+    {
+        unsigned long long getHits;             //!< Calls to Get() that returned an element
+        unsigned long long getMisses;           //!< Calls to Get() that returned nullptr
+        unsigned long long requestHits;         //!< Requests for elements that were already requested or available
+        unsigned long long prefetchHits;        //!< Requests for elements that had been prefetched
+        unsigned long long reloads;             //!< Requests for released elements that were still in the cache
+        unsigned long long requestMisses;       //!< Requests that started (or queued) a new load
+        unsigned long long requestFailures;     //!< Requests that failed (or, if queued, stalled) for lack of room
+        unsigned long long prefetches;          //!< Prefetches that started (or queued) a new load
+        unsigned long long prefetchFailures;    //!< Prefetches refused for lack of room or a full queue
+        unsigned long long evictions;           //!< Elements evicted to make room for new ones
+    };
+
+    //! A copy of an entry, as returned by GetSnapshot()
+    struct EntrySnapshot
+    {
+        //! State of an entry
+        enum State
+        {
+            REQUESTED,                  //!< Requested, but not available yet
+            PREFETCHED,                 //!< Prefetched, and not requested
+            AVAILABLE,                  //!< Available
+            RELEASED                    //!< Released, but still in the cache
+        };
+
+        Key key;                        //!< The key
+        State state;                    //!< The state of the entry
+        std::size_t size;               //!< Size of the element (as returned by SizeOf())
+        std::chrono::steady_clock::duration age;    //!< Time since the first request or prefetch of the element, or
+                                                    //!< since the request that found it prefetched
+        unsigned long long accesses;    //!< Number of requests for the element since it was added to the cache
+
+        //! A functor which returns true if an entry is hotter than another: it has been requested more often, or as
+        //! often in less time.
+        struct hotter
+        {
+            bool operator ()(EntrySnapshot const & a, EntrySnapshot const & b) const
+            {
+                return a.accesses > b.accesses || (a.accesses == b.accesses && a.age < b.age);
+            }
+        };
+    };
 
     //! Default constructor
-    AsynchronousCache()     {}
+    AsynchronousCache()
+        : m_maxLoadsInFlight(0),
+        m_maxBytesPerSecond(0),
+        m_maxQueuedPrefetches(0),
+        m_lazyPromotion(true),
+        m_byteBudget(0.0),
+        m_sequence(0),
+        m_pPredictor(0),
+        m_maxPredictedPrefetches(0),
+        m_predictionBudget(0),
+        m_pMissRatioEstimator(0),
+        m_stateCounts(),
+        m_stateBytes(),
+        m_statistics()
+    {
+    }
 
     //! Starts loading a element through the cache
     bool Request(Key const & key);
+    bool Request(Key && key);
+    template <typename K, typename = if_lookup_key<K>>
+    bool Request(K const & key);
+
+    //! Starts loading a element through the cache, scheduling the load according to when it is needed
+    bool Request(Key const & key, TimePoint deadline);
+    bool Request(Key && key, TimePoint deadline);
+    template <typename K, typename = if_lookup_key<K>>
+    bool Request(K const & key, TimePoint deadline);
 
     //! Notifies the cache that this element may be needed soon
-    void Prefetch(Key const & key);
+    bool Prefetch(Key const & key);
+    bool Prefetch(Key && key);
+    template <typename K, typename = if_lookup_key<K>>
+    bool Prefetch(K const & key);
 
     //! Returns a pointer to an element in the cache (or nullptr if it is not in the cache)
-    Element * Get(Key const & key);
+    Element * Get(Key const & key) { return Get<Key, void>(key); }
+    template <typename K, typename = if_lookup_key<K>>
+    Element * Get(K const & key);
 
     //! Finds an entry in the cache and marks it as no longer used (optionally force eviction)
-    void Release(Key const & key, bool forceEviction = false);
+    void Release(Key const & key, bool forceEviction = false) { Release<Key, void>(key, forceEviction); }
+    template <typename K, typename = if_lookup_key<K>>
+    void Release(K const & key, bool forceEviction = false);
 
     //! Finds an entry in the cache and marks it as no longer used (optionally force eviction)
     void Release(Element const * pElement, bool forceEviction = false);
@@ -163,8 +400,57 @@ public:
     //! Removes all elements from the cache
     void Clear();
 
+    //! Returns the number of entries in each state and the memory they use, in constant time
+    Usage GetUsage() const;
+
+    //! Returns the counts of the outcomes of the cache's operations
+    Statistics const & GetStatistics() const { return m_statistics; }
+
+    //! Enables or disables the latency histograms (disabled by default)
+    void SetLatencyHistograms(bool enable);
+
+    //! Returns the histogram of the times (in nanoseconds) from requests to the elements becoming available
+    LatencyHistogram const & GetRequestLatency() const { return m_pRequestLatency ? *m_pRequestLatency : Empty(); }
+
+    //! Returns the histogram of the times (in nanoseconds) from prefetches to the elements being loaded
+    LatencyHistogram const & GetPrefetchLatency() const { return m_pPrefetchLatency ? *m_pPrefetchLatency : Empty(); }
+
+    //! Resets the counts returned by GetStatistics() and the latency histograms
+    void ResetStatistics();
+
+    //! Returns copies of the entries, hottest first (optionally only the hottest few)
+    void GetSnapshot(std::vector<EntrySnapshot> & snapshot, std::size_t maxEntries = 0) const;
+
     //! Returns @c true if the element is in the cache (though possibly released)
-    bool IsCached(Key const & key) const;
+    bool IsCached(Key const & key) const { return IsCached<Key, void>(key); }
+    template <typename K, typename = if_lookup_key<K>>
+    bool IsCached(K const & key) const;
+
+    //! Sets the limits on concurrent loads, load bandwidth, and the length of the load queue (0 means no limit)
+    void SetLoadLimits(std::size_t maxLoadsInFlight,
+                       std::size_t maxBytesPerSecond   = 0,
+                       std::size_t maxQueuedPrefetches = 0);
+
+    //! Retires completed loads and starts queued loads as the load limits allow
+    void Update();
+
+    //! Like Update(), but also returns the keys of the requested elements that became available
+    void Update(std::vector<Key> & available);
+
+    //! Returns true if loads reported as completed were not loaded yet, so Update() will check them again
+    bool HasPendingCompletions() const { return !m_unready.empty(); }
+
+    //! Enables or disables the promotion of loaded elements by Get() and Request() (enabled by default)
+    void SetLazyPromotion(bool enable);
+
+    //! Attaches a predictor that issues prefetches automatically (or detaches it if @c nullptr)
+    void SetPredictor(PrefetchPredictor<Key> * pPredictor, std::size_t maxPrefetchesPerUpdate = 0);
+
+    //! Attaches an estimator of the miss-ratio curve (or detaches it if @c nullptr)
+    void SetMissRatioEstimator(MissRatioEstimator * pEstimator);
+
+    //! Returns the tracer
+    Tracer & GetTracer() { return m_tracer; }
 
 protected:
 
@@ -180,8 +466,12 @@ protected:
     //! determined by the derived class and the cache makes no attempt to interpret its value. The handle is
     //! intended to provide an efficient and effective way to reference a loaded element directly.
     //!
+    //! If the element cannot be loaded after all (e.g. its memory cannot be allocated), this function returns
+    //! Handle() (e.g. nullptr), and the load fails as if there were no room for the element. Therefore, Handle() is
+    //! never a valid handle.
+    //!
     //! @param	key		Key identifying the element to load
-    //! @return		Returns a handle used to identify the loaded element.
+    //! @return		Returns a handle used to identify the loaded element, or Handle() if it cannot be loaded.
     //! @note	This function must be overridden.
 
     virtual Handle Load(Key const & key) = 0;
@@ -197,6 +487,16 @@ protected:
 
     virtual void Unload(Handle const & handle) = 0;
 
+    //! Immediately unloads an element that is not expected to be needed again.
+    //!
+    //! This function is called instead of Unload() when an element is evicted by force (see Release()) or by
+    //! Clear(). A derived class that keeps unloaded elements somewhere (e.g. in a secondary tier) should override it
+    //! to discard the element instead. The default implementation calls Unload().
+    //!
+    //! @param	handle	The handle identifying the entry to unload.
+
+    virtual void Discard(Handle const & handle) { Unload(handle); }
+
     //! Returns true if there is room for an entry.
     //!
     //! This function tells if there is room in the cache storage to load the specified entry. The cache manager
@@ -220,15 +520,97 @@ protected:
 
     virtual Element * GetElement(Handle const & handle) = 0;
 
+    //! Returns the number of bytes that loading an element will transfer.
+    //!
+    //! The cache uses this value to limit the load bandwidth (see SetLoadLimits()). The default implementation
+    //! returns 0, which means that the size is unknown and the element is not counted against the bandwidth limit.
+    //!
+    //! @param	key		Key identifying the element to be loaded
+
+    virtual std::size_t SizeOf(Key const & /* key */) { return 0; }
+
+    //! Reports the loads that have completed since the last call.
+    //!
+    //! Update() calls this function once to find out which of the loads in progress have completed. A derived class
+    //! that tracks its completions (e.g. from an I/O completion queue) should override it to append the handles of
+    //! the completed loads to @a completed and return <tt>true</tt>. Reporting a load more than once or reporting a
+    //! load that is not in progress is harmless. A load reported before GetElement() returns its element is checked
+    //! again by each Update() until it does. The default implementation reports nothing and returns <tt>false</tt>,
+    //! in which case Update() calls GetElement() once for each load in progress.
+    //!
+    //! @param	completed	Vector to which the handles of the completed loads are appended
+    //! @return		<tt>true</tt> if the completed loads were reported
+    //! @note	The handles of the loads in progress must be distinct.
+
+    virtual bool PollCompletedLoads(std::vector<Handle> & /* completed */) { return false; }
+
+    //! Returns true if evicting an element would, by itself, make room for another.
+    //!
+    //! When the cache needs room for an element, it first evicts only those released elements for which this
+    //! function returns <tt>true</tt> (least recently released first). If that does not make room, it evicts
+    //! released elements in order until HasRoomFor() returns <tt>true</tt>. Storage that can fragment should
+    //! override this function so that the cache targets victims whose memory is actually usable for the new
+    //! element. The default implementation returns <tt>true</tt>.
+    //!
+    //! @param	victim	Handle of the element that might be evicted
+    //! @param	key		Key identifying the element to be loaded
+
+    virtual bool EvictionMakesRoomFor(Handle const & /* victim */, Key const & /* key */) { return true; }
+
+    //! Does incremental storage maintenance.
+    //!
+    //! This function is called at the end of every Update() so that the derived class can do a slice of periodic
+    //! work such as compaction. The default implementation does nothing.
+
+    virtual void UpdateStorage() {}
+
+    //! Tells the derived class which entry a handle belongs to.
+    //!
+    //! This function is called after Load() returns a handle. The reference remains valid until the element is
+    //! unloaded, and it lets a derived class query and update the entry in constant time (see IsRelocatable() and
+    //! Relocated()). The default implementation does nothing.
+    //!
+    //! @param	handle	Handle returned by Load()
+    //! @param	entry	Reference to the handle's entry
+
+    virtual void SetEntry(Handle const & /* handle */, EntryRef /* entry */) {}
+
     // ****
 
+    //! Returns true if an element may be moved to a different address
+    bool IsRelocatable(EntryRef entry, bool safePoint) const;
+
+    //! Tells the cache that an element has been moved
+    void Relocated(EntryRef entry, Element * pElement);
+
 private:
 
+    // Requests an element, with a deadline or (if pDeadline is nullptr) immediately. The key is moved into a new
+    // entry if K is an rvalue Key.
+    template <typename K>
+    bool RequestKey(K && key, std::size_t hash, TimePoint const * pDeadline);
+
+    // Prefetches an element. The key is moved into a new entry if K is an rvalue Key.
+    template <typename K>
+    bool PrefetchKey(K && key, std::size_t hash) { return PrefetchKey(std::forward<K>(key), hash, Find(key, hash)); }
+
+    // Prefetches an element whose entry has already been looked up (m_entries.end() if it is not in the cache)
+    template <typename K>
+    bool PrefetchKey(K && key, std::size_t hash, typename EntryList::iterator pEntry);
+
+    // Retires completed loads and starts queued loads, appending newly available keys to *pAvailable if not nullptr
+    void Update(std::vector<Key> * pAvailable);
+
     // Finds an entry in the cache and marks it as no longer used (optionally force eviction)
     void Release(typename EntryList::iterator & pEntry, bool forceEviction);
 
     // Finds an entry by the key, or nullptr if not found
-    typename EntryList::iterator Find(Key const & key);
+    template <typename K>
+    typename EntryList::iterator Find(K const & key, typename std::enable_if<is_lookup_key<K>::value>::type * = 0);
+
+    // Finds an entry by the key and its hash, or nullptr if not found
+    template <typename K>
+    typename EntryList::iterator Find(K const & key, std::size_t hash);
 
     // Finds an entry by the handle, or nullptr if not found
     typename EntryList::iterator Find(Handle const & handle);
@@ -239,24 +621,118 @@ private:
     // Evicts enough entries in the cache to make room for a new one. Returns true if successful.
     bool MakeRoomForNewEntry(Key const & key);
 
-    // Removes an entry from the cache. Returns the iterator of the next entry.
-    typename EntryList::iterator Evict(typename EntryList::iterator & pEntry);
+    // Removes an entry from the cache, discarding its element if it is not expected to be needed again. Returns the
+    // iterator of the next entry.
+    typename EntryList::iterator Evict(typename EntryList::iterator & pEntry, bool discard = false);
+
+    // Erases an entry from the list. Returns the iterator of the next entry.
+    typename EntryList::iterator Remove(typename EntryList::iterator & pEntry);
+
+    // Changes the state of an entry
+    void SetState(typename EntryList::iterator & pEntry, typename Entry::State state);
+
+    // Reports an event to the tracer
+    void Trace(TraceEvent event, typename EntryList::iterator const & pEntry)
+    {
+        m_tracer.Trace(event, pEntry->key, pEntry->hash, pEntry->size);
+    }
+
+    // Adds an entry to the end of the list, constructing its key from the specified key
+    template <typename K>
+    typename EntryList::iterator Insert(K && key, std::size_t hash, typename Entry::State state);
 
     // Loads an element into the cache (asynchronously). Returns the entry's iterator.
-    typename EntryList::iterator Fetch(Key const & key, Entry::State state);
+    template <typename K>
+    typename EntryList::iterator Fetch(K && key, std::size_t hash, typename Entry::State state);
+
+    // Starts loading a queued entry. Returns false if there is no room for it (setting *pNoRoom if not nullptr) or
+    // it cannot be loaded.
+    bool Start(typename EntryList::iterator & pEntry, bool * pNoRoom = 0);
+
+    // Removes an entry that could not be loaded
+    void Fail(typename EntryList::iterator & pEntry);
+
+    // Adds an entry to the load queue
+    void Enqueue(typename EntryList::iterator & pEntry, TimePoint deadline);
+
+    // Removes an entry from the load queue
+    void Dequeue(typename EntryList::iterator & pEntry);
 
     // Reloads an evicted element
     void Reload(typename EntryList::iterator & pEntry);
 
-    EntryList m_entries;            // The cache entries
+    // Returns true if a load needed by the deadline may start now rather than be queued
+    bool CanStartBefore(TimePoint deadline);
+
+    // Returns true if the load limits allow another load to start
+    bool LoadSlotAvailable();
+
+    // Marks an entry's load as no longer in flight
+    void Retire(typename EntryList::iterator & pEntry);
+
+    // Records that an entry's element has been loaded, making it available if it was requested. The key of a newly
+    // available element is appended to *pAvailable if not nullptr.
+    void Complete(typename EntryList::iterator & pEntry, Element * pElement, std::vector<Key> * pAvailable = 0);
+
+    // Reports a request to the predictor and gets its predictions
+    void Predict(Key const & key);
+
+    // Reports a request for an entry to the predictor and, if the request was sampled, to the miss ratio estimator
+    void Observe(typename EntryList::iterator const & pEntry, bool sampled);
+
+    // Returns the hash of a key, or of a value used to look one up
+    template <typename K>
+    std::size_t HashOf(K const & key) const
+    {
+        static_assert(std::is_same<K, Key>::value || is_transparent<Hash>::value,
+                      "heterogeneous lookups require a transparent hash (Hash::is_transparent)");
+        return m_hash(key);
+    }
+
+    // Prefetches the predictor's predictions
+    void PrefetchPredictions();
+
+    // Returns an empty histogram, which stands in for a disabled one
+    static LatencyHistogram const & Empty()
+    {
+        static LatencyHistogram const empty;
+        return empty;
+    }
+
+    std::size_t m_maxLoadsInFlight;     // Maximum number of concurrent loads (0 means no limit)
+    std::size_t m_maxBytesPerSecond;    // Maximum load bandwidth (0 means no limit)
+    std::size_t m_maxQueuedPrefetches;  // Maximum queue length at which prefetches are refused (0 means no limit)
+    bool m_lazyPromotion;               // True if Get() and Request() check whether loads have completed
+    double m_byteBudget;                // Number of bytes that may be loaded before the bandwidth limit is reached
+    std::chrono::steady_clock::time_point m_lastRefill;         // When the byte budget was last refilled
+    PendingQueue m_queue;               // Loads waiting for a load slot, earliest deadline first
+    unsigned long long m_sequence;      // Sequence number of the next queued load
+    std::vector<typename EntryList::iterator> m_inFlight;       // Entries whose loads are in progress
+    FlightIndex m_flightIndex;          // Entries whose loads are in progress, by their handles
+    std::vector<Handle> m_completed;    // Scratch space for the handles reported by PollCompletedLoads()
+    std::vector<Handle> m_unready;      // Handles reported by PollCompletedLoads() before their loads completed
+    PendingQueue m_stalled;             // Scratch space for the queued requests that could not start in this update
+    PrefetchPredictor<Key> * m_pPredictor;                      // The attached predictor, or nullptr
+    std::size_t m_maxPredictedPrefetches;   // Maximum number of predicted prefetches per update (0 means no limit)
+    std::size_t m_predictionBudget;         // Number of predicted prefetches remaining in this update
+    std::vector<Key> m_predictions;         // Scratch space for the predictor's predictions
+    MissRatioEstimator * m_pMissRatioEstimator; // The attached miss-ratio estimator, or nullptr
+    [[no_unique_address]] Hash m_hash;      // Hashes the keys (takes no space if it is empty)
+    std::size_t m_stateCounts[4];           // Number of entries in each state
+    std::size_t m_stateBytes[4];            // Total size of the entries in each state
+    Statistics m_statistics;                // Counts of the outcomes of operations
+    std::unique_ptr<LatencyHistogram> m_pRequestLatency;    // Times from requests to elements being available
+    std::unique_ptr<LatencyHistogram> m_pPrefetchLatency;   // Times from prefetches to elements being loaded
+    [[no_unique_address]] Tracer m_tracer;  // Receives an event on every change of state (no space if empty)
+    EntryList m_entries;                // The cache entries
 };
 
-template <typename Element, typename Key, typename Handle = void *>
-class AsynchronousCache<Element, Key, Handle>::BackDoor
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+class AsynchronousCache<Element, Key, Handle, Hash, Tracer>::BackDoor
 {
 public:
 
-    typedef AsynchronousCache<Element, Key, Handle>   Target;
+    typedef AsynchronousCache<Element, Key, Handle, Hash, Tracer>   Target;
     typedef typename Target::Entry Entry;
     typedef typename Target::EntryList EntryList;
 
@@ -266,9 +742,9 @@ public:
     }
 
     typename EntryList::iterator Find(Key const & key) const { return m_target->Find(key); }
-    typename EntryList::iterator Find(Handle const & handle) const { return m_target->Find(key); }
-    typename EntryList::iterator Find(Element const * pElement) const { return m_target->Find(key); }
-    typename EntryList & GetEntries() const { return m_target->m_entries; }
+    typename EntryList::iterator Find(Handle const & handle) const { return m_target->Find(handle); }
+    typename EntryList::iterator Find(Element const * pElement) const { return m_target->Find(pElement); }
+    EntryList & GetEntries() const { return m_target->m_entries; }
     Element * GetElement(Handle const & handle) const { return m_target->GetElement(handle); }
 
 private:
@@ -284,73 +760,123 @@ private:
 //!
 //! @return		@c false, if there is no room in the cache to load the element
 //!
-//! @note		Requesting an available or requested element does nothing.
+//! @note		Requesting an available or requested element does nothing, except that a queued load is started
+//!				immediately.
+//! @note		If a predictor is attached, the request is reported to it and its predictions are prefetched.
 
-template <typename Element, typename Key, typename Handle>
-bool AsynchronousCache<Element, Key, Handle>::Request(Key const & key)
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+bool AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Request(Key const & key)
 {
-    bool ok;
+    return RequestKey(key, HashOf(key), 0);
+}
 
-    // Check if the element is already in the cache. If it is, then reload it if it is being evicted. If it is not
-    // already in the cache, then load the element.
+//! This function is the same as Request(Key const &), except that the key is moved into the cache if the element is
+//! not already in it.
+//!
+//! @param	key		Element to load
 
-    EntryList::iterator pEntry = Find(key);
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+bool AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Request(Key && key)
+{
+    return RequestKey(std::move(key), HashOf(key), 0);
+}
 
-    if (pEntry != m_entries.end())
-    {
-        // Check the state of the entry and do the appropriate thing.
+//! This function is the same as Request(Key const &), except that the element is looked up with a value that is
+//! compared to the keys in the cache. A key is constructed from it only if the element is not already in the cache.
+//!
+//! @param	key		Element to load
 
-        switch (pEntry->state)
-        {
-            case Entry::STATE_REQUESTED:    // Not available yet, nothing else to do
-            case Entry::STATE_AVAILABLE:    // Already available, nothing to do
-                break;
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+template <typename K, typename>
+bool AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Request(K const & key)
+{
+    return RequestKey(key, HashOf(key), 0);
+}
 
-            case Entry::STATE_PREFETCHED:
-            {
-                Element * pElement = GetElement(pEntry->handle);
-                if (pElement != 0)
-                {
-                    pEntry->pElement = pElement;
-                    pEntry->state    = Entry::STATE_AVAILABLE;
-                }
-                else
-                {
-                    pEntry->state = Entry::STATE_REQUESTED;
-                }
-                break;
-            }
-            case Entry::STATE_RELEASED:
-                Reload(pEntry);
-                break;
-        }
+//! This function starts loading a element into the cache, like Request(Key const &). However, if the load limits
+//! set by SetLoadLimits() have been reached, the load is queued and Update() starts the queued loads in order of
+//! their deadlines. Until the element is available, Get() will return 0.
+//!
+//! @param	key			Element to load
+//! @param	deadline	When the element is needed
+//!
+//! @return		@c false, if there is no room in the cache to load the element
+//!
+//! @note		Requesting a queued element with an earlier deadline moves it up in the queue.
+//! @note		A queued request waits until there is room for it (see Update()).
 
-        ok = true;
-    }
-    else
-    {
-        ok = (Fetch(key, Entry::STATE_REQUESTED) != m_entries.end());
-    }
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+bool AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Request(Key const & key, TimePoint deadline)
+{
+    return RequestKey(key, HashOf(key), &deadline);
+}
 
-    return ok;
+//! @param	key			Element to load. The key is moved into the cache if the element is not already in it.
+//! @param	deadline	When the element is needed
+
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+bool AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Request(Key && key, TimePoint deadline)
+{
+    return RequestKey(std::move(key), HashOf(key), &deadline);
+}
+
+//! @param	key			Element to load. It is compared to the keys in the cache.
+//! @param	deadline	When the element is needed
+
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+template <typename K, typename>
+bool AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Request(K const & key, TimePoint deadline)
+{
+    return RequestKey(key, HashOf(key), &deadline);
 }
 
 //! This function starts loading a element into the cache, however it is not available until it is also requested.
 //! If a prefetched element is released before it is loaded, the load is canceled. The element may not be loaded
 //! if there is no room in the cache.
 //!
+//! If the load limits set by SetLoadLimits() have been reached, the prefetch is queued behind all requests and
+//! Update() starts it later. If the queue is full, the prefetch is refused and the caller may try again later.
+//!
 //! @param	key		Element to prefetch
 //!
+//! @return		@c false, if there is no room in the cache or the load queue is full
+//!
 //! @note	Prefetching an available, requested, or prefetched element does nothing.
 
-template <typename Element, typename Key, typename Handle>
-void AsynchronousCache<Element, Key, Handle>::Prefetch(Key const & key)
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+bool AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Prefetch(Key const & key)
+{
+    return PrefetchKey(key, HashOf(key));
+}
+
+//! @param	key		Element to prefetch. The key is moved into the cache if the element is not already in it.
+
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+bool AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Prefetch(Key && key)
+{
+    return PrefetchKey(std::move(key), HashOf(key));
+}
+
+//! @param	key		Element to prefetch. It is compared to the keys in the cache.
+
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+template <typename K, typename>
+bool AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Prefetch(K const & key)
+{
+    return PrefetchKey(key, HashOf(key));
+}
+
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+template <typename K>
+bool AsynchronousCache<Element, Key, Handle, Hash, Tracer>::PrefetchKey(K &&                         key,
+                                                                        std::size_t                  hash,
+                                                                        typename EntryList::iterator pEntry)
 {
+    bool ok = true;
+
     // Check if the element is already in the cache. If it is released, then make it the last to be evicted.
     // If it is not already in the cache, then load it it and release it.
 
-    EntryList::iterator pEntry = Find(key);
-
     if (pEntry != m_entries.end())
     {
         // Check the state of the entry and do the appropriate thing.
@@ -368,13 +894,35 @@ void AsynchronousCache<Element, Key, Handle>::Prefetch(Key const & key)
                 // entry to the end of the list so it is the last to be evicted.
 
                 m_entries.splice(m_entries.end(), m_entries, pEntry);
+                Trace(TRACE_PREFETCH, pEntry);
                 break;
         }
     }
+    else if (CanStartBefore(TimePoint::max()))
+    {
+        ++m_statistics.prefetches;
+        ok = (Fetch(std::forward<K>(key), hash, Entry::STATE_PREFETCHED) != m_entries.end());
+    }
+    else if (m_maxQueuedPrefetches == 0 || m_queue.size() < m_maxQueuedPrefetches)
+    {
+        // The load limits have been reached, so the prefetch waits in the queue until Update() starts it. A prefetch
+        // is not needed by any particular time, so it goes behind all requests.
+
+        ++m_statistics.prefetches;
+        pEntry = Insert(std::forward<K>(key), hash, Entry::STATE_PREFETCHED);
+        Enqueue(pEntry, TimePoint::max());
+    }
     else
     {
-        Fetch(key, Entry::STATE_PREFETCHED);
+        ok = false; // The queue is full, so push back on the caller
+    }
+
+    if (!ok)
+    {
+        ++m_statistics.prefetchFailures;
     }
+
+    return ok;
 }
 
 //! This function returns a pointer to an element in the cache. After an element is requested, Get() will return
@@ -384,36 +932,48 @@ void AsynchronousCache<Element, Key, Handle>::Prefetch(Key const & key)
 //!
 //! @return		Pointer to the element, or 0 if the element is not in the cache.
 
-template <typename Element, typename Key, typename Handle>
-Element * AsynchronousCache<Element, Key, Handle>::Get(Key const & key)
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+template <typename K, typename>
+Element * AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Get(K const & key)
 {
     Element * result;
 
-    EntryList::iterator pEntry = Find(key);
+    typename EntryList::iterator pEntry = Find(key);
 
     // If the element is in the list, then check if it is available or not. Otherwise, return 0.
 
     if (pEntry != m_entries.end())
     {
-        // If it was requested, see if it is available. If it is, then update the state
+        // If it was requested, see if it is available. If it is, then update the state. If lazy promotion is
+        // disabled, then only Update() does this.
 
-        if (pEntry->state == Entry::STATE_REQUESTED)
+        if (m_lazyPromotion && pEntry->loading && pEntry->state == Entry::STATE_REQUESTED)
         {
             Element * pElement = GetElement(pEntry->handle);
             if (pElement != 0)
             {
-                pEntry->pElement = pElement;
-                pEntry->state    = Entry::STATE_AVAILABLE;
+                Complete(pEntry, pElement);
             }
         }
 
-        result = pEntry->pElement;
+        // A prefetched element is not accessible until it is requested, even if it has been loaded.
+
+        result = (pEntry->state != Entry::STATE_PREFETCHED) ? pEntry->pElement : 0;
     }
     else
     {
         result = 0;
     }
 
+    if (result != 0)
+    {
+        ++m_statistics.getHits;
+    }
+    else
+    {
+        ++m_statistics.getMisses;
+    }
+
     return result;
 }
 
@@ -426,10 +986,11 @@ Element * AsynchronousCache<Element, Key, Handle>::Get(Key const & key)
 //!
 //! @note	Releasing a released element by key does nothing.
 
-template <typename Element, typename Key, typename Handle>
-void AsynchronousCache<Element, Key, Handle>::Release(Key const & key, bool forceEviction /* = false*/)
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+template <typename K, typename>
+void AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Release(K const & key, bool forceEviction /* = false*/)
 {
-    EntryList::iterator pEntry = Find(key);
+    typename EntryList::iterator pEntry = Find(key);
 
     if (pEntry != m_entries.end())
     {
@@ -447,10 +1008,11 @@ void AsynchronousCache<Element, Key, Handle>::Release(Key const & key, bool forc
 //! @warn	Addresses are not unique, so specifying the address of a previously released element may release a
 //!			different element.
 
-template <typename Element, typename Key, typename Handle>
-void AsynchronousCache<Element, Key, Handle>::Release(Element const * pElement, bool forceEviction /* = false*/)
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+void AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Release(Element const * pElement,
+                                                                    bool forceEviction /* = false*/)
 {
-    EntryList::iterator pEntry = Find(pElement);
+    typename EntryList::iterator pEntry = Find(pElement);
 
     if (pEntry != m_entries.end())
     {
@@ -460,23 +1022,23 @@ void AsynchronousCache<Element, Key, Handle>::Release(Element const * pElement,
 
 //! This function returns @c true if there are no elements in the cache (whether active or released).
 
-template <typename Element, typename Key, typename Handle>
-bool AsynchronousCache<Element, Key, Handle>::IsEmpty() const
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+bool AsynchronousCache<Element, Key, Handle, Hash, Tracer>::IsEmpty() const
 {
-    bool empty = m_entries.empty();
+    return m_entries.empty();
 }
 
 //! This function evicts all entries from the cache. An "evicted" element is removed from the cache entirely.
 
-template <typename Element, typename Key, typename Handle>
-void AsynchronousCache<Element, Key, Handle>::Clear()
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+void AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Clear()
 {
-    // Go through the list and evict every entry
+    // Go through the list and evict every entry. The elements are not expected to be needed again.
 
-    EntryList::iterator pEntry = m_entries.begin();
+    typename EntryList::iterator pEntry = m_entries.begin();
     while (pEntry != m_entries.end())
     {
-        pEntry = Evict(pEntry);
+        pEntry = Evict(pEntry, true);
     }
 }
 
@@ -485,127 +1047,884 @@ void AsynchronousCache<Element, Key, Handle>::Clear()
 //!
 //! @param	key		Element to check
 
-template <typename Element, typename Key, typename Handle>
-bool AsynchronousCache<Element, Key, Handle>::IsCached(Key const & key) const
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+template <typename K, typename>
+bool AsynchronousCache<Element, Key, Handle, Hash, Tracer>::IsCached(K const & key) const
 {
-    EntryList::iterator pEntry = const_cast<AsynchronousCache<Element, Key, Handle> *>(this)->Find(key);
+    typename EntryList::iterator pEntry =
+        const_cast<AsynchronousCache<Element, Key, Handle, Hash, Tracer> *>(this)->Find(key);
     bool isCached = (pEntry != m_entries.end() &&
                      (pEntry->state == Entry::STATE_AVAILABLE || pEntry->state == Entry::STATE_RELEASED));
 
     return isCached;
 }
 
-template <typename Element, typename Key, typename Handle>
-void AsynchronousCache<Element, Key, Handle>::Release(typename EntryList::iterator & pEntry, bool forceEviction)
+//! The counts are maintained on every change of state, so this function does not examine the entries. The sizes
+//! are the values returned by SizeOf(), so they are 0 unless SizeOf() is overridden. The overhead includes the
+//! entries (and their list nodes), the load queue, and the cache's scratch space, but not any memory allocated by
+//! the keys or handles themselves.
+
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+typename AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Usage AsynchronousCache<Element, Key, Handle, Hash, Tracer>::GetUsage()
+const
 {
-    // If this entry is not yet available or it is a forced eviction, then go ahead and evict now.
-    // Otherwise, mark it as being evicted and move it to the end (so it is unloaded after any
-    // entry that was evicted before it).
+    Usage usage;
+    usage.requested       = m_stateCounts[Entry::STATE_REQUESTED];
+    usage.prefetched      = m_stateCounts[Entry::STATE_PREFETCHED];
+    usage.available       = m_stateCounts[Entry::STATE_AVAILABLE];
+    usage.released        = m_stateCounts[Entry::STATE_RELEASED];
+    usage.requestedBytes  = m_stateBytes[Entry::STATE_REQUESTED];
+    usage.prefetchedBytes = m_stateBytes[Entry::STATE_PREFETCHED];
+    usage.availableBytes  = m_stateBytes[Entry::STATE_AVAILABLE];
+    usage.releasedBytes   = m_stateBytes[Entry::STATE_RELEASED];
+
+    // Each entry is in a list node with two links
+
+    usage.overheadBytes = sizeof(*this) +
+                          m_entries.size() * (sizeof(Entry) + 2 * sizeof(void *)) +
+                          m_queue.capacity() * sizeof(Pending) +
+                          m_inFlight.capacity() * sizeof(typename EntryList::iterator) +
+                          m_flightIndex.size() * (sizeof(typename FlightIndex::value_type) + sizeof(void *)) +
+                          m_flightIndex.bucket_count() * sizeof(void *) +
+                          (m_completed.capacity() + m_unready.capacity()) * sizeof(Handle) +
+                          m_stalled.capacity() * sizeof(Pending) +
+                          m_predictions.capacity() * sizeof(Key) +
+                          (m_pRequestLatency ? 2 * sizeof(LatencyHistogram) : 0);
+
+    return usage;
+}
 
-    if (pEntry->state == Entry::STATE_REQUESTED || forceEviction)
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+void AsynchronousCache<Element, Key, Handle, Hash, Tracer>::ResetStatistics()
+{
+    m_statistics = Statistics();
+    if (m_pRequestLatency)
     {
-        Evict(pEntry);
+        m_pRequestLatency->Reset();
+        m_pPrefetchLatency->Reset();
     }
-    else if (pEntry->state == Entry::STATE_AVAILABLE)
+}
+
+//! The histograms take about 15KB each, so they are allocated only when they are enabled. Disabling them discards
+//! the times recorded so far.
+//!
+//! @param	enable		If @c true, the histograms are enabled
+
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+void AsynchronousCache<Element, Key, Handle, Hash, Tracer>::SetLatencyHistograms(bool enable)
+{
+    if (!enable)
     {
-        pEntry->state = Entry::STATE_RELEASED;
-        m_entries.splice(m_entries.end(), m_entries, pEntry);
+        m_pRequestLatency.reset();
+        m_pPrefetchLatency.reset();
     }
-    else
+    else if (!m_pRequestLatency)
     {
-        // error can only release requested or available elements
+        m_pRequestLatency.reset(new LatencyHistogram);
+        m_pPrefetchLatency.reset(new LatencyHistogram);
     }
 }
 
-template <typename Element, typename Key, typename Handle>
-typename std::list<typename AsynchronousCache<Element, Key, Handle>::Entry>::iterator AsynchronousCache<Element, Key, Handle>::Find(
-    Key const & key)
+//! The snapshot is a copy, so it remains valid (and consistent) after the cache changes. Copying the entries takes
+//! time proportional to their number, and sorting them takes n log n time (or n log m time for the hottest m), so
+//! it is meant for occasional diagnostics, such as a periodic dump of the hot keys.
+//!
+//! @param	snapshot	Receives the copies of the entries, replacing its contents
+//! @param	maxEntries	Maximum number of entries returned (0 means all of them)
+
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+void AsynchronousCache<Element, Key, Handle, Hash, Tracer>::GetSnapshot(std::vector<EntrySnapshot> & snapshot,
+                                                                        std::size_t maxEntries /* = 0*/) const
 {
-    // Return an element with a matching key, or m_entries.end()
+    static_assert(std::is_copy_constructible<Key>::value, "GetSnapshot() requires copyable keys");
 
-    return std::find_if(m_entries.begin(), m_entries.end(), Entry::key_equals(key));
-}
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
 
-template <typename Element, typename Key, typename Handle>
-typename std::list<typename AsynchronousCache<Element, Key, Handle>::Entry>::iterator AsynchronousCache<Element, Key, Handle>::Find(
-    Handle const & handle)
-{
-    // Return an element with a matching handle, or m_entries.end()
+    snapshot.clear();
+    snapshot.reserve(m_entries.size());
+    for (typename EntryList::const_iterator pEntry = m_entries.begin(); pEntry != m_entries.end(); ++pEntry)
+    {
+        EntrySnapshot entry = { pEntry->key,
+                                (typename EntrySnapshot::State)pEntry->state,
+                                pEntry->size,
+                                now - pEntry->fetched,
+                                pEntry->accesses };
+        snapshot.push_back(entry);
+    }
 
-    return std::find_if(m_entries.begin(), m_entries.end(), Entry::handle_equals(handle));
+    if (maxEntries > 0 && maxEntries < snapshot.size())
+    {
+        std::partial_sort(snapshot.begin(), snapshot.begin() + maxEntries, snapshot.end(),
+                          typename EntrySnapshot::hotter());
+        snapshot.resize(maxEntries);
+    }
+    else
+    {
+        std::sort(snapshot.begin(), snapshot.end(), typename EntrySnapshot::hotter());
+    }
 }
 
-template <typename Element, typename Key, typename Handle>
-typename std::list<typename AsynchronousCache<Element, Key, Handle>::Entry>::iterator AsynchronousCache<Element, Key, Handle>::Find(
-    Element const * pElement)
+//! Loads started beyond the limits set here are deferred: requests with deadlines and prefetches wait in a queue
+//! until Update() finds a free load slot, and a prefetch is refused when the queue is full. Requests without
+//! deadlines are never queued, but they do count against the limits. A limit of 0 means no limit. By default,
+//! there are no limits.
+//!
+//! @param	maxLoadsInFlight		Maximum number of loads that may be in progress at the same time
+//! @param	maxBytesPerSecond		Maximum rate at which bytes are loaded, as reported by SizeOf()
+//! @param	maxQueuedPrefetches		Maximum number of queued loads beyond which prefetches are refused
+
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+void AsynchronousCache<Element, Key, Handle, Hash, Tracer>::SetLoadLimits(std::size_t maxLoadsInFlight,
+                                                                          std::size_t maxBytesPerSecond /* = 0*/,
+                                                                          std::size_t maxQueuedPrefetches /* = 0*/)
 {
-    // Return an element with a matching address, or m_entries.end()
+    m_maxLoadsInFlight    = maxLoadsInFlight;
+    m_maxBytesPerSecond   = maxBytesPerSecond;
+    m_maxQueuedPrefetches = maxQueuedPrefetches;
 
-    return std::find_if(m_entries.begin(), m_entries.end(), Entry::pointer_equals(pElement));
+    // Start with a full second's worth of bandwidth
+
+    m_byteBudget = (double)maxBytesPerSecond;
+    m_lastRefill = std::chrono::steady_clock::now();
 }
 
-template <typename Element, typename Key, typename Handle>
-bool AsynchronousCache<Element, Key, Handle>::MakeRoomForNewEntry(Key const & key)
+//! This function asks PollCompletedLoads() for the loads that have completed and retires them all at once. Requested
+//! elements that have been loaded become available. Then, as many queued loads are started as the load limits
+//! allow, in order of their deadlines. It should be called regularly (e.g. once per frame).
+//!
+//! If there is no room for a queued request, it stays in the queue (and Get() returns 0) until enough elements are
+//! released, and it is counted once in Statistics::requestFailures. Loads queued behind it that do fit are started
+//! in the meantime. A queued request is removed from the cache (as if it had failed when it was made) if Load()
+//! fails, or if there is no room for it and every entry in the cache is queued, since then nothing could ever be
+//! released to make room. A queued prefetch for which there is no room is dropped and counted in
+//! Statistics::prefetchFailures.
+
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+void AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Update()
 {
-    // Go through the list from front to back evicting entries until there is room for the entry
-    // or there are no more entries to evict.
+    Update(0);
+}
 
-    EntryList::iterator pEntry;
+//! This function is the same as Update(), except that the keys of the requested elements that became available
+//! during this update are appended to @a available.
+//!
+//! @param	available	Vector to which the keys of the newly available elements are appended
 
-    // First, evict released elements.
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+void AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Update(std::vector<Key> & available)
+{
+    static_assert(std::is_copy_constructible<Key>::value, "Update(std::vector<Key> &) requires copyable keys");
+    Update(&available);
+}
 
-    pEntry = m_entries.begin();
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+void AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Update(std::vector<Key> * pAvailable)
+{
+    // Ask for the completed loads all at once, and then retire them. A load that was reported before it completed
+    // is checked again until it does, since it may not be reported again. If the loads are not reported, then check
+    // each load in flight once. Completing a load moves the last one into its place, and the last one has already
+    // been checked, so they are checked from last to first.
+
+    m_completed.clear();
+    m_completed.swap(m_unready);
+    if (PollCompletedLoads(m_completed) || !m_completed.empty())
+    {
+        for (typename std::vector<Handle>::const_iterator h = m_completed.begin(); h != m_completed.end(); ++h)
+        {
+            typename FlightIndex::iterator i = m_flightIndex.find(*h);
+            if (i != m_flightIndex.end())
+            {
+                typename EntryList::iterator pEntry   = i->second;
+                Element *                    pElement = GetElement(pEntry->handle);
+                if (pElement != 0)
+                {
+                    Complete(pEntry, pElement, pAvailable);
+                }
+                else
+                {
+                    m_unready.push_back(*h);
+                }
+            }
+        }
+    }
+    else
+    {
+        for (std::size_t i = m_inFlight.size(); i > 0; --i)
+        {
+            typename EntryList::iterator pEntry   = m_inFlight[i - 1];
+            Element *                    pElement = GetElement(pEntry->handle);
+            if (pElement != 0)
+            {
+                Complete(pEntry, pElement, pAvailable);
+            }
+        }
+    }
+
+    m_predictionBudget = m_maxPredictedPrefetches;
 
-    while (!HasRoomFor(key) && pEntry != m_entries.end())
+    // Start queued loads, earliest deadline first. The requests that cannot start yet are set aside, so that the
+    // loads behind them may start, and then put back.
+
+    m_stalled.clear();
+    while (!m_queue.empty() && LoadSlotAvailable())
     {
-        if (pEntry->state == Entry::STATE_RELEASED || pEntry->state == Entry::STATE_PREFETCHED)
+        std::pop_heap(m_queue.begin(), m_queue.end(), typename Pending::later());
+        Pending pending = m_queue.back();
+        m_queue.pop_back();
+
+        typename EntryList::iterator pEntry = pending.pEntry;
+        bool                         noRoom = false;
+        if (Start(pEntry, &noRoom))
         {
-            pEntry = Evict(pEntry);
+            continue;
+        }
+
+        // The request has already been accepted, so it waits for room as long as some entry that is loaded or
+        // loading could be released to make room. It is counted as a failure only the first time it stalls.
+
+        bool const waits = pEntry->state == Entry::STATE_REQUESTED && noRoom &&
+                           m_entries.size() > m_queue.size() + m_stalled.size() + 1;
+        if (pEntry->state == Entry::STATE_REQUESTED && !pEntry->stalled)
+        {
+            pEntry->stalled = true;
+            ++m_statistics.requestFailures;
+        }
+
+        if (waits)
+        {
+            m_stalled.push_back(pending);
         }
         else
         {
-            ++pEntry;
+            // A prefetch is not worth waiting for, and a request that can never be loaded is removed
+
+            if (pEntry->state == Entry::STATE_PREFETCHED)
+            {
+                ++m_statistics.prefetchFailures;
+            }
+            pEntry->queued = false;
+            Fail(pEntry);
+        }
+    }
+
+    for (typename PendingQueue::const_iterator p = m_stalled.begin(); p != m_stalled.end(); ++p)
+    {
+        m_queue.push_back(*p);
+        std::push_heap(m_queue.begin(), m_queue.end(), typename Pending::later());
+    }
+
+    UpdateStorage();
+}
+
+//! A derived class that moves elements (e.g. to compact its storage) uses this function to determine whether an
+//! element may be moved. Released elements and loaded prefetched elements are not in use, so they may be moved at
+//! any time. Available elements are in use, since the application may hold pointers to them, so they may only be
+//! moved at a safe point, i.e. when the application guarantees that it does not hold any pointers returned by
+//! Get(). Elements that are still loading may never be moved.
+//!
+//! @param	entry		Reference to the element's entry (see SetEntry())
+//! @param	safePoint	If @c true, the application holds no pointers to elements
+
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+bool AsynchronousCache<Element, Key, Handle, Hash, Tracer>::IsRelocatable(EntryRef entry, bool safePoint) const
+{
+    Entry const * pEntry = static_cast<Entry const *>(entry);
+    if (pEntry->queued || pEntry->loading)
+    {
+        return false;
+    }
+
+    return pEntry->state == Entry::STATE_RELEASED ||
+           pEntry->state == Entry::STATE_PREFETCHED ||
+           (pEntry->state == Entry::STATE_AVAILABLE && safePoint);
+}
+
+//! After a derived class moves an element, it calls this function so that the cache returns the new address.
+//!
+//! @param	entry		Reference to the element's entry (see SetEntry())
+//! @param	pElement	New address of the element
+
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+void AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Relocated(EntryRef entry, Element * pElement)
+{
+    Entry * pEntry = const_cast<Entry *>(static_cast<Entry const *>(entry));
+    if (pEntry->pElement != 0)
+    {
+        pEntry->pElement = pElement;
+    }
+}
+
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+template <typename K>
+bool AsynchronousCache<Element, Key, Handle, Hash, Tracer>::RequestKey(K && key, std::size_t hash,
+                                                                       TimePoint const * pDeadline)
+{
+    bool ok      = true;
+    bool sampled = m_pMissRatioEstimator != 0 && m_pMissRatioEstimator->Sample(hash);
+
+    // Check if the element is already in the cache. If it is, then reload it if it is being evicted. If it is not
+    // already in the cache, then load the element.
+
+    typename EntryList::iterator pEntry = Find(key, hash);
+
+    if (pEntry != m_entries.end())
+    {
+        // The request is reported to the predictor and the estimator with the entry's key and size, so that a key
+        // is never constructed from a lookup key
+
+        Observe(pEntry, sampled);
+        ++pEntry->accesses;
+
+        // Check the state of the entry and do the appropriate thing.
+
+        switch (pEntry->state)
+        {
+            case Entry::STATE_AVAILABLE:    // Already available, nothing to do
+                ++m_statistics.requestHits;
+                break;
+
+            case Entry::STATE_REQUESTED:
+            case Entry::STATE_PREFETCHED:
+            {
+                if (pEntry->state == Entry::STATE_PREFETCHED)
+                {
+                    ++m_statistics.prefetchHits;
+                    pEntry->fetched = std::chrono::steady_clock::now(); // The wait for the request starts now
+                }
+                else
+                {
+                    ++m_statistics.requestHits;
+                }
+
+                // If the load is still waiting in the queue, then start it now if there is no deadline, or move it up
+                // in the queue if the deadline is sooner.
+
+                if (pEntry->queued)
+                {
+                    SetState(pEntry, Entry::STATE_REQUESTED);
+                    if (pDeadline == 0)
+                    {
+                        Dequeue(pEntry);
+                        ok = Start(pEntry);
+                        if (!ok)
+                        {
+                            Fail(pEntry);
+                        }
+                    }
+                    else if (*pDeadline < pEntry->deadline)
+                    {
+                        Dequeue(pEntry);
+                        Enqueue(pEntry, *pDeadline);
+                    }
+                    break;
+                }
+
+                if (pEntry->state == Entry::STATE_REQUESTED)
+                {
+                    break; // Not available yet, nothing else to do
+                }
+
+                // If the element has been loaded, then it is available now. Otherwise, it is requested.
+
+                SetState(pEntry, Entry::STATE_REQUESTED);
+                if (pEntry->loading)
+                {
+                    Element * pElement = m_lazyPromotion ? GetElement(pEntry->handle) : 0;
+                    if (pElement != 0)
+                    {
+                        Complete(pEntry, pElement);
+                    }
+                }
+                else
+                {
+                    SetState(pEntry, Entry::STATE_AVAILABLE);
+                }
+                break;
+            }
+            case Entry::STATE_RELEASED:
+                ++m_statistics.reloads;
+                Reload(pEntry);
+                break;
+        }
+    }
+    else if (pDeadline == 0 || CanStartBefore(*pDeadline))
+    {
+        ++m_statistics.requestMisses;
+        pEntry = Insert(std::forward<K>(key), hash, Entry::STATE_REQUESTED);
+        Observe(pEntry, sampled);
+        pEntry->queued = true;
+        ok = Start(pEntry);
+        if (!ok)
+        {
+            Fail(pEntry);
+        }
+    }
+    else
+    {
+        // The load limits have been reached, so the request waits in the queue until Update() starts it.
+
+        ++m_statistics.requestMisses;
+        pEntry = Insert(std::forward<K>(key), hash, Entry::STATE_REQUESTED);
+        Observe(pEntry, sampled);
+        Enqueue(pEntry, *pDeadline);
+    }
+
+    if (!ok)
+    {
+        ++m_statistics.requestFailures;
+    }
+
+    if (m_pPredictor)
+    {
+        PrefetchPredictions();
+    }
+
+    return ok;
+}
+
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+void AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Release(typename EntryList::iterator & pEntry,
+                                                                    bool forceEviction)
+{
+    // If this entry is not yet available or it is a forced eviction, then go ahead and evict now.
+    // Otherwise, mark it as being evicted and move it to the end (so it is unloaded after any
+    // entry that was evicted before it).
+
+    if (pEntry->state == Entry::STATE_REQUESTED || forceEviction)
+    {
+        Evict(pEntry, forceEviction);
+    }
+    else if (pEntry->state == Entry::STATE_AVAILABLE)
+    {
+        SetState(pEntry, Entry::STATE_RELEASED);
+        m_entries.splice(m_entries.end(), m_entries, pEntry);
+        Trace(TRACE_RELEASE, pEntry);
+    }
+    else
+    {
+        // error can only release requested or available elements
+    }
+}
+
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+template <typename K>
+typename std::list<typename AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Entry>::iterator AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Find(
+    K const & key,
+    typename std::enable_if<is_lookup_key<K>::value>::type *)
+{
+    return Find(key, HashOf(key));
+}
+
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+template <typename K>
+typename std::list<typename AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Entry>::iterator AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Find(
+    K const &   key,
+    std::size_t hash)
+{
+    // Return an element with a matching key, or m_entries.end()
+
+    return std::find_if(m_entries.begin(), m_entries.end(), typename Entry::template key_equals<K>(key, hash));
+}
+
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+typename std::list<typename AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Entry>::iterator AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Find(
+    Handle const & handle)
+{
+    // Return an element with a matching handle, or m_entries.end()
+
+    return std::find_if(m_entries.begin(), m_entries.end(), typename Entry::handle_equals(handle));
+}
+
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+typename std::list<typename AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Entry>::iterator AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Find(
+    Element const * pElement)
+{
+    // Return an element with a matching address, or m_entries.end()
+
+    return std::find_if(m_entries.begin(), m_entries.end(), typename Entry::pointer_equals(pElement));
+}
+
+//! When lazy promotion is enabled, Get() and Request() check whether a loading element has been loaded by calling
+//! GetElement(). When it is disabled, elements become available only in Update(), and Get() simply returns the
+//! state of the entry without any virtual function calls. Disabling lazy promotion is useful when Update() is
+//! called regularly and GetElement() is expensive.
+//!
+//! @param	enable	If @c true, Get() and Request() promote loaded elements
+
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+void AsynchronousCache<Element, Key, Handle, Hash, Tracer>::SetLazyPromotion(bool enable)
+{
+    m_lazyPromotion = enable;
+}
+
+//! The predictor is told about every request, and the keys it predicts are prefetched (subject to the load limits).
+//! The number of predicted prefetches may be limited per call to Update(). The cache does not own the predictor.
+//!
+//! @param	pPredictor					Predictor to attach, or @c nullptr to detach the current one
+//! @param	maxPrefetchesPerUpdate		Maximum number of predicted prefetches between calls to Update() (0 means no
+//!										limit)
+
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+void AsynchronousCache<Element, Key, Handle, Hash, Tracer>::SetPredictor(PrefetchPredictor<Key> * pPredictor,
+                                                                         std::size_t maxPrefetchesPerUpdate /* = 0*/)
+{
+    m_pPredictor             = pPredictor;
+    m_maxPredictedPrefetches = maxPrefetchesPerUpdate;
+    m_predictionBudget       = maxPrefetchesPerUpdate;
+}
+
+//! The estimator is told about every request (Get() only reads the elements that have been requested, so it is not
+//! a reference to the cache). The cache does not own the estimator.
+//!
+//! @param	pEstimator	Estimator to attach, or @c nullptr to detach the current one
+
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+void AsynchronousCache<Element, Key, Handle, Hash, Tracer>::SetMissRatioEstimator(MissRatioEstimator * pEstimator)
+{
+    m_pMissRatioEstimator = pEstimator;
+}
+
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+bool AsynchronousCache<Element, Key, Handle, Hash, Tracer>::MakeRoomForNewEntry(Key const & key)
+{
+    // Go through the list from front to back evicting entries until there is room for the entry
+    // or there are no more entries to evict.
+
+    typename EntryList::iterator pEntry;
+
+    // First, evict released elements whose eviction would make room by itself. Then, if there still isn't room,
+    // evict released elements regardless.
+
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        pEntry = m_entries.begin();
+
+        while (!HasRoomFor(key) && pEntry != m_entries.end())
+        {
+            // Queued entries have not been loaded, so evicting them would not make any room.
+
+            if (!pEntry->queued &&
+                (pEntry->state == Entry::STATE_RELEASED || pEntry->state == Entry::STATE_PREFETCHED) &&
+                (pass > 0 || EvictionMakesRoomFor(pEntry->handle, key)))
+            {
+                pEntry = Evict(pEntry);
+                ++m_statistics.evictions;
+            }
+            else
+            {
+                ++pEntry;
+            }
         }
     }
 
     return HasRoomFor(key);
 }
 
-template <typename Element, typename Key, typename Handle>
-typename std::list<typename AsynchronousCache<Element, Key, Handle>::Entry>::iterator AsynchronousCache<Element, Key,
-                                                                                                        Handle>::Evict(
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+typename std::list<typename AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Entry>::iterator AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Evict(
+    typename EntryList::iterator & pEntry,
+    bool                           discard /* = false*/)
+{
+    Trace(TRACE_EVICT, pEntry);
+
+    if (pEntry->queued)
+    {
+        Dequeue(pEntry);                        // Never loaded, so just remove it from the queue
+    }
+    else
+    {
+        Retire(pEntry);                         // Cancel the load (if it is still in flight)
+        if (discard)
+        {
+            Discard(pEntry->handle);            // Discard the data
+        }
+        else
+        {
+            Unload(pEntry->handle);             // Unload the data
+        }
+    }
+    return Remove(pEntry);                      // Erase the cache entry
+}
+
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+typename std::list<typename AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Entry>::iterator AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Remove(
     typename EntryList::iterator & pEntry)
 {
-    Unload(pEntry->handle);                     // Unload the data
-    return m_entries.erase(pEntry);             // Erase the cache entry
+    --m_stateCounts[pEntry->state];
+    m_stateBytes[pEntry->state] -= pEntry->size;
+    return m_entries.erase(pEntry);
+}
+
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+void AsynchronousCache<Element, Key, Handle, Hash, Tracer>::SetState(typename EntryList::iterator & pEntry,
+                                                                     typename Entry::State        state)
+{
+    --m_stateCounts[pEntry->state];
+    m_stateBytes[pEntry->state] -= pEntry->size;
+    pEntry->state = state;
+    ++m_stateCounts[state];
+    m_stateBytes[state] += pEntry->size;
+}
+
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+template <typename K>
+typename std::list<typename AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Entry>::iterator AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Insert(
+    K &&                  key,
+    std::size_t           hash,
+    typename Entry::State state)
+{
+    // The entry is constructed in place, so the key is never copied (and it may be move-only)
+
+    typename EntryList::iterator pEntry =
+        m_entries.emplace(m_entries.end(), std::forward<K>(key), hash, Handle(), state);
+    pEntry->size     = SizeOf(pEntry->key);
+    pEntry->fetched  = std::chrono::steady_clock::now();
+    pEntry->accesses = (state == Entry::STATE_REQUESTED) ? 1 : 0;
+    ++m_stateCounts[state];
+    m_stateBytes[state] += pEntry->size;
+    Trace(TRACE_FETCH, pEntry);
+    return pEntry;
 }
 
-template <typename Element, typename Key, typename Handle>
-typename std::list<typename AsynchronousCache<Element, Key, Handle>::Entry>::iterator AsynchronousCache<Element, Key,
-                                                                                                        Handle>::Fetch(
-    Key const &  key,
-    Entry::State state)
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+template <typename K>
+typename std::list<typename AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Entry>::iterator AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Fetch(
+    K &&                  key,
+    std::size_t           hash,
+    typename Entry::State state)
 {
-    // If the cache has reached its limit, then evict elements to make room for the one to be loaded.
+    // Add the entry to the list and start loading it
 
-    EntryList::iterator pEntry = m_entries.end();
+    typename EntryList::iterator pEntry = Insert(std::forward<K>(key), hash, state);
+    pEntry->queued = true;
 
-    if (MakeRoomForNewEntry(key))
+    if (!Start(pEntry))
     {
-        // Start loading the stream
+        Fail(pEntry);
+        pEntry = m_entries.end();
+    }
 
-        Handle handle = Load(key);
+    return pEntry;
+}
 
-        // Add the entry to the list. Add it to the back so it is the last to be evicted.
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+bool AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Start(typename EntryList::iterator & pEntry,
+                                                                  bool *                         pNoRoom /* = 0*/)
+{
+    // If the cache has reached its limit, then evict elements to make room for the one to be loaded. If there still
+    // isn't enough room, then give up.
 
-        pEntry = m_entries.insert(m_entries.end(), Entry(key, handle, state));
+    if (!MakeRoomForNewEntry(pEntry->key))
+    {
+        if (pNoRoom != 0)
+        {
+            *pNoRoom = true;
+        }
+        return false;
     }
 
-    return pEntry;
+    // Start loading the element
+
+    Handle handle = Load(pEntry->key);
+    if (handle == Handle())
+    {
+        return false;
+    }
+
+    SetEntry(handle, &*pEntry);
+    pEntry->handle  = handle;
+    pEntry->queued  = false;
+    pEntry->loading = true;
+    pEntry->flight  = m_inFlight.size();
+    m_inFlight.push_back(pEntry);
+    m_flightIndex.emplace(pEntry->handle, pEntry);
+    m_byteBudget -= (double)pEntry->size;
+
+    // Move the entry to the back so it is the last to be evicted.
+
+    m_entries.splice(m_entries.end(), m_entries, pEntry);
+    return true;
 }
 
-template <typename Element, typename Key, typename Handle>
-void AsynchronousCache<Element, Key, Handle>::Reload(typename EntryList::iterator & pEntry)
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+void AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Fail(typename EntryList::iterator & pEntry)
 {
-    pEntry->state = Entry::STATE_AVAILABLE;
+    // The element was never loaded, so there is nothing to unload
+
+    Trace(TRACE_FAIL, pEntry);
+    Remove(pEntry);
+}
+
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+void AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Enqueue(typename EntryList::iterator & pEntry,
+                                                                    TimePoint deadline)
+{
+    Pending pending = { deadline, m_sequence++, pEntry };
+    m_queue.push_back(pending);
+    std::push_heap(m_queue.begin(), m_queue.end(), typename Pending::later());
+    pEntry->queued   = true;
+    pEntry->deadline = deadline;
+}
+
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+void AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Dequeue(typename EntryList::iterator & pEntry)
+{
+    m_queue.erase(std::find_if(m_queue.begin(), m_queue.end(), typename Pending::entry_equals(pEntry)));
+    std::make_heap(m_queue.begin(), m_queue.end(), typename Pending::later());
+    pEntry->queued = false;
+}
+
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+void AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Reload(typename EntryList::iterator & pEntry)
+{
+    SetState(pEntry, Entry::STATE_AVAILABLE);
+    Trace(TRACE_RELOAD, pEntry);
+}
+
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+bool AsynchronousCache<Element, Key, Handle, Hash, Tracer>::CanStartBefore(TimePoint deadline)
+{
+    // A load may start now if there is a free load slot and no queued load is needed sooner
+
+    return (m_queue.empty() || deadline < m_queue.front().deadline) && LoadSlotAvailable();
+}
+
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+bool AsynchronousCache<Element, Key, Handle, Hash, Tracer>::LoadSlotAvailable()
+{
+    if (m_maxLoadsInFlight > 0 && m_inFlight.size() >= m_maxLoadsInFlight)
+    {
+        return false;
+    }
+
+    // Refill the byte budget according to the time elapsed since the last refill. The budget is capped at one
+    // second's worth so that an idle period does not allow a burst.
+
+    if (m_maxBytesPerSecond > 0)
+    {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        double elapsed = std::chrono::duration<double>(now - m_lastRefill).count();
+        m_lastRefill = now;
+        m_byteBudget = std::min(m_byteBudget + elapsed * (double)m_maxBytesPerSecond, (double)m_maxBytesPerSecond);
+        if (m_byteBudget <= 0.0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+void AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Retire(typename EntryList::iterator & pEntry)
+{
+    if (pEntry->loading)
+    {
+        pEntry->loading = false;
+
+        // The order of the loads in flight does not matter, so the last one is moved into the retired one's place.
+
+        m_inFlight[pEntry->flight]         = m_inFlight.back();
+        m_inFlight[pEntry->flight]->flight = pEntry->flight;
+        m_inFlight.pop_back();
+        m_flightIndex.erase(pEntry->handle);
+    }
+}
+
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+void AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Complete(typename EntryList::iterator & pEntry,
+                                                                     Element *                      pElement,
+                                                                     std::vector<Key> *             pAvailable /* = 0*/)
+{
+    Retire(pEntry);
+    pEntry->pElement = pElement;
+
+    // Record how long the element took to load, if the histograms are enabled. A released element is no longer
+    // wanted, so it is not recorded.
+
+    unsigned long long latency = 0;
+    if (m_pRequestLatency)
+    {
+        std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - pEntry->fetched;
+        latency = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    }
+
+    if (pEntry->state == Entry::STATE_REQUESTED)
+    {
+        if (m_pRequestLatency)
+        {
+            m_pRequestLatency->Record(latency);
+        }
+        SetState(pEntry, Entry::STATE_AVAILABLE);
+        if constexpr (std::is_copy_constructible<Key>::value)
+        {
+            if (pAvailable)
+            {
+                pAvailable->push_back(pEntry->key);
+            }
+        }
+    }
+    else if (pEntry->state == Entry::STATE_PREFETCHED && m_pPrefetchLatency)
+    {
+        m_pPrefetchLatency->Record(latency);
+    }
+    Trace(TRACE_PROMOTE, pEntry);
+}
+
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+void AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Predict(Key const & key)
+{
+    m_pPredictor->Observe(key);
+
+    m_predictions.clear();
+    if (m_maxPredictedPrefetches > 0 && m_predictionBudget == 0)
+    {
+        return;
+    }
+
+    m_pPredictor->Predict(key, m_predictions);
+}
+
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+void AsynchronousCache<Element, Key, Handle, Hash, Tracer>::Observe(typename EntryList::iterator const & pEntry,
+                                                                    bool                                 sampled)
+{
+    if (m_pPredictor)
+    {
+        Predict(pEntry->key);
+    }
+
+    // Only the sampled requests are recorded
+
+    if (sampled)
+    {
+        m_pMissRatioEstimator->Record(pEntry->hash, pEntry->size);
+    }
+}
+
+template <typename Element, typename Key, typename Handle, typename Hash, typename Tracer>
+void AsynchronousCache<Element, Key, Handle, Hash, Tracer>::PrefetchPredictions()
+{
+    // The predictions are scratch space, so their keys are moved into the cache
+
+    for (typename std::vector<Key>::iterator i = m_predictions.begin(); i != m_predictions.end(); ++i)
+    {
+        // Only elements not already in the cache count against the budget
+
+        std::size_t                  hash   = HashOf(*i);
+        typename EntryList::iterator pEntry = Find(*i, hash);
+        if (pEntry == m_entries.end())
+        {
+            if (m_maxPredictedPrefetches > 0)
+            {
+                if (m_predictionBudget == 0)
+                {
+                    break;
+                }
+                --m_predictionBudget;
+            }
+            PrefetchKey(std::move(*i), hash, pEntry);
+        }
+    }
+    m_predictions.clear();
 }
@@ -0,0 +1,428 @@
+/** @file *//********************************************************************************************************
+
+                                                   BuddyAllocator.h
+
+                                            Copyright 2006, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/AsynchronousCache/BuddyAllocator.h#1 $
+
+    $NoKeywords: $
+
+********************************************************************************************************************/
+
+#pragma once
+
+#include "Arena.h"
+
+#include <cstddef>
+#include <vector>
+
+//! A buddy allocator for elements of varying sizes in one contiguous block of memory.
+//!
+//! @param	Arena		Type of the memory managed by the allocator. The default is HeapArena. Large storage may
+//!						use HugePageArena to reduce TLB misses.
+//!
+//! The memory is managed as blocks whose sizes are the minimum block size times a power of two (the block's
+//! "order"). An allocation takes the smallest free block that is large enough, splitting larger blocks in half as
+//! necessary. When a block is freed, it is merged with its "buddy" (the other half of the block it was split from)
+//! if the buddy is free, and so on up. There is a free list for each order, so HasRoomFor() answers whether a
+//! contiguous block of the required size exists in O(1).
+//!
+//! If the capacity is not a power of two times the minimum block size, the memory is managed as several top-level
+//! blocks of decreasing size.
+//!
+//! @note	This class cannot be copied or assigned.
+
+template <typename Arena = HeapArena>
+class BuddyAllocator
+{
+public:
+
+    //! Constructor
+    explicit BuddyAllocator(std::size_t capacity, std::size_t minBlockSize = 4096);
+
+    BuddyAllocator(BuddyAllocator const &) = delete;                // Prevent copying
+    BuddyAllocator & operator =(BuddyAllocator const &) = delete;   // Prevent assignment
+
+    //! Allocates a block of memory, or returns nullptr if there is no free block large enough
+    void * Allocate(std::size_t size);
+
+    //! Allocates a block of memory at a lower address than another, or returns nullptr if there is none
+    void * AllocateBelow(std::size_t size, void * p);
+
+    //! Frees a block of memory returned by Allocate()
+    void Free(void * p);
+
+    //! Returns true if a block of the given size can be allocated
+    bool HasRoomFor(std::size_t size) const;
+
+    //! Returns true if freeing the block would make room for a block of the given size
+    bool FreeingMakesRoomFor(void * p, std::size_t size) const;
+
+    //! Returns the size of the memory managed by the allocator
+    std::size_t GetCapacity() const { return m_arena.GetSize(); }
+
+    //! Returns the number of bytes in allocated blocks
+    std::size_t GetBytesInUse() const { return m_bytesInUse; }
+
+    //! Returns the size of the largest free block
+    std::size_t GetLargestFreeBlock() const;
+
+    //! Returns the fraction of the free memory that is not in the largest free block
+    double GetFragmentation() const;
+
+    //! Returns the arena
+    Arena const & GetArena() const { return m_arena; }
+
+    //! Returns the size of the pages backing the arena, or 0 if it is not known
+    std::size_t GetPageSize() const { return m_arena.GetPageSize(); }
+
+    //! Returns the kind of pages backing the arena
+    PageKind GetPageKind() const { return m_arena.GetPageKind(); }
+
+private:
+
+    // A free block. The free lists are stored in the free blocks themselves.
+    struct FreeBlock
+    {
+        FreeBlock * pPrev;
+        FreeBlock * pNext;
+    };
+
+    // Values of m_info, which describes the block starting at each unit
+    enum
+    {
+        INFO_FREE = 0x80,   // Flag set if the block is free (the rest of the value is the order)
+        INFO_NONE = 0xff    // No block starts at this unit
+    };
+
+    // Returns the order of the smallest block that can hold the size, or MAX_ORDERS if it is too large
+    unsigned OrderOf(std::size_t size) const;
+
+    // Returns the address of the block starting at the specified unit
+    FreeBlock * Address(std::size_t unit) const;
+
+    // Adds a block to the free list for its order
+    void Push(std::size_t unit, unsigned order);
+
+    // Removes a block from the free list for its order
+    void Remove(std::size_t unit, unsigned order);
+
+    // Returns true if the buddy of a block exists and is free
+    bool BuddyIsFree(std::size_t unit, unsigned order) const;
+
+    // Maximum number of orders
+    static unsigned const MAX_ORDERS = 64;
+
+    // Returns the usable capacity (a multiple of the minimum block size)
+    static std::size_t Usable(std::size_t capacity, std::size_t minBlockSize);
+
+    Arena m_arena;                          // Memory for the blocks
+    std::size_t m_minBlockSize;             // Size of a block of order 0 (a unit)
+    std::size_t m_units;                    // Number of units in the memory
+    std::vector<unsigned char> m_info;      // Describes the block starting at each unit
+    FreeBlock * m_free[MAX_ORDERS];         // Free lists, by order
+    unsigned long long m_nonEmpty;          // Bit n is set if the free list for order n is not empty
+    std::size_t m_bytesInUse;               // Number of bytes in allocated blocks
+};
+
+//! @param	capacity		Size of the memory managed by the allocator. It is rounded down to a multiple of the
+//!							minimum block size.
+//! @param	minBlockSize	Size of the smallest block. It should be a power of two no smaller than 16.
+
+template <typename Arena>
+BuddyAllocator<Arena>::BuddyAllocator(std::size_t capacity, std::size_t minBlockSize /* = 4096*/)
+    : m_arena(Usable(capacity, minBlockSize)),
+    m_minBlockSize(minBlockSize),
+    m_units(Usable(capacity, minBlockSize) / minBlockSize),
+    m_info(m_units, (unsigned char)INFO_NONE),
+    m_nonEmpty(0),
+    m_bytesInUse(0)
+{
+    for (unsigned i = 0; i < MAX_ORDERS; ++i)
+    {
+        m_free[i] = 0;
+    }
+
+    // Divide the memory into the largest possible blocks, largest first so that each is aligned to its size.
+
+    std::size_t unit = 0;
+    for (unsigned order = MAX_ORDERS; order-- > 0;)
+    {
+        if (order < sizeof(std::size_t) * 8 && ((std::size_t)1 << order) <= m_units - unit)
+        {
+            Push(unit, order);
+            unit += (std::size_t)1 << order;
+        }
+    }
+}
+
+//! @param	size	Number of bytes to allocate
+//!
+//! @return		The address of the block, or nullptr if there is no free block large enough
+
+template <typename Arena>
+void * BuddyAllocator<Arena>::Allocate(std::size_t size)
+{
+    unsigned order = OrderOf(size);
+    if (order >= MAX_ORDERS)
+    {
+        return 0;
+    }
+
+    // Find the smallest free block that is large enough
+
+    unsigned long long candidates = m_nonEmpty & ~((1ull << order) - 1);
+    if (candidates == 0)
+    {
+        return 0;
+    }
+
+    unsigned j = order;
+    while ((candidates & (1ull << j)) == 0)
+    {
+        ++j;
+    }
+
+    std::size_t unit = (reinterpret_cast<char *>(m_free[j]) - static_cast<char *>(m_arena.GetMemory())) /
+                       m_minBlockSize;
+    Remove(unit, j);
+
+    // Split it until it is the right size, freeing the upper halves
+
+    while (j > order)
+    {
+        --j;
+        Push(unit + ((std::size_t)1 << j), j);
+    }
+
+    m_info[unit]  = (unsigned char)order;
+    m_bytesInUse += m_minBlockSize << order;
+    return Address(unit);
+}
+
+//! This function is used to compact the memory. It allocates the lowest free block that is large enough and is at a
+//! lower address than @a p. Moving the contents of @a p to the new block and then freeing @a p concentrates the
+//! allocated blocks at the bottom of the memory, which lets the free blocks at the top merge.
+//!
+//! @param	size	Number of bytes to allocate
+//! @param	p		The new block must be below this address
+//!
+//! @return		The address of the block, or nullptr if there is no such block
+
+template <typename Arena>
+void * BuddyAllocator<Arena>::AllocateBelow(std::size_t size, void * p)
+{
+    unsigned order = OrderOf(size);
+    if (order >= MAX_ORDERS)
+    {
+        return 0;
+    }
+
+    // Find the lowest free block that is large enough and below p
+
+    FreeBlock * pBest     = 0;
+    unsigned    bestOrder = 0;
+    for (unsigned j = order; j < MAX_ORDERS; ++j)
+    {
+        for (FreeBlock * pBlock = m_free[j]; pBlock != 0; pBlock = pBlock->pNext)
+        {
+            if (static_cast<void *>(pBlock) < p && (pBest == 0 || pBlock < pBest))
+            {
+                pBest     = pBlock;
+                bestOrder = j;
+            }
+        }
+    }
+
+    if (pBest == 0)
+    {
+        return 0;
+    }
+
+    std::size_t unit = (reinterpret_cast<char *>(pBest) - static_cast<char *>(m_arena.GetMemory())) / m_minBlockSize;
+    Remove(unit, bestOrder);
+
+    // Split it until it is the right size, freeing the upper halves
+
+    while (bestOrder > order)
+    {
+        --bestOrder;
+        Push(unit + ((std::size_t)1 << bestOrder), bestOrder);
+    }
+
+    m_info[unit]  = (unsigned char)order;
+    m_bytesInUse += m_minBlockSize << order;
+    return Address(unit);
+}
+
+//! @param	p	Address of the block to free. If it is nullptr, nothing is done.
+
+template <typename Arena>
+void BuddyAllocator<Arena>::Free(void * p)
+{
+    if (p == 0)
+    {
+        return;
+    }
+
+    std::size_t unit  = (static_cast<char *>(p) - static_cast<char *>(m_arena.GetMemory())) / m_minBlockSize;
+    unsigned    order = m_info[unit];
+
+    m_bytesInUse -= m_minBlockSize << order;
+    m_info[unit]  = (unsigned char)INFO_NONE;
+
+    // Merge the block with its buddy for as long as the buddy is free
+
+    while (BuddyIsFree(unit, order))
+    {
+        std::size_t buddy = unit ^ ((std::size_t)1 << order);
+        Remove(buddy, order);
+        m_info[buddy] = (unsigned char)INFO_NONE;
+        unit          = (unit < buddy) ? unit : buddy;
+        ++order;
+    }
+
+    Push(unit, order);
+}
+
+//! @param	size	Number of bytes
+
+template <typename Arena>
+bool BuddyAllocator<Arena>::HasRoomFor(std::size_t size) const
+{
+    unsigned order = OrderOf(size);
+    return order < MAX_ORDERS && (m_nonEmpty & ~((1ull << order) - 1)) != 0;
+}
+
+//! This function determines whether freeing an allocated block would, by itself or by merging with free buddies,
+//! create a free block large enough for the size.
+//!
+//! @param	p		Address of an allocated block
+//! @param	size	Number of bytes
+
+template <typename Arena>
+bool BuddyAllocator<Arena>::FreeingMakesRoomFor(void * p, std::size_t size) const
+{
+    unsigned needed = OrderOf(size);
+    if (needed >= MAX_ORDERS)
+    {
+        return false;
+    }
+
+    std::size_t unit  = (static_cast<char *>(p) - static_cast<char *>(m_arena.GetMemory())) / m_minBlockSize;
+    unsigned    order = m_info[unit];
+
+    while (order < needed && BuddyIsFree(unit, order))
+    {
+        std::size_t buddy = unit ^ ((std::size_t)1 << order);
+        unit = (unit < buddy) ? unit : buddy;
+        ++order;
+    }
+
+    return order >= needed;
+}
+
+template <typename Arena>
+std::size_t BuddyAllocator<Arena>::GetLargestFreeBlock() const
+{
+    if (m_nonEmpty == 0)
+    {
+        return 0;
+    }
+
+    unsigned order = MAX_ORDERS - 1;
+    while ((m_nonEmpty & (1ull << order)) == 0)
+    {
+        --order;
+    }
+    return m_minBlockSize << order;
+}
+
+//! The fragmentation is 0 when the free memory is a single block (or there is none), and it approaches 1 as the
+//! free memory is split into more and smaller blocks.
+
+template <typename Arena>
+double BuddyAllocator<Arena>::GetFragmentation() const
+{
+    std::size_t free = m_units * m_minBlockSize - m_bytesInUse;
+    if (free == 0)
+    {
+        return 0.0;
+    }
+    return 1.0 - (double)GetLargestFreeBlock() / (double)free;
+}
+
+template <typename Arena>
+unsigned BuddyAllocator<Arena>::OrderOf(std::size_t size) const
+{
+    std::size_t units = (size + m_minBlockSize - 1) / m_minBlockSize;
+    unsigned    order = 0;
+    while (((std::size_t)1 << order) < units)
+    {
+        ++order;
+        if (order >= sizeof(std::size_t) * 8)
+        {
+            return MAX_ORDERS;
+        }
+    }
+    return order;
+}
+
+template <typename Arena>
+typename BuddyAllocator<Arena>::FreeBlock * BuddyAllocator<Arena>::Address(std::size_t unit) const
+{
+    return reinterpret_cast<FreeBlock *>(static_cast<char *>(m_arena.GetMemory()) + unit * m_minBlockSize);
+}
+
+template <typename Arena>
+void BuddyAllocator<Arena>::Push(std::size_t unit, unsigned order)
+{
+    FreeBlock * pBlock = Address(unit);
+    pBlock->pPrev = 0;
+    pBlock->pNext = m_free[order];
+    if (m_free[order] != 0)
+    {
+        m_free[order]->pPrev = pBlock;
+    }
+    m_free[order] = pBlock;
+    m_nonEmpty   |= 1ull << order;
+    m_info[unit]  = (unsigned char)(INFO_FREE | order);
+}
+
+template <typename Arena>
+void BuddyAllocator<Arena>::Remove(std::size_t unit, unsigned order)
+{
+    FreeBlock * pBlock = Address(unit);
+    if (pBlock->pPrev != 0)
+    {
+        pBlock->pPrev->pNext = pBlock->pNext;
+    }
+    else
+    {
+        m_free[order] = pBlock->pNext;
+    }
+    if (pBlock->pNext != 0)
+    {
+        pBlock->pNext->pPrev = pBlock->pPrev;
+    }
+    if (m_free[order] == 0)
+    {
+        m_nonEmpty &= ~(1ull << order);
+    }
+    m_info[unit] = (unsigned char)INFO_NONE;
+}
+
+template <typename Arena>
+bool BuddyAllocator<Arena>::BuddyIsFree(std::size_t unit, unsigned order) const
+{
+    std::size_t buddy = unit ^ ((std::size_t)1 << order);
+    return buddy + ((std::size_t)1 << order) <= m_units && m_info[buddy] == (unsigned char)(INFO_FREE | order);
+}
+
+template <typename Arena>
+std::size_t BuddyAllocator<Arena>::Usable(std::size_t capacity, std::size_t minBlockSize)
+{
+    return capacity / minBlockSize * minBlockSize;
+}
@@ -0,0 +1,208 @@
+/** @file *//********************************************************************************************************
+
+                                                   CompressedTier.h
+
+                                            Copyright 2006, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/AsynchronousCache/CompressedTier.h#1 $
+
+    $NoKeywords: $
+
+********************************************************************************************************************/
+
+#pragma once
+
+#include "ElementTier.h"
+#include "KeyHash.h"
+#include "LzCodec.h"
+
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+//! An in-memory tier of compressed elements evicted from a cache.
+//!
+//! @param	Key         Type of a key for accessing an element in the cache
+//! @param	Hash        Hash function for keys. The default is KeyHash, as in AsynchronousCache.
+//!
+//! When a StorageCache with a compressed tier unloads an element, the element's bytes are compressed (with LzCodec)
+//! and kept in this tier. When the element is loaded again, it is decompressed from the tier instead of being read,
+//! trading a little CPU time for an expensive read. The tier is exclusive: an element leaves the tier when it is
+//! loaded back into the cache. The tier has a fixed capacity (in compressed bytes), and the least recently inserted
+//! elements are discarded to make room. Elements that do not compress are stored as is.
+//!
+//! @note	This class cannot be copied or assigned.
+
+template <typename Key, typename Hash = KeyHash<Key>>
+class CompressedTier : public ElementTier<Key>
+{
+public:
+
+    //! Constructor
+    explicit CompressedTier(std::size_t capacity)
+        : m_capacity(capacity),
+        m_bytesInUse(0)
+    {
+    }
+
+    CompressedTier(CompressedTier const &) = delete;                // Prevent copying
+    CompressedTier & operator =(CompressedTier const &) = delete;   // Prevent assignment
+
+    //! Compresses an element and adds it to the tier. Returns false if it does not fit.
+    virtual bool Insert(Key const & key, void const * pData, std::size_t size) override;
+
+    //! Decompresses an element and removes it from the tier. Returns false if the element is not in the tier.
+    virtual bool Extract(Key const & key, void * pData, std::size_t size) override;
+
+    //! Returns true if the element is in the tier
+    bool Contains(Key const & key) const { return m_index.find(key) != m_index.end(); }
+
+    //! Removes an element from the tier
+    void Erase(Key const & key);
+
+    //! Removes all elements from the tier
+    void Clear();
+
+    //! Returns the capacity of the tier, in compressed bytes
+    std::size_t GetCapacity() const { return m_capacity; }
+
+    //! Returns the number of compressed bytes in the tier
+    std::size_t GetBytesInUse() const { return m_bytesInUse; }
+
+private:
+
+    // A compressed element
+    struct Item
+    {
+        Key key;                            // Key of the element
+        std::size_t size;                   // Uncompressed size
+        bool compressed;                    // False if the data is stored as is
+        std::vector<unsigned char> data;    // The (compressed) data
+    };
+
+    typedef std::list<Item> ItemList;
+    typedef std::unordered_map<Key, typename ItemList::iterator, Hash> ItemMap;
+
+    // Removes an item
+    void Erase(typename ItemList::iterator pItem);
+
+    std::size_t m_capacity;                 // Maximum number of compressed bytes
+    std::size_t m_bytesInUse;               // Number of compressed bytes
+    ItemList m_items;                       // The items, oldest first
+    ItemMap m_index;                        // Index of the items
+    std::vector<unsigned char> m_scratch;   // Scratch space for compression
+};
+
+//! If the element is already in the tier, it is replaced. The oldest elements are discarded to make room.
+//!
+//! @param	key		Key of the element
+//! @param	pData	The element's data
+//! @param	size	Size of the element
+//!
+//! @return		@c false, if the element does not fit in the tier even when it is empty
+
+template <typename Key, typename Hash>
+bool CompressedTier<Key, Hash>::Insert(Key const & key, void const * pData, std::size_t size)
+{
+    Erase(key);
+
+    LzCodec::Compress(pData, size, m_scratch);
+    bool        compressed = m_scratch.size() < size;
+    std::size_t stored     = compressed ? m_scratch.size() : size;
+
+    if (stored > m_capacity)
+    {
+        return false;
+    }
+
+    while (m_bytesInUse + stored > m_capacity)
+    {
+        Erase(m_items.begin());
+    }
+
+    Item item;
+    item.key        = key;
+    item.size       = size;
+    item.compressed = compressed;
+    if (compressed)
+    {
+        item.data.assign(m_scratch.begin(), m_scratch.end());
+    }
+    else
+    {
+        unsigned char const * p = static_cast<unsigned char const *>(pData);
+        item.data.assign(p, p + size);
+    }
+
+    typename ItemList::iterator pItem = m_items.insert(m_items.end(), std::move(item));
+    m_index.insert(typename ItemMap::value_type(key, pItem));
+    m_bytesInUse += stored;
+    return true;
+}
+
+//! @param	key		Key of the element
+//! @param	pData	Receives the element's data
+//! @param	size	Size of the element. If it does not match the size of the element in the tier, the element is
+//!					discarded.
+//!
+//! @return		@c false, if the element is not in the tier
+
+template <typename Key, typename Hash>
+bool CompressedTier<Key, Hash>::Extract(Key const & key, void * pData, std::size_t size)
+{
+    typename ItemMap::iterator i = m_index.find(key);
+    if (i == m_index.end())
+    {
+        return false;
+    }
+
+    Item const & item = *i->second;
+    bool         ok   = (item.size == size);
+    if (ok)
+    {
+        if (item.compressed)
+        {
+            ok = LzCodec::Decompress(item.data.data(), item.data.size(), pData, size);
+        }
+        else
+        {
+            std::memcpy(pData, item.data.data(), size);
+        }
+    }
+
+    Erase(i->second);
+    return ok;
+}
+
+//! @param	key		Key of the element
+
+template <typename Key, typename Hash>
+void CompressedTier<Key, Hash>::Erase(Key const & key)
+{
+    typename ItemMap::iterator i = m_index.find(key);
+    if (i != m_index.end())
+    {
+        Erase(i->second);
+    }
+}
+
+template <typename Key, typename Hash>
+void CompressedTier<Key, Hash>::Clear()
+{
+    m_index.clear();
+    m_items.clear();
+    m_bytesInUse = 0;
+}
+
+template <typename Key, typename Hash>
+void CompressedTier<Key, Hash>::Erase(typename ItemList::iterator pItem)
+{
+    m_bytesInUse -= pItem->data.size();
+    m_index.erase(pItem->key);
+    m_items.erase(pItem);
+}
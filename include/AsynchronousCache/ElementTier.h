@@ -0,0 +1,93 @@
+/** @file *//********************************************************************************************************
+
+                                                    ElementTier.h
+
+                                            Copyright 2006, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/AsynchronousCache/ElementTier.h#1 $
+
+    $NoKeywords: $
+
+********************************************************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+//! Secondary storage for elements evicted from a StorageCache.
+//!
+//! @param	Key         Type of a key for accessing an element in the cache
+//!
+//! When a StorageCache with a secondary tier unloads a loaded element, it offers the element's bytes to the tier.
+//! When it loads an element, it first tries to extract the element from the tier, and only reads it if the tier
+//! does not have it. A tier backed by slow storage (e.g. a SpillTier) may extract elements asynchronously by
+//! overriding StartExtract() and CancelExtract().
+
+template <typename Key>
+class ElementTier
+{
+public:
+
+    //! Status of an extraction started by StartExtract()
+    enum ExtractStatus
+    {
+        EXTRACT_PENDING,    //!< The element is being copied
+        EXTRACT_DONE,       //!< The element has been copied
+        EXTRACT_FAILED      //!< The element could not be copied, and the data must be read from elsewhere
+    };
+
+    //! Destructor
+    virtual ~ElementTier() {}
+
+    //! Adds an element to the tier.
+    //!
+    //! @param	key		Key of the element
+    //! @param	pData	The element's data
+    //! @param	size	Size of the element
+    //!
+    //! @return		@c false, if the tier did not keep the element
+
+    virtual bool Insert(Key const & key, void const * pData, std::size_t size) = 0;
+
+    //! Copies an element out of the tier.
+    //!
+    //! @param	key		Key of the element
+    //! @param	pData	Receives the element's data
+    //! @param	size	Size of the element
+    //!
+    //! @return		@c false, if the tier does not have the element
+
+    virtual bool Extract(Key const & key, void * pData, std::size_t size) = 0;
+
+    //! Starts copying an element out of the tier.
+    //!
+    //! If the tier has the element, it sets @a *pStatus to EXTRACT_DONE or EXTRACT_FAILED when the copy is
+    //! finished, possibly from another thread and possibly before this function returns. The default implementation
+    //! calls Extract() and completes immediately.
+    //!
+    //! @param	key			Key of the element
+    //! @param	pData		Receives the element's data
+    //! @param	size		Size of the element
+    //! @param	pStatus		Receives the status of the extraction. The caller sets it to EXTRACT_PENDING.
+    //!
+    //! @return		@c false, if the tier does not have the element (or will not provide it)
+
+    virtual bool StartExtract(Key const & key, void * pData, std::size_t size, std::atomic<int> * pStatus)
+    {
+        if (!Extract(key, pData, size))
+        {
+            return false;
+        }
+        *pStatus = EXTRACT_DONE;
+        return true;
+    }
+
+    //! Cancels an extraction started by StartExtract(). After this function returns, the tier no longer writes to
+    //! @a pData. The default implementation does nothing, which is only correct if extractions are synchronous.
+    //!
+    //! @param	pData		The destination of the extraction
+
+    virtual void CancelExtract(void * /* pData */) {}
+};
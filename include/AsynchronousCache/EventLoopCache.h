@@ -0,0 +1,185 @@
+/** @file *//********************************************************************************************************
+
+                                                   EventLoopCache.h
+
+                                            Copyright 2006, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/AsynchronousCache/EventLoopCache.h#1 $
+
+    $NoKeywords: $
+
+********************************************************************************************************************/
+
+#pragma once
+
+#include "AsynchronousCache.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <mutex>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#endif
+
+//! Asynchronous Cache for event-loop hosts.
+//!
+//! @param	Element     Type of the elements stored in the cache
+//! @param	Key         Type of a key for accessing an element in the cache
+//! @param	Handle      Type of an element handle. This is the type of the value returned by Load().
+//! @param	Tracer      Receives an event on every change of state of an entry. The default is NullTracer.
+//!
+//! @note	This class is an abstract base class and must be derived from in order to be used.
+//!
+//! This cache is intended for backends that complete loads on their own threads, and for hosts that run an event
+//! loop (epoll, poll, select, etc.) rather than polling the cache. When a load completes, the backend calls
+//! NotifyLoadCompleted() (from any thread). The file descriptor returned by GetCompletionFd() becomes readable, and
+//! the host calls DrainCompletions() to promote the completed loads and find out which elements are available.
+//!
+//! On Linux, the file descriptor is an eventfd. On other POSIX systems, it is the read end of a pipe.
+//!
+//! A load should be notified only once GetElement() returns its element. A load notified too early is checked again
+//! by each later call to DrainCompletions(), but the file descriptor is not signaled again for it.
+//!
+//! @note	Only NotifyLoadCompleted() is thread-safe. The rest of the cache must be used from a single thread.
+
+template <typename Element, typename Key, typename Handle = void *, typename Tracer = NullTracer>
+class EventLoopCache : public AsynchronousCache<Element, Key, Handle, KeyHash<Key>, Tracer>
+{
+public:
+
+    //! Constructor
+    EventLoopCache();
+
+    //! Destructor
+    virtual ~EventLoopCache();
+
+    //! Returns a file descriptor that becomes readable when a load completes
+    int GetCompletionFd() const { return m_readFd; }
+
+    //! Promotes the completed loads and returns the keys of the requested elements that became available
+    std::size_t DrainCompletions(std::vector<Key> & available);
+
+protected:
+
+    //! Notifies the cache that a load has completed. This function may be called from any thread.
+    void NotifyLoadCompleted(Handle const & handle);
+
+    //! Reports the loads that have been passed to NotifyLoadCompleted()
+    virtual bool PollCompletedLoads(std::vector<Handle> & completed) override;
+
+private:
+
+    // Empties the file descriptor so that it is no longer readable
+    void ResetFd();
+
+    int m_readFd;                       // The file descriptor to poll
+    int m_writeFd;                      // The file descriptor that is signaled (the same as m_readFd for an eventfd)
+    std::mutex m_mutex;                 // Guards m_notified
+    std::vector<Handle> m_notified;     // Handles of the loads completed since the last poll
+};
+
+//! @throw	std::system_error	If the file descriptor cannot be created
+
+template <typename Element, typename Key, typename Handle, typename Tracer>
+EventLoopCache<Element, Key, Handle, Tracer>::EventLoopCache()
+{
+#if defined(__linux__)
+    m_readFd  = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    m_writeFd = m_readFd;
+    if (m_readFd < 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "eventfd");
+    }
+#else
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "pipe");
+    }
+    for (int i = 0; i < 2; ++i)
+    {
+        fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+        fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+    }
+    m_readFd  = fds[0];
+    m_writeFd = fds[1];
+#endif
+}
+
+template <typename Element, typename Key, typename Handle, typename Tracer>
+EventLoopCache<Element, Key, Handle, Tracer>::~EventLoopCache()
+{
+    if (m_writeFd != m_readFd)
+    {
+        close(m_writeFd);
+    }
+    close(m_readFd);
+}
+
+//! This function clears the readiness of the file descriptor, promotes the loads reported by NotifyLoadCompleted()
+//! (see Update()), and appends the keys of the requested elements that became available. It is normally called when
+//! the file descriptor returned by GetCompletionFd() becomes readable.
+//!
+//! @param	available	Vector to which the keys of the newly available elements are appended
+//!
+//! @return		The number of keys appended to @a available
+
+template <typename Element, typename Key, typename Handle, typename Tracer>
+std::size_t EventLoopCache<Element, Key, Handle, Tracer>::DrainCompletions(std::vector<Key> & available)
+{
+    // Reset the file descriptor first so that a notification arriving during the update makes it readable again.
+
+    ResetFd();
+
+    std::size_t n = available.size();
+    this->Update(available);
+    return available.size() - n;
+}
+
+//! The handle is queued for the next call to DrainCompletions() (or Update()), and the file descriptor becomes
+//! readable.
+//!
+//! @param	handle	Handle of the element that has been loaded
+
+template <typename Element, typename Key, typename Handle, typename Tracer>
+void EventLoopCache<Element, Key, Handle, Tracer>::NotifyLoadCompleted(Handle const & handle)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_notified.push_back(handle);
+    }
+
+    // Signal the file descriptor. If it is already signaled (the counter or pipe is full), that is good enough.
+
+#if defined(__linux__)
+    std::uint64_t one = 1;
+#else
+    char one = 1;
+#endif
+    ssize_t written = write(m_writeFd, &one, sizeof(one));
+    (void)written;
+}
+
+template <typename Element, typename Key, typename Handle, typename Tracer>
+bool EventLoopCache<Element, Key, Handle, Tracer>::PollCompletedLoads(std::vector<Handle> & completed)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    completed.insert(completed.end(), m_notified.begin(), m_notified.end());
+    m_notified.clear();
+    return true;
+}
+
+template <typename Element, typename Key, typename Handle, typename Tracer>
+void EventLoopCache<Element, Key, Handle, Tracer>::ResetFd()
+{
+    char buffer[64];
+    while (read(m_readFd, buffer, sizeof(buffer)) > 0)
+    {
+    }
+}
@@ -0,0 +1,57 @@
+/** @file *//********************************************************************************************************
+
+                                                      KeyHash.h
+
+                                            Copyright 2006, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/AsynchronousCache/KeyHash.h#1 $
+
+    $NoKeywords: $
+
+********************************************************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+//! The default hash function for the keys of an AsynchronousCache.
+//!
+//! @param	Key         Type of a key
+//!
+//! Keys are hashed with std::hash<Key>. If std::hash<Key> is not defined, every key hashes to 0, and lookups simply
+//! compare keys. Strings are hashed as string views, so a string may also be looked up with a string view or a
+//! character array without constructing a string. A hash function that hashes values of other types (as the
+//! specialization for strings does) declares a member type named @c is_transparent.
+
+template <typename Key>
+struct KeyHash
+{
+    std::size_t operator ()(Key const & key) const
+    {
+        if constexpr (std::is_default_constructible<std::hash<Key>>::value)
+        {
+            return std::hash<Key>()(key);
+        }
+        else
+        {
+            return 0;
+        }
+    }
+};
+
+template <typename Char, typename Traits, typename Allocator>
+struct KeyHash<std::basic_string<Char, Traits, Allocator>>
+{
+    typedef void is_transparent;    //!< Values other than strings may be hashed
+
+    template <typename K>
+    std::size_t operator ()(K const & key) const
+    {
+        return std::hash<std::basic_string_view<Char, Traits>>()(std::basic_string_view<Char, Traits>(key));
+    }
+};
@@ -0,0 +1,232 @@
+/** @file *//********************************************************************************************************
+
+                                                  LatencyHistogram.h
+
+                                            Copyright 2006, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/AsynchronousCache/LatencyHistogram.h#1 $
+
+    $NoKeywords: $
+
+********************************************************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+
+//! A histogram of latencies with a log-linear bucket layout (as in HdrHistogram).
+//!
+//! Values below 2^SUB_BUCKET_BITS each have their own bucket. Above that, each power of two is divided into
+//! 2^(SUB_BUCKET_BITS - 1) equal buckets, so a bucket's width is never more than 1/32 of the values in it. This
+//! covers every 64-bit value in a fixed array of counts, and recording a value is a few instructions with no
+//! allocation. Percentiles are reported as the highest value in their bucket (clamped to the largest value
+//! recorded), so they are never too low.
+//!
+//! The histogram does not care about the units of the values. AsynchronousCache records nanoseconds.
+
+class LatencyHistogram
+{
+public:
+
+    static int const SUB_BUCKET_BITS = 6;   //!< Number of bits of precision of a bucket (log 2 of the linear range)
+
+    //! Number of buckets: the linear range, plus one group of half as many for each remaining power of two
+    static std::size_t const BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 2) * (std::size_t(1) << (SUB_BUCKET_BITS - 1));
+
+    //! Constructor
+    LatencyHistogram() { Reset(); }
+
+    //! Records a value
+    void Record(unsigned long long value);
+
+    //! Adds the values recorded by another histogram
+    void Merge(LatencyHistogram const & other);
+
+    //! Removes all values
+    void Reset();
+
+    //! Returns the number of values recorded
+    unsigned long long GetCount() const { return m_count; }
+
+    //! Returns the smallest value recorded (or 0 if there are none)
+    unsigned long long GetMin() const { return (m_count > 0) ? m_min : 0; }
+
+    //! Returns the largest value recorded (or 0 if there are none)
+    unsigned long long GetMax() const { return m_max; }
+
+    //! Returns the mean of the values recorded (or 0 if there are none)
+    double GetMean() const { return (m_count > 0) ? m_sum / (double)m_count : 0.0; }
+
+    //! Returns the value at or below which a percentage of the values fall (e.g. 99.9 for the 99.9th percentile)
+    unsigned long long GetPercentile(double percentile) const;
+
+    //! Returns the number of values in a bucket
+    unsigned long long GetBucket(std::size_t index) const { return m_buckets[index]; }
+
+    //! Returns the smallest value that falls in a bucket
+    static unsigned long long GetLowerBound(std::size_t index);
+
+    //! Returns the largest value that falls in a bucket
+    static unsigned long long GetUpperBound(std::size_t index);
+
+    //! Returns the index of the bucket a value falls in
+    static std::size_t IndexOf(unsigned long long value);
+
+private:
+
+    static std::size_t const LINEAR_COUNT = std::size_t(1) << SUB_BUCKET_BITS;    // Number of unit-width buckets
+    static std::size_t const HALF_COUNT   = LINEAR_COUNT / 2;                     // Number of buckets per power of 2
+
+    // Returns the index of the highest set bit of a non-zero value
+    static int HighBit(unsigned long long value);
+
+    unsigned long long m_buckets[BUCKET_COUNT]; // Number of values in each bucket
+    unsigned long long m_count;                 // Number of values recorded
+    unsigned long long m_min;                   // Smallest value recorded
+    unsigned long long m_max;                   // Largest value recorded
+    double m_sum;                               // Sum of the values recorded
+};
+
+//! @param	value	The value to record
+
+inline void LatencyHistogram::Record(unsigned long long value)
+{
+    ++m_buckets[IndexOf(value)];
+    if (m_count == 0 || value < m_min)
+    {
+        m_min = value;
+    }
+    if (value > m_max)
+    {
+        m_max = value;
+    }
+    ++m_count;
+    m_sum += (double)value;
+}
+
+//! @param	other	The histogram whose values are added to this one
+
+inline void LatencyHistogram::Merge(LatencyHistogram const & other)
+{
+    if (other.m_count == 0)
+    {
+        return;
+    }
+
+    for (std::size_t i = 0; i < BUCKET_COUNT; ++i)
+    {
+        m_buckets[i] += other.m_buckets[i];
+    }
+    if (m_count == 0 || other.m_min < m_min)
+    {
+        m_min = other.m_min;
+    }
+    if (other.m_max > m_max)
+    {
+        m_max = other.m_max;
+    }
+    m_count += other.m_count;
+    m_sum   += other.m_sum;
+}
+
+inline void LatencyHistogram::Reset()
+{
+    for (std::size_t i = 0; i < BUCKET_COUNT; ++i)
+    {
+        m_buckets[i] = 0;
+    }
+    m_count = 0;
+    m_min   = 0;
+    m_max   = 0;
+    m_sum   = 0.0;
+}
+
+//! @param	percentile	Percentage of the values, from 0 to 100
+//!
+//! @return		The highest value in the bucket containing the percentile, or 0 if no values have been recorded
+
+inline unsigned long long LatencyHistogram::GetPercentile(double percentile) const
+{
+    if (m_count == 0)
+    {
+        return 0;
+    }
+
+    // The rank of the value is rounded up, so that the 100th percentile is the largest value and the 0th is the
+    // smallest.
+
+    double             fraction = (percentile < 0.0) ? 0.0 : (percentile > 100.0) ? 1.0 : percentile / 100.0;
+    double             exact    = fraction * (double)m_count;
+    unsigned long long rank     = (unsigned long long)exact;
+    if (rank < exact || rank == 0)
+    {
+        ++rank;
+    }
+
+    unsigned long long total = 0;
+    for (std::size_t i = 0; i < BUCKET_COUNT; ++i)
+    {
+        total += m_buckets[i];
+        if (total >= rank)
+        {
+            unsigned long long value = GetUpperBound(i);
+            return (value < m_max) ? value : m_max;
+        }
+    }
+    return m_max;
+}
+
+//! @param	index	Index of the bucket
+
+inline unsigned long long LatencyHistogram::GetLowerBound(std::size_t index)
+{
+    if (index < LINEAR_COUNT)
+    {
+        return index;
+    }
+
+    // Buckets above the linear range come in groups of HALF_COUNT, each group twice as wide as the previous one
+
+    std::size_t shift = (index - LINEAR_COUNT) / HALF_COUNT + 1;
+    std::size_t sub   = (index - LINEAR_COUNT) % HALF_COUNT + HALF_COUNT;
+    return (unsigned long long)sub << shift;
+}
+
+//! @param	index	Index of the bucket
+
+inline unsigned long long LatencyHistogram::GetUpperBound(std::size_t index)
+{
+    return (index + 1 < BUCKET_COUNT) ? GetLowerBound(index + 1) - 1 : ~0ull;
+}
+
+//! @param	value	The value
+
+inline std::size_t LatencyHistogram::IndexOf(unsigned long long value)
+{
+    if (value < LINEAR_COUNT)
+    {
+        return (std::size_t)value;
+    }
+
+    // The top SUB_BUCKET_BITS bits of the value select the bucket within its power of two
+
+    int shift = HighBit(value) - SUB_BUCKET_BITS + 1;
+    return LINEAR_COUNT + (std::size_t)(shift - 1) * HALF_COUNT + (std::size_t)(value >> shift) - HALF_COUNT;
+}
+
+//! @param	value	The value, which must not be 0
+
+inline int LatencyHistogram::HighBit(unsigned long long value)
+{
+#if defined(__GNUC__)
+    return 63 - __builtin_clzll(value);
+#else
+    int bit = 0;
+    while (value >>= 1)
+    {
+        ++bit;
+    }
+    return bit;
+#endif
+}
@@ -0,0 +1,229 @@
+/** @file *//********************************************************************************************************
+
+                                                      LzCodec.h
+
+                                            Copyright 2006, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/AsynchronousCache/LzCodec.h#1 $
+
+    $NoKeywords: $
+
+********************************************************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+//! A fast LZ77 compressor.
+//!
+//! The compressed format is a sequence of blocks, each consisting of a token byte, an optional literal length
+//! extension, the literals, a 2-byte little-endian match offset, and an optional match length extension. The high
+//! nibble of the token is the number of literals and the low nibble is the match length minus 4. A nibble of 15 is
+//! extended by the following bytes, each added to it, until a byte less than 255. The last block has no match.
+//!
+//! Matches are found with a single-entry hash table of 4-byte sequences, which makes compression very fast at the
+//! expense of ratio. Decompression is bounds-checked, so corrupt input fails instead of overrunning the output.
+
+class LzCodec
+{
+public:
+
+    //! Compresses data. The compressed data is stored in @a compressed, replacing its contents.
+    static void Compress(void const * pData, std::size_t size, std::vector<unsigned char> & compressed);
+
+    //! Decompresses data. Returns false if the data is corrupt or does not decompress to exactly @a size bytes.
+    static bool Decompress(unsigned char const * pCompressed, std::size_t compressedSize, void * pData, std::size_t size);
+
+private:
+
+    static int const MIN_MATCH  = 4;            // Shortest match
+    static int const HASH_BITS  = 12;           // Size of the hash table (log 2)
+    static std::size_t const MAX_OFFSET = 65535;    // Largest match offset
+
+    // Returns the hash of the 4 bytes at p
+    static unsigned Hash(unsigned char const * p)
+    {
+        std::uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return (v * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    // Appends a length extension
+    static void PutLength(std::size_t length, std::vector<unsigned char> & out)
+    {
+        while (length >= 255)
+        {
+            out.push_back(255);
+            length -= 255;
+        }
+        out.push_back((unsigned char)length);
+    }
+
+    // Appends a block with the specified literals and match
+    static void PutBlock(unsigned char const * pLiterals,
+                         std::size_t literals,
+                         std::size_t offset,
+                         std::size_t match,
+                         std::vector<unsigned char> & out)
+    {
+        std::size_t matchCode = (match > 0) ? match - MIN_MATCH : 0;
+        out.push_back((unsigned char)(((literals < 15 ? literals : 15) << 4) | (matchCode < 15 ? matchCode : 15)));
+        if (literals >= 15)
+        {
+            PutLength(literals - 15, out);
+        }
+        out.insert(out.end(), pLiterals, pLiterals + literals);
+        if (match > 0)
+        {
+            out.push_back((unsigned char)(offset & 0xff));
+            out.push_back((unsigned char)(offset >> 8));
+            if (matchCode >= 15)
+            {
+                PutLength(matchCode - 15, out);
+            }
+        }
+    }
+
+    // Reads a length extension. Returns false if the input ends first.
+    static bool GetLength(unsigned char const * & p, unsigned char const * pEnd, std::size_t & length)
+    {
+        unsigned char b;
+        do
+        {
+            if (p >= pEnd)
+            {
+                return false;
+            }
+            b       = *p++;
+            length += b;
+        } while (b == 255);
+        return true;
+    }
+};
+
+//! @param	pData		Data to compress
+//! @param	size		Size of the data
+//! @param	compressed	Receives the compressed data
+
+inline void LzCodec::Compress(void const * pData, std::size_t size, std::vector<unsigned char> & compressed)
+{
+    compressed.clear();
+    compressed.reserve(size + size / 255 + 16);
+
+    unsigned char const * pBegin   = static_cast<unsigned char const *>(pData);
+    unsigned char const * pEnd     = pBegin + size;
+    unsigned char const * pAnchor  = pBegin;    // Start of the pending literals
+    unsigned char const * p        = pBegin;
+    std::size_t           table[1 << HASH_BITS] = { 0 };   // Position + 1 of the last sequence with each hash
+
+    while (size >= (std::size_t)MIN_MATCH && p <= pEnd - MIN_MATCH)
+    {
+        unsigned    h         = Hash(p);
+        std::size_t candidate = table[h];
+        table[h] = (std::size_t)(p - pBegin) + 1;
+
+        if (candidate > 0)
+        {
+            unsigned char const * q      = pBegin + candidate - 1;
+            std::size_t           offset = (std::size_t)(p - q);
+            if (offset <= MAX_OFFSET && std::memcmp(p, q, MIN_MATCH) == 0)
+            {
+                // Extend the match as far as possible
+
+                std::size_t match = MIN_MATCH;
+                while (p + match < pEnd && p[match] == q[match])
+                {
+                    ++match;
+                }
+
+                PutBlock(pAnchor, (std::size_t)(p - pAnchor), offset, match, compressed);
+                p      += match;
+                pAnchor = p;
+                continue;
+            }
+        }
+
+        ++p;
+    }
+
+    // The final block holds the remaining literals
+
+    PutBlock(pAnchor, (std::size_t)(pEnd - pAnchor), 0, 0, compressed);
+}
+
+//! @param	pCompressed		Compressed data
+//! @param	compressedSize	Size of the compressed data
+//! @param	pData			Receives the decompressed data
+//! @param	size			Size of the decompressed data
+//!
+//! @return		@c false, if the compressed data is corrupt
+
+inline bool LzCodec::Decompress(unsigned char const * pCompressed,
+                                std::size_t           compressedSize,
+                                void *                pData,
+                                std::size_t           size)
+{
+    unsigned char const * p       = pCompressed;
+    unsigned char const * pEnd    = pCompressed + compressedSize;
+    unsigned char *       pOut    = static_cast<unsigned char *>(pData);
+    unsigned char *       pOutEnd = pOut + size;
+
+    while (p < pEnd)
+    {
+        unsigned char token    = *p++;
+        std::size_t   literals = token >> 4;
+        if (literals == 15 && !GetLength(p, pEnd, literals))
+        {
+            return false;
+        }
+        if (literals > (std::size_t)(pEnd - p) || literals > (std::size_t)(pOutEnd - pOut))
+        {
+            return false;
+        }
+        std::memcpy(pOut, p, literals);
+        p    += literals;
+        pOut += literals;
+
+        // The last block has no match
+
+        if (p == pEnd)
+        {
+            break;
+        }
+
+        if (pEnd - p < 2)
+        {
+            return false;
+        }
+        std::size_t offset = p[0] | ((std::size_t)p[1] << 8);
+        p += 2;
+
+        std::size_t match = token & 0x0f;
+        if (match == 15 && !GetLength(p, pEnd, match))
+        {
+            return false;
+        }
+        match += MIN_MATCH;
+
+        if (offset == 0 || offset > (std::size_t)(pOut - static_cast<unsigned char *>(pData)) ||
+            match > (std::size_t)(pOutEnd - pOut))
+        {
+            return false;
+        }
+
+        // The match may overlap the output, so it is copied a byte at a time.
+
+        unsigned char const * q = pOut - offset;
+        for (std::size_t i = 0; i < match; ++i)
+        {
+            pOut[i] = q[i];
+        }
+        pOut += match;
+    }
+
+    return pOut == pOutEnd;
+}
@@ -0,0 +1,356 @@
+/** @file *//********************************************************************************************************
+
+                                                 MissRatioEstimator.h
+
+                                            Copyright 2006, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/AsynchronousCache/MissRatioEstimator.h#1 $
+
+    $NoKeywords: $
+
+********************************************************************************************************************/
+
+#pragma once
+
+#include "LatencyHistogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+//! Estimates the miss-ratio curve of a cache online, by spatial sampling (SHARDS).
+//!
+//! The miss-ratio curve gives the fraction of requests that would miss in an LRU cache of each capacity (in bytes).
+//! The estimator computes it from the reuse distances of the requests: the total size of the distinct elements
+//! requested since the previous request for the same element. Computing every reuse distance exactly takes memory
+//! proportional to the number of distinct keys, so only the keys whose (remixed) hashes fall below a threshold are
+//! tracked, and their distances are scaled up by the sampling rate. Since a key is either always or never sampled,
+//! the sampled keys see the same reuse pattern as all of the keys.
+//!
+//! The memory is bounded: at most a fixed number of keys are tracked. When a new key would exceed the limit, the key
+//! with the highest hash is dropped, the threshold is lowered to its hash, and the counts so far are scaled down to
+//! the new rate. The rate therefore adapts to the number of distinct keys. The histogram of distances is log-linear
+//! like LatencyHistogram's, so its resolution is about 3% at every scale.
+//!
+//! When an estimator is attached to an AsynchronousCache, the cache reports every request to it: Sample() counts the
+//! request, and Record() is called only for a sampled key. GetMissRatio() and GetMarginalUtility() may be used to
+//! move budget between caches at runtime, and Reset() starts a new measurement period.
+//!
+//! Sizes of 0 are counted as 1, so the curve of a cache that does not override SizeOf() is in elements.
+//!
+//! @note	This class is not thread-safe. Each shard of a ShardedCache needs its own estimator.
+
+class MissRatioEstimator
+{
+public:
+
+    //! A point on the miss-ratio curve
+    struct Point
+    {
+        std::uint64_t capacity;     //!< Capacity of the cache, in bytes
+        double missRatio;           //!< Fraction of the requests that miss at this capacity
+    };
+
+    static std::size_t const DEFAULT_MAX_SAMPLES = 8192;    //!< Default maximum number of keys tracked
+
+    //! Constructor
+    explicit MissRatioEstimator(double rate = 0.01, std::size_t maxSamples = DEFAULT_MAX_SAMPLES);
+
+    //! Counts a request. Returns true if its key is sampled, in which case Record() must be called for it.
+    bool Sample(std::size_t hash);
+
+    //! Records a request for a sampled key
+    void Record(std::size_t hash, std::uint64_t size);
+
+    //! Returns the estimated miss ratio of an LRU cache with the specified capacity
+    double GetMissRatio(std::uint64_t capacity) const;
+
+    //! Returns the estimated number of misses per byte that would be avoided by growing a cache
+    double GetMarginalUtility(std::uint64_t capacity, std::uint64_t delta) const;
+
+    //! Appends the estimated miss-ratio curve to @a curve, one point per bucket with samples, smallest first
+    void GetCurve(std::vector<Point> & curve) const;
+
+    //! Starts a new measurement period. The tracked keys are kept.
+    void Reset();
+
+    //! Returns the number of requests counted since the last reset
+    unsigned long long GetReferences() const { return m_references; }
+
+    //! Returns the number of keys tracked
+    std::size_t GetSampleCount() const { return m_samples.size(); }
+
+    //! Returns the current sampling rate
+    double GetRate() const { return m_rate; }
+
+private:
+
+    // A tracked key
+    struct TrackedKey
+    {
+        std::size_t slot;       // Slot of the most recent request for the key
+        std::uint64_t size;     // Size of the element at that request
+    };
+
+    // Returns a well-mixed hash, so that sampling does not depend on the quality of the cache's hash function
+    static std::uint64_t Mix(std::size_t hash);
+
+    // Adds a value to the size in a slot
+    void Add(std::size_t slot, std::int64_t value);
+
+    // Returns the total size in the slots before a slot
+    std::uint64_t Sum(std::size_t slot) const;
+
+    // Stops tracking the key with the highest hash and lowers the sampling rate
+    void Drop();
+
+    // Moves the tracked keys into the lowest slots, in order
+    void Compact();
+
+    std::map<std::uint64_t, TrackedKey> m_samples;  // The tracked keys, by mixed hash
+    std::vector<std::uint64_t> m_tree;          // Fenwick tree of the sizes in the slots
+    std::vector<std::uint64_t> m_owners;        // Mixed hash of the key whose most recent request is in each slot
+    std::vector<std::uint64_t> m_sizes;         // Size in each slot (0 if the slot is empty)
+    std::size_t m_next;                         // Next slot to use
+    std::size_t m_maxSamples;                   // Maximum number of keys tracked
+    std::uint64_t m_threshold;                  // A key is sampled if its mixed hash is less than this
+    double m_rate;                              // Sampling rate (the threshold / 2^64)
+    std::vector<double> m_histogram;            // Weighted number of sampled requests at each (scaled) distance
+    double m_sampled;                           // Weighted number of sampled requests
+    unsigned long long m_references;            // Number of requests
+};
+
+//! @param	rate		Initial sampling rate, from 0 to 1. Lower rates use less time; the memory is bounded anyway.
+//! @param	maxSamples	Maximum number of keys tracked
+
+inline MissRatioEstimator::MissRatioEstimator(double rate /* = 0.01*/,
+                                              std::size_t maxSamples /* = DEFAULT_MAX_SAMPLES*/)
+    : m_tree(2 * maxSamples + 3, 0),
+    m_owners(2 * maxSamples + 2, 0),
+    m_sizes(2 * maxSamples + 2, 0),
+    m_next(0),
+    m_maxSamples(maxSamples),
+    m_histogram(LatencyHistogram::BUCKET_COUNT, 0.0),
+    m_sampled(0.0),
+    m_references(0)
+{
+    m_threshold = (rate >= 1.0) ? ~std::uint64_t(0) : (std::uint64_t)std::ldexp((rate > 0.0) ? rate : 0.0, 64);
+    m_rate      = std::ldexp((double)m_threshold, -64);
+}
+
+//! @param	hash	Hash of the requested key
+
+inline bool MissRatioEstimator::Sample(std::size_t hash)
+{
+    ++m_references;
+    return Mix(hash) < m_threshold;
+}
+
+//! The reuse distance of the request is measured if the key was requested before, and the key's most recent request
+//! is moved to the newest slot.
+//!
+//! @param	hash	Hash of the requested key
+//! @param	size	Size of the element
+
+inline void MissRatioEstimator::Record(std::size_t hash, std::uint64_t size)
+{
+    std::uint64_t const mixed = Mix(hash);
+    if (mixed >= m_threshold)
+    {
+        return;
+    }
+
+    if (size == 0)
+    {
+        size = 1;
+    }
+
+    m_sampled += 1.0;
+
+    std::map<std::uint64_t, TrackedKey>::iterator pSample = m_samples.find(mixed);
+    bool const                                 isNew   = (pSample == m_samples.end());
+    if (!isNew)
+    {
+        std::uint64_t distance = Sum(m_next) - Sum(pSample->second.slot + 1) + size;
+        m_histogram[LatencyHistogram::IndexOf((unsigned long long)((double)distance / m_rate))] += 1.0;
+
+        Add(pSample->second.slot, -(std::int64_t)pSample->second.size);
+        m_sizes[pSample->second.slot] = 0;
+    }
+    else
+    {
+        // The first request for a key is a cold miss, so it is not in the histogram
+
+        TrackedKey tracked = { 0, 0 };
+        pSample = m_samples.insert(std::make_pair(mixed, tracked)).first;
+    }
+
+    if (m_next == m_sizes.size())
+    {
+        Compact();
+    }
+
+    pSample->second.slot = m_next;
+    pSample->second.size = size;
+    m_owners[m_next]     = mixed;
+    m_sizes[m_next]      = size;
+    Add(m_next, (std::int64_t)size);
+    ++m_next;
+
+    if (isNew && m_samples.size() > m_maxSamples)
+    {
+        Drop();
+    }
+}
+
+//! The estimate is adjusted for the difference between the expected and actual number of sampled requests
+//! (SHARDS-adj). A request whose distance is in the bucket containing the capacity counts as a miss.
+//!
+//! @param	capacity	Capacity of the cache, in bytes
+
+inline double MissRatioEstimator::GetMissRatio(std::uint64_t capacity) const
+{
+    double expected = (double)m_references * m_rate;
+    if (expected <= 0.0)
+    {
+        return 1.0;
+    }
+
+    double hits = expected - m_sampled;
+    for (std::size_t i = 0; i < m_histogram.size() && LatencyHistogram::GetUpperBound(i) <= capacity; ++i)
+    {
+        hits += m_histogram[i];
+    }
+
+    double missRatio = 1.0 - hits / expected;
+    return (missRatio < 0.0) ? 0.0 : (missRatio > 1.0) ? 1.0 : missRatio;
+}
+
+//! The utility is the difference between the miss ratios at the two capacities, times the number of requests, per
+//! byte added. Budget is best moved from the cache with the lowest marginal utility to the one with the highest.
+//!
+//! @param	capacity	Current capacity of the cache, in bytes
+//! @param	delta		Number of bytes to add
+
+inline double MissRatioEstimator::GetMarginalUtility(std::uint64_t capacity, std::uint64_t delta) const
+{
+    if (delta == 0)
+    {
+        return 0.0;
+    }
+    double avoided = (GetMissRatio(capacity) - GetMissRatio(capacity + delta)) * (double)m_references;
+    return avoided / (double)delta;
+}
+
+//! @param	curve	Vector to which the points are appended
+
+inline void MissRatioEstimator::GetCurve(std::vector<Point> & curve) const
+{
+    double expected = (double)m_references * m_rate;
+    if (expected <= 0.0)
+    {
+        return;
+    }
+
+    double hits = expected - m_sampled;
+    for (std::size_t i = 0; i < m_histogram.size(); ++i)
+    {
+        if (m_histogram[i] > 0.0)
+        {
+            hits += m_histogram[i];
+
+            double missRatio = 1.0 - hits / expected;
+            Point  point     = { LatencyHistogram::GetUpperBound(i), (missRatio < 0.0) ? 0.0 : missRatio };
+            curve.push_back(point);
+        }
+    }
+}
+
+//! The counts are cleared, but the tracked keys and the sampling rate are kept, so the distances of requests that
+//! span the reset are still measured.
+
+inline void MissRatioEstimator::Reset()
+{
+    m_histogram.assign(m_histogram.size(), 0.0);
+    m_sampled    = 0.0;
+    m_references = 0;
+}
+
+inline std::uint64_t MissRatioEstimator::Mix(std::size_t hash)
+{
+    // The splitmix64 finalizer
+
+    std::uint64_t x = (std::uint64_t)hash;
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+inline void MissRatioEstimator::Add(std::size_t slot, std::int64_t value)
+{
+    for (std::size_t i = slot + 1; i < m_tree.size(); i += i & (0 - i))
+    {
+        m_tree[i] += (std::uint64_t)value;
+    }
+}
+
+inline std::uint64_t MissRatioEstimator::Sum(std::size_t slot) const
+{
+    std::uint64_t sum = 0;
+    for (std::size_t i = slot; i > 0; i -= i & (0 - i))
+    {
+        sum += m_tree[i];
+    }
+    return sum;
+}
+
+inline void MissRatioEstimator::Drop()
+{
+    std::map<std::uint64_t, TrackedKey>::iterator pLast = --m_samples.end();
+
+    Add(pLast->second.slot, -(std::int64_t)pLast->second.size);
+    m_sizes[pLast->second.slot] = 0;
+
+    // The counts so far were sampled at the old rate, so they are scaled down to the new one
+
+    double scale = std::ldexp((double)pLast->first, -64) / m_rate;
+    for (std::vector<double>::iterator i = m_histogram.begin(); i != m_histogram.end(); ++i)
+    {
+        *i *= scale;
+    }
+    m_sampled  *= scale;
+    m_threshold = pLast->first;
+    m_rate      = std::ldexp((double)m_threshold, -64);
+
+    m_samples.erase(pLast);
+}
+
+inline void MissRatioEstimator::Compact()
+{
+    std::size_t count = 0;
+    for (std::size_t slot = 0; slot < m_next; ++slot)
+    {
+        if (m_sizes[slot] != 0)
+        {
+            m_owners[count] = m_owners[slot];
+            m_sizes[count]  = m_sizes[slot];
+            m_samples[m_owners[count]].slot = count;
+            ++count;
+        }
+    }
+    std::fill(m_sizes.begin() + count, m_sizes.end(), 0);
+
+    m_tree.assign(m_tree.size(), 0);
+    for (std::size_t slot = 0; slot < count; ++slot)
+    {
+        Add(slot, (std::int64_t)m_sizes[slot]);
+    }
+    m_next = count;
+}
@@ -0,0 +1,270 @@
+/** @file *//********************************************************************************************************
+
+                                                        Numa.h
+
+                                            Copyright 2006, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/AsynchronousCache/Numa.h#1 $
+
+    $NoKeywords: $
+
+********************************************************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+//! The NUMA nodes of the system and the CPUs in each.
+//!
+//! The topology is read from sysfs when the object is constructed. Nodes are identified by a dense index from 0 to
+//! GetNodeCount() - 1, which is not necessarily the system's node number. If the topology cannot be read (or the
+//! system is not Linux), there is a single node containing every CPU.
+//!
+//! Memory can be placed on a node in two ways: by binding it to the node with BindToNode() (which uses mbind), or
+//! by touching it first from a thread running on the node, which RunOnNode() provides.
+
+class NumaTopology
+{
+public:
+
+    //! Constructor
+    NumaTopology();
+
+    //! Returns the number of nodes
+    std::size_t GetNodeCount() const { return m_nodes.size(); }
+
+    //! Returns the CPUs of a node
+    std::vector<int> const & GetCpus(std::size_t node) const { return m_nodes[node].cpus; }
+
+    //! Returns the node of a CPU (or 0 if it is not known)
+    std::size_t GetNodeOfCpu(int cpu) const;
+
+    //! Returns the node of the CPU the calling thread is running on
+    std::size_t GetCurrentNode() const;
+
+    //! Calls a function on a thread running on a node, and waits for it to return
+    void RunOnNode(std::size_t node, std::function<void()> const & function) const;
+
+    //! Asks the system to place memory on a node. Returns false if the memory could not be bound.
+    bool BindToNode(void * p, std::size_t size, std::size_t node) const;
+
+private:
+
+    // A node
+    struct Node
+    {
+        int id;                 // The system's number for the node
+        std::vector<int> cpus;  // The CPUs in the node
+    };
+
+    // Parses a CPU list (e.g. "0-3,8-11")
+    static std::vector<int> ParseCpuList(std::string const & list);
+
+    std::vector<Node> m_nodes;          // The nodes, in order of their system numbers
+    std::vector<std::size_t> m_cpuNode; // Node of each CPU
+};
+
+inline NumaTopology::NumaTopology()
+{
+#if defined(__linux__)
+    std::error_code error;
+    std::filesystem::path root("/sys/devices/system/node");
+    for (std::filesystem::directory_iterator i(root, error); !error && i != std::filesystem::directory_iterator();
+         i.increment(error))
+    {
+        std::string name = i->path().filename().string();
+        if (name.compare(0, 4, "node") != 0 || name.size() == 4 ||
+            name.find_first_not_of("0123456789", 4) != std::string::npos)
+        {
+            continue;
+        }
+
+        Node node;
+        node.id = std::atoi(name.c_str() + 4);
+        if (std::FILE * pFile = std::fopen((i->path() / "cpulist").string().c_str(), "r"))
+        {
+            char line[4096];
+            if (std::fgets(line, sizeof(line), pFile))
+            {
+                node.cpus = ParseCpuList(line);
+            }
+            std::fclose(pFile);
+        }
+
+        // Nodes without CPUs (e.g. memory-only nodes) are ignored
+
+        if (!node.cpus.empty())
+        {
+            std::vector<Node>::iterator p = m_nodes.begin();
+            while (p != m_nodes.end() && p->id < node.id)
+            {
+                ++p;
+            }
+            m_nodes.insert(p, node);
+        }
+    }
+#endif
+
+    if (m_nodes.empty())
+    {
+        Node node;
+        node.id = 0;
+        for (unsigned cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu)
+        {
+            node.cpus.push_back((int)cpu);
+        }
+        m_nodes.push_back(node);
+    }
+
+    for (std::size_t n = 0; n < m_nodes.size(); ++n)
+    {
+        for (std::vector<int>::const_iterator c = m_nodes[n].cpus.begin(); c != m_nodes[n].cpus.end(); ++c)
+        {
+            if ((std::size_t)*c >= m_cpuNode.size())
+            {
+                m_cpuNode.resize(*c + 1, 0);
+            }
+            m_cpuNode[*c] = n;
+        }
+    }
+}
+
+//! @param	cpu		The CPU
+
+inline std::size_t NumaTopology::GetNodeOfCpu(int cpu) const
+{
+    return (cpu >= 0 && (std::size_t)cpu < m_cpuNode.size()) ? m_cpuNode[cpu] : 0;
+}
+
+//! The thread may be moved to another CPU at any time, so the result is only a hint.
+
+inline std::size_t NumaTopology::GetCurrentNode() const
+{
+#if defined(__linux__)
+    return (m_nodes.size() > 1) ? GetNodeOfCpu(sched_getcpu()) : 0;
+#else
+    return 0;
+#endif
+}
+
+//! The function runs on a new thread whose affinity is set to the node's CPUs, so memory that it touches first is
+//! placed on the node (under the system's default first-touch policy). An exception thrown by the function is
+//! rethrown on the calling thread.
+//!
+//! @param	node		The node
+//! @param	function	The function to call
+
+inline void NumaTopology::RunOnNode(std::size_t node, std::function<void()> const & function) const
+{
+    std::exception_ptr pException;
+    std::thread thread([this, node, &function, &pException] {
+#if defined(__linux__)
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (std::vector<int>::const_iterator c = m_nodes[node].cpus.begin(); c != m_nodes[node].cpus.end(); ++c)
+        {
+            if (*c < CPU_SETSIZE)
+            {
+                CPU_SET(*c, &cpus);
+            }
+        }
+        sched_setaffinity(0, sizeof(cpus), &cpus);
+#endif
+        try
+        {
+            function();
+        }
+        catch (...)
+        {
+            pException = std::current_exception();
+        }
+    });
+    thread.join();
+
+    if (pException)
+    {
+        std::rethrow_exception(pException);
+    }
+}
+
+//! The memory is bound with the MPOL_PREFERRED policy, so it is allocated on another node if the node is full.
+//! Pages that have already been touched are not moved.
+//!
+//! @param	p		Address of the memory
+//! @param	size	Size of the memory
+//! @param	node	The node
+
+inline bool NumaTopology::BindToNode(void * p, std::size_t size, std::size_t node) const
+{
+#if defined(__linux__) && defined(SYS_mbind)
+    int const MPOL_PREFERRED_ = 1;   // From <numaif.h>, which is not always installed
+
+    std::size_t pageSize = (std::size_t)sysconf(_SC_PAGESIZE);
+    std::size_t begin    = (std::size_t)p / pageSize * pageSize;
+    std::size_t end      = ((std::size_t)p + size + pageSize - 1) / pageSize * pageSize;
+
+    int const     bits = (int)(sizeof(unsigned long) * 8);
+    int           id   = m_nodes[node].id;
+    unsigned long mask[16] = { 0 };
+    if (id >= bits * 16)
+    {
+        return false;
+    }
+    mask[id / bits] = 1ul << (id % bits);
+
+    return syscall(SYS_mbind, begin, end - begin, MPOL_PREFERRED_, mask, (unsigned long)(bits * 16), 0) == 0;
+#else
+    (void)p;
+    (void)size;
+    (void)node;
+    return false;
+#endif
+}
+
+inline std::vector<int> NumaTopology::ParseCpuList(std::string const & list)
+{
+    std::vector<int> cpus;
+    char const *     p = list.c_str();
+    while (*p != 0)
+    {
+        char * pEnd;
+        long   first = std::strtol(p, &pEnd, 10);
+        if (pEnd == p)
+        {
+            break;
+        }
+        long last = first;
+        p = pEnd;
+        if (*p == '-')
+        {
+            last = std::strtol(p + 1, &pEnd, 10);
+            p    = pEnd;
+        }
+        for (long cpu = first; cpu <= last; ++cpu)
+        {
+            cpus.push_back((int)cpu);
+        }
+        if (*p != ',')
+        {
+            break;
+        }
+        ++p;
+    }
+    return cpus;
+}
@@ -0,0 +1,289 @@
+/** @file *//********************************************************************************************************
+
+                                                 PrefetchPredictor.h
+
+                                            Copyright 2006, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/AsynchronousCache/PrefetchPredictor.h#1 $
+
+    $NoKeywords: $
+
+********************************************************************************************************************/
+
+#pragma once
+
+#include "KeyHash.h"
+
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+//! Prefetch predictor interface.
+//!
+//! @param	Key         Type of a key for accessing an element in the cache
+//!
+//! A predictor watches the sequence of requested keys and predicts which keys will be requested next. When a
+//! predictor is attached to an AsynchronousCache, the cache reports every request to Observe() and prefetches the
+//! keys returned by Predict().
+
+template <typename Key>
+class PrefetchPredictor
+{
+public:
+
+    //! Destructor
+    virtual ~PrefetchPredictor() {}
+
+    //! Records that an element was requested.
+    //!
+    //! @param	key		Key of the requested element
+
+    virtual void Observe(Key const & key) = 0;
+
+    //! Appends the keys that are likely to be requested after the specified key, most likely first.
+    //!
+    //! @param	key				Key of the most recently requested element
+    //! @param	predictions		Vector to which the predicted keys are appended
+
+    virtual void Predict(Key const & key, std::vector<Key> & predictions) = 0;
+};
+
+//! A first-order Markov prefetch predictor.
+//!
+//! @param	Key         Type of a key for accessing an element in the cache
+//! @param	Hash        Hash function for keys. The default is KeyHash, as in AsynchronousCache.
+//!
+//! This predictor counts the transitions between consecutively requested keys and predicts the successors that
+//! have followed a key most often. Its memory is bounded: it tracks at most a fixed number of keys (the least
+//! recently requested key is forgotten first) and a fixed number of successors per key (a new successor replaces
+//! the least frequent one). The counts are periodically halved so that the predictions adapt when the request
+//! pattern changes.
+
+template <typename Key, typename Hash = KeyHash<Key>>
+class MarkovPredictor : public PrefetchPredictor<Key>
+{
+public:
+
+    //! Constructor
+    MarkovPredictor(std::size_t maxKeys,
+                    std::size_t maxSuccessors  = 4,
+                    double      minConfidence  = 0.25,
+                    std::size_t maxPredictions = 2);
+
+    //! Records that an element was requested
+    virtual void Observe(Key const & key) override;
+
+    //! Appends the likeliest successors of a key whose confidence meets the threshold
+    virtual void Predict(Key const & key, std::vector<Key> & predictions) override;
+
+    //! Forgets everything that has been learned
+    void Clear();
+
+private:
+
+    // A successor of a key and the number of times it has followed the key
+    typedef std::pair<Key, unsigned> Successor;
+
+    // A tracked key and its successors
+    struct Node
+    {
+        Node(Key const & k) : key(k), total(0) {}
+
+        Key key;                            // The key
+        std::vector<Successor> successors;  // Keys that have followed this key
+        unsigned total;                     // Sum of the successors' counts
+    };
+
+    typedef std::list<Node> NodeList;
+    typedef std::unordered_map<Key, typename NodeList::iterator, Hash> NodeMap;
+
+    // Maximum count total before the counts are halved
+    static unsigned const MAX_TOTAL = 1024;
+
+    // Returns the node for the key, creating it (and forgetting the least recently used node) if necessary
+    typename NodeList::iterator Touch(Key const & key);
+
+    // Counts a transition from one node to a key
+    void Count(Node & node, Key const & key);
+
+    std::size_t m_maxKeys;                      // Maximum number of keys tracked
+    std::size_t m_maxSuccessors;                // Maximum number of successors tracked per key
+    double m_minConfidence;                     // Minimum fraction of transitions for a successor to be predicted
+    std::size_t m_maxPredictions;               // Maximum number of predictions per call to Predict()
+    NodeList m_nodes;                           // Tracked keys, most recently requested last
+    NodeMap m_index;                            // Index of the tracked keys
+    typename NodeList::iterator m_pPrevious;    // The previously requested key, or m_nodes.end()
+};
+
+//! @param	maxKeys			Maximum number of keys tracked
+//! @param	maxSuccessors	Maximum number of successors tracked per key
+//! @param	minConfidence	Minimum fraction of a key's transitions that must lead to a successor for it to be predicted
+//! @param	maxPredictions	Maximum number of keys returned by each call to Predict()
+
+template <typename Key, typename Hash>
+MarkovPredictor<Key, Hash>::MarkovPredictor(std::size_t maxKeys,
+                                            std::size_t maxSuccessors /* = 4*/,
+                                            double      minConfidence /* = 0.25*/,
+                                            std::size_t maxPredictions /* = 2*/)
+    : m_maxKeys(maxKeys),
+    m_maxSuccessors(maxSuccessors),
+    m_minConfidence(minConfidence),
+    m_maxPredictions(maxPredictions),
+    m_pPrevious(m_nodes.end())
+{
+}
+
+//! This function counts the transition from the previously requested key to this one, and then makes this key the
+//! previously requested key.
+//!
+//! @param	key		Key of the requested element
+
+template <typename Key, typename Hash>
+void MarkovPredictor<Key, Hash>::Observe(Key const & key)
+{
+    if (m_maxKeys == 0)
+    {
+        return;
+    }
+
+    typename NodeList::iterator pNode = Touch(key);
+
+    if (m_pPrevious != m_nodes.end() && m_pPrevious != pNode)
+    {
+        Count(*m_pPrevious, key);
+    }
+
+    m_pPrevious = pNode;
+}
+
+//! @param	key				Key of the most recently requested element
+//! @param	predictions		Vector to which the predicted keys are appended, most likely first
+
+template <typename Key, typename Hash>
+void MarkovPredictor<Key, Hash>::Predict(Key const & key, std::vector<Key> & predictions)
+{
+    typename NodeMap::const_iterator i = m_index.find(key);
+    if (i == m_index.end())
+    {
+        return;
+    }
+
+    // The successors are kept sorted by count, so the first ones are the likeliest.
+
+    Node const & node = *i->second;
+    std::size_t  n    = 0;
+    for (typename std::vector<Successor>::const_iterator s = node.successors.begin();
+         s != node.successors.end() && n < m_maxPredictions;
+         ++s)
+    {
+        if ((double)s->second < m_minConfidence * (double)node.total)
+        {
+            break;
+        }
+        predictions.push_back(s->first);
+        ++n;
+    }
+}
+
+template <typename Key, typename Hash>
+void MarkovPredictor<Key, Hash>::Clear()
+{
+    m_index.clear();
+    m_nodes.clear();
+    m_pPrevious = m_nodes.end();
+}
+
+template <typename Key, typename Hash>
+typename MarkovPredictor<Key, Hash>::NodeList::iterator MarkovPredictor<Key, Hash>::Touch(Key const & key)
+{
+    typename NodeList::iterator pNode;
+    typename NodeMap::iterator  i = m_index.find(key);
+
+    if (i != m_index.end())
+    {
+        // Move the node to the back so it is the last to be forgotten
+
+        pNode = i->second;
+        m_nodes.splice(m_nodes.end(), m_nodes, pNode);
+    }
+    else
+    {
+        // Forget the least recently requested key if the table is full
+
+        if (m_nodes.size() >= m_maxKeys)
+        {
+            typename NodeList::iterator pOldest = m_nodes.begin();
+            if (pOldest == m_pPrevious)
+            {
+                m_pPrevious = m_nodes.end();
+            }
+            m_index.erase(pOldest->key);
+            m_nodes.erase(pOldest);
+        }
+
+        pNode = m_nodes.insert(m_nodes.end(), Node(key));
+        m_index.insert(typename NodeMap::value_type(key, pNode));
+    }
+
+    return pNode;
+}
+
+template <typename Key, typename Hash>
+void MarkovPredictor<Key, Hash>::Count(Node & node, Key const & key)
+{
+    std::vector<Successor> & successors = node.successors;
+
+    // Find the successor. If it is not tracked, then add it, replacing the least frequent successor if the list is
+    // full. The replacement inherits the count of the successor it replaces so that a new successor can eventually
+    // displace an established one.
+
+    std::size_t i = 0;
+    while (i < successors.size() && !(successors[i].first == key))
+    {
+        ++i;
+    }
+
+    if (i == successors.size())
+    {
+        if (successors.size() < m_maxSuccessors)
+        {
+            successors.push_back(Successor(key, 0));
+        }
+        else if (!successors.empty())
+        {
+            --i;
+            successors[i].first = key;
+        }
+        else
+        {
+            return;
+        }
+    }
+
+    ++successors[i].second;
+    ++node.total;
+
+    // Keep the successors sorted by count (descending)
+
+    while (i > 0 && successors[i - 1].second < successors[i].second)
+    {
+        std::swap(successors[i - 1], successors[i]);
+        --i;
+    }
+
+    // Age the counts so that old transitions fade
+
+    if (node.total >= MAX_TOTAL)
+    {
+        node.total = 0;
+        for (typename std::vector<Successor>::iterator s = successors.begin(); s != successors.end(); ++s)
+        {
+            s->second  /= 2;
+            node.total += s->second;
+        }
+    }
+}
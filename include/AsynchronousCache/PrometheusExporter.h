@@ -0,0 +1,273 @@
+/** @file *//********************************************************************************************************
+
+                                                 PrometheusExporter.h
+
+                                            Copyright 2006, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/AsynchronousCache/PrometheusExporter.h#1 $
+
+    $NoKeywords: $
+
+********************************************************************************************************************/
+
+#pragma once
+
+#include "Arena.h"
+#include "LatencyHistogram.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+//! Renders the metrics of a cache in the Prometheus text exposition format.
+//!
+//! @param	Cache       Type of the cache. It is AsynchronousCache (or a class derived from it) or a ShardedCache.
+//!
+//! The metrics are read from the cache's own counts, so nothing needs to be counted around the calls to it:
+//!		- <prefix>_entries{state="..."} and <prefix>_bytes{state="..."}: gauges of the number and total size of the
+//!			entries in each state (requested, prefetched, available, released), from GetUsage()
+//!		- <prefix>_overhead_bytes: a gauge of the memory used by the cache itself
+//!		- <prefix>_get_hits_total, <prefix>_evictions_total, etc.: counters of the outcomes of operations, from
+//!			GetStatistics()
+//!		- <prefix>_request_latency_seconds and <prefix>_prefetch_latency_seconds: histograms of the load latencies,
+//!			which are empty unless the cache's latency histograms are enabled (see SetLatencyHistograms())
+//!		- <prefix>_page_size_bytes{pages="..."}: a gauge of the size of the pages backing the cache's storage, with
+//!			their kind (unknown, normal, transparent_huge, or huge_tlb), only if the cache reports them with
+//!			GetPageSize() and GetPageKind() (as StorageCache does)
+//!
+//! The latency histograms are reported with a few fixed bucket bounds (see SetLatencyBounds()). The count at each
+//! bound comes from the cache's finer LatencyHistogram, and a fine bucket that straddles a bound is counted at the
+//! next bound, so the counts are never too high.
+//!
+//! Counters are reset by ResetStatistics(), which Prometheus treats as a counter reset. Every metric carries the
+//! labels given to the constructor, so several caches may be exported with different labels, but each file (or
+//! string) must contain only one exporter's output because the HELP and TYPE lines may not be repeated.
+//!
+//! @note	The cache is read without locking, so an exporter of an AsynchronousCache must be used by the thread
+//!			that uses the cache. A ShardedCache locks its shards itself.
+
+template <typename Cache>
+class PrometheusExporter
+{
+public:
+
+    //! Constructor
+    explicit PrometheusExporter(Cache & cache, std::string prefix = "asynchronous_cache", std::string labels = "");
+
+    //! Sets the upper bounds of the latency buckets, in seconds, in increasing order
+    void SetLatencyBounds(std::vector<double> const & bounds) { m_bounds = bounds; }
+
+    //! Appends the metrics to a string
+    void Render(std::string & text);
+
+    //! Writes the metrics to a file. Returns false if the file could not be written.
+    bool Write(char const * path);
+
+private:
+
+    // Appends a metric's HELP and TYPE lines
+    void Header(std::string & text, char const * name, char const * type, char const * help);
+
+    // Appends a sample. The extra label (e.g. state="available") is optional.
+    void Sample(std::string & text, char const * name, char const * suffix, char const * label, double value);
+
+    // Appends a histogram
+    void Histogram(std::string & text, char const * name, char const * help, LatencyHistogram const & histogram);
+
+    // Determines whether a cache reports the pages backing its storage
+    template <typename C, typename = void>
+    struct reports_pages : std::false_type
+    {
+    };
+
+    template <typename C>
+    struct reports_pages<C, decltype(void(std::declval<C const &>().GetPageKind()))> : std::true_type
+    {
+    };
+
+    Cache & m_cache;                // The cache
+    std::string m_prefix;           // Prefix of the metric names
+    std::string m_labels;           // Labels of every metric (e.g. cache="textures"), or empty
+    std::vector<double> m_bounds;   // Upper bounds of the latency buckets, in seconds
+};
+
+//! @param	cache	The cache whose metrics are exported
+//! @param	prefix	Prefix of the metric names
+//! @param	labels	Labels added to every metric, without braces (e.g. <tt>cache="textures",node="0"</tt>)
+
+template <typename Cache>
+PrometheusExporter<Cache>::PrometheusExporter(Cache &     cache,
+                                              std::string prefix /* = "asynchronous_cache"*/,
+                                              std::string labels /* = ""*/)
+    : m_cache(cache),
+    m_prefix(prefix),
+    m_labels(labels)
+{
+    static double const DEFAULT_BOUNDS[] =
+    {
+        1e-6, 5e-6, 1e-5, 5e-5, 1e-4, 2.5e-4, 5e-4, 1e-3, 2.5e-3, 5e-3, 1e-2, 2.5e-2, 5e-2, 0.1, 0.25, 0.5, 1.0, 5.0
+    };
+    m_bounds.assign(DEFAULT_BOUNDS, DEFAULT_BOUNDS + sizeof(DEFAULT_BOUNDS) / sizeof(DEFAULT_BOUNDS[0]));
+}
+
+//! @param	text	String to which the metrics are appended
+
+template <typename Cache>
+void PrometheusExporter<Cache>::Render(std::string & text)
+{
+    typename Cache::Usage      usage      = m_cache.GetUsage();
+    typename Cache::Statistics statistics = m_cache.GetStatistics();
+
+    Header(text, "entries", "gauge", "Number of entries in each state");
+    Sample(text, "entries", "", "state=\"requested\"", (double)usage.requested);
+    Sample(text, "entries", "", "state=\"prefetched\"", (double)usage.prefetched);
+    Sample(text, "entries", "", "state=\"available\"", (double)usage.available);
+    Sample(text, "entries", "", "state=\"released\"", (double)usage.released);
+
+    Header(text, "bytes", "gauge", "Total size of the entries in each state");
+    Sample(text, "bytes", "", "state=\"requested\"", (double)usage.requestedBytes);
+    Sample(text, "bytes", "", "state=\"prefetched\"", (double)usage.prefetchedBytes);
+    Sample(text, "bytes", "", "state=\"available\"", (double)usage.availableBytes);
+    Sample(text, "bytes", "", "state=\"released\"", (double)usage.releasedBytes);
+
+    Header(text, "overhead_bytes", "gauge", "Memory used by the cache's entries, queues, and scratch space");
+    Sample(text, "overhead_bytes", "", 0, (double)usage.overheadBytes);
+
+    struct Counter
+    {
+        char const * name;
+        char const * help;
+        unsigned long long value;
+    };
+    Counter const counters[] =
+    {
+        { "get_hits_total",          "Calls to Get() that returned an element",        statistics.getHits          },
+        { "get_misses_total",        "Calls to Get() that returned nullptr",           statistics.getMisses        },
+        { "request_hits_total",      "Requests for requested or available elements",   statistics.requestHits      },
+        { "prefetch_hits_total",     "Requests for prefetched elements",               statistics.prefetchHits     },
+        { "reloads_total",           "Requests for released elements still cached",    statistics.reloads          },
+        { "request_misses_total",    "Requests that started or queued a new load",     statistics.requestMisses    },
+        { "request_failures_total",  "Requests that failed for lack of room",          statistics.requestFailures  },
+        { "prefetches_total",        "Prefetches that started or queued a new load",   statistics.prefetches       },
+        { "prefetch_failures_total", "Prefetches refused",                             statistics.prefetchFailures },
+        { "evictions_total",         "Elements evicted to make room for new ones",     statistics.evictions        }
+    };
+    for (std::size_t i = 0; i < sizeof(counters) / sizeof(counters[0]); ++i)
+    {
+        Header(text, counters[i].name, "counter", counters[i].help);
+        Sample(text, counters[i].name, "", 0, (double)counters[i].value);
+    }
+
+    Histogram(text, "request_latency_seconds", "Time from a request to the element becoming available",
+              m_cache.GetRequestLatency());
+    Histogram(text, "prefetch_latency_seconds", "Time from a prefetch to the element being loaded",
+              m_cache.GetPrefetchLatency());
+
+    if constexpr (reports_pages<Cache>::value)
+    {
+        static char const * const PAGE_KINDS[] =
+        {
+            "pages=\"unknown\"", "pages=\"normal\"", "pages=\"transparent_huge\"", "pages=\"huge_tlb\""
+        };
+        Header(text, "page_size_bytes", "gauge", "Size of the pages backing the storage (0 if not known)");
+        Sample(text, "page_size_bytes", "", PAGE_KINDS[m_cache.GetPageKind()], (double)m_cache.GetPageSize());
+    }
+}
+
+//! The metrics are written to a temporary file, which then replaces the file, so a scraper never reads a partial
+//! file.
+//!
+//! @param	path	Path of the file
+
+template <typename Cache>
+bool PrometheusExporter<Cache>::Write(char const * path)
+{
+    std::string text;
+    Render(text);
+
+    std::string temporary = std::string(path) + ".tmp";
+    std::FILE * pFile     = std::fopen(temporary.c_str(), "w");
+    if (pFile == 0)
+    {
+        return false;
+    }
+
+    bool ok = std::fwrite(text.data(), 1, text.size(), pFile) == text.size();
+    ok      = (std::fclose(pFile) == 0) && ok;
+    if (!ok || std::rename(temporary.c_str(), path) != 0)
+    {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+template <typename Cache>
+void PrometheusExporter<Cache>::Header(std::string & text, char const * name, char const * type, char const * help)
+{
+    text += "# HELP " + m_prefix + "_" + name + " " + help + "\n";
+    text += "# TYPE " + m_prefix + "_" + name + " " + type + "\n";
+}
+
+template <typename Cache>
+void PrometheusExporter<Cache>::Sample(std::string & text,
+                                       char const *  name,
+                                       char const *  suffix,
+                                       char const *  label,
+                                       double        value)
+{
+    text += m_prefix + "_" + name + suffix;
+    if (!m_labels.empty() || label != 0)
+    {
+        text += "{" + m_labels;
+        if (!m_labels.empty() && label != 0)
+        {
+            text += ",";
+        }
+        if (label != 0)
+        {
+            text += label;
+        }
+        text += "}";
+    }
+
+    // Counts are printed exactly, and other values with enough precision
+
+    char number[48];
+    std::snprintf(number, sizeof(number), (value == (double)(unsigned long long)value) ? " %.0f\n" : " %.9g\n", value);
+    text += number;
+}
+
+template <typename Cache>
+void PrometheusExporter<Cache>::Histogram(std::string &            text,
+                                          char const *             name,
+                                          char const *             help,
+                                          LatencyHistogram const & histogram)
+{
+    Header(text, name, "histogram", help);
+
+    // The buckets are cumulative. The cache records nanoseconds.
+
+    unsigned long long count = 0;
+    std::size_t        index = 0;
+    for (std::vector<double>::const_iterator b = m_bounds.begin(); b != m_bounds.end(); ++b)
+    {
+        double nanoseconds = *b * 1e9;
+        while (index < LatencyHistogram::BUCKET_COUNT && (double)LatencyHistogram::GetUpperBound(index) <= nanoseconds)
+        {
+            count += histogram.GetBucket(index);
+            ++index;
+        }
+
+        char label[48];
+        std::snprintf(label, sizeof(label), "le=\"%g\"", *b);
+        Sample(text, name, "_bucket", label, (double)count);
+    }
+    Sample(text, name, "_bucket", "le=\"+Inf\"", (double)histogram.GetCount());
+    Sample(text, name, "_sum", 0, histogram.GetMean() * (double)histogram.GetCount() * 1e-9);
+    Sample(text, name, "_count", 0, (double)histogram.GetCount());
+}
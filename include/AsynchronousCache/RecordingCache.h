@@ -0,0 +1,259 @@
+/** @file *//********************************************************************************************************
+
+                                                   RecordingCache.h
+
+                                            Copyright 2006, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/AsynchronousCache/RecordingCache.h#1 $
+
+    $NoKeywords: $
+
+********************************************************************************************************************/
+
+#pragma once
+
+#include "AccessTrace.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+//! A cache that records the calls made to it in an access trace.
+//!
+//! @param	Cache       Type of the cache. It is a concrete class derived from AsynchronousCache.
+//!
+//! This class derives from the cache and hides its public member functions Request(), Prefetch(), Get(), Release(),
+//! Clear(), and Update() with versions that record each call (with its result) before returning. The trace can be
+//! replayed later against a simulated backend (see tools/TraceReplay.cpp) to reproduce a workload. Recording is
+//! enabled by attaching a writer with SetTraceWriter(). The calls must be made through this class (not through a
+//! pointer to the base class) to be recorded.
+//!
+//! Keys are recorded with AccessKeyCodec. An element released by its address is recorded with its key.
+//!
+//! @note	Like the cache, this class is not thread-safe.
+
+template <typename Cache>
+class RecordingCache : public Cache
+{
+public:
+
+    typedef typename Cache::ElementType ElementType;    //!< Type of the element stored in the cache
+    typedef typename Cache::KeyType KeyType;            //!< Type of the element key
+    typedef typename Cache::TimePoint TimePoint;        //!< Type of a deadline
+
+    //! Constructor. The arguments are passed to the cache's constructor.
+    template <typename... Args>
+    explicit RecordingCache(Args &&... args)
+        : Cache(std::forward<Args>(args)...),
+        m_pWriter(0)
+    {
+    }
+
+    //! Attaches a writer that records the calls (or detaches it if @c nullptr). The writer is not owned.
+    void SetTraceWriter(AccessTraceWriter * pWriter) { m_pWriter = pWriter; }
+
+    //! Starts loading a element through the cache
+    template <typename K>
+    bool Request(K && key);
+
+    //! Starts loading a element through the cache, scheduling the load according to when it is needed
+    template <typename K>
+    bool Request(K && key, TimePoint deadline);
+
+    //! Notifies the cache that this element may be needed soon
+    template <typename K>
+    bool Prefetch(K && key);
+
+    //! Returns a pointer to an element in the cache (or nullptr if it is not in the cache)
+    template <typename K>
+    ElementType * Get(K const & key);
+
+    //! Finds an entry in the cache and marks it as no longer used (optionally force eviction)
+    template <typename K,
+              typename = typename std::enable_if<!std::is_convertible<K const &, ElementType const *>::value>::type>
+    void Release(K const & key, bool forceEviction = false);
+
+    //! Finds an entry in the cache and marks it as no longer used (optionally force eviction)
+    void Release(ElementType const * pElement, bool forceEviction = false);
+
+    //! Removes all elements from the cache
+    void Clear();
+
+    //! Retires completed loads and starts queued loads as the load limits allow
+    void Update();
+
+    //! Like Update(), but also returns the keys of the requested elements that became available
+    void Update(std::vector<KeyType> & available);
+
+private:
+
+    // Encodes a key into m_key
+    template <typename K>
+    void EncodeKey(K const & key)
+    {
+        m_key.clear();
+        AccessKeyCodec<KeyType>::Encode(key, m_key);
+    }
+
+    // Returns the size of an element, constructing its key from a lookup key if necessary
+    std::uint64_t SizeOfKey(KeyType const & key) { return this->SizeOf(key); }
+    template <typename K>
+    std::uint64_t SizeOfKey(K const & key) { return this->SizeOf(KeyType(key)); }
+
+    AccessTraceWriter * m_pWriter;  // Records the calls, or nullptr
+    std::string m_key;              // Scratch space for the encoded key
+};
+
+//! @param	key		Element to load. It is moved into the cache if it is an rvalue.
+
+template <typename Cache>
+template <typename K>
+bool RecordingCache<Cache>::Request(K && key)
+{
+    if (m_pWriter == 0)
+    {
+        return Cache::Request(std::forward<K>(key));
+    }
+
+    // The key is encoded first, since it may be moved into the cache
+
+    EncodeKey(key);
+    std::uint64_t size = SizeOfKey(key);
+    bool          ok   = Cache::Request(std::forward<K>(key));
+    m_pWriter->Write(ACCESS_REQUEST, ok ? AccessRecord::FLAG_RESULT : 0, m_key, size);
+    return ok;
+}
+
+//! @param	key			Element to load. It is moved into the cache if it is an rvalue.
+//! @param	deadline	When the element is needed
+
+template <typename Cache>
+template <typename K>
+bool RecordingCache<Cache>::Request(K && key, TimePoint deadline)
+{
+    if (m_pWriter == 0)
+    {
+        return Cache::Request(std::forward<K>(key), deadline);
+    }
+
+    // The deadline is recorded relative to the call, and a deadline in the past is recorded as now
+
+    TimePoint     now      = std::chrono::steady_clock::now();
+    std::uint64_t relative = 0;
+    if (deadline > now)
+    {
+        relative = (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - now).count();
+    }
+
+    EncodeKey(key);
+    std::uint64_t size = SizeOfKey(key);
+    bool          ok   = Cache::Request(std::forward<K>(key), deadline);
+    m_pWriter->Write(ACCESS_REQUEST_DEADLINE, ok ? AccessRecord::FLAG_RESULT : 0, m_key, size, relative);
+    return ok;
+}
+
+//! @param	key		Element to prefetch. It is moved into the cache if it is an rvalue.
+
+template <typename Cache>
+template <typename K>
+bool RecordingCache<Cache>::Prefetch(K && key)
+{
+    if (m_pWriter == 0)
+    {
+        return Cache::Prefetch(std::forward<K>(key));
+    }
+
+    EncodeKey(key);
+    std::uint64_t size = SizeOfKey(key);
+    bool          ok   = Cache::Prefetch(std::forward<K>(key));
+    m_pWriter->Write(ACCESS_PREFETCH, ok ? AccessRecord::FLAG_RESULT : 0, m_key, size);
+    return ok;
+}
+
+//! @param	key		Element to access
+
+template <typename Cache>
+template <typename K>
+typename RecordingCache<Cache>::ElementType * RecordingCache<Cache>::Get(K const & key)
+{
+    ElementType * pElement = Cache::Get(key);
+    if (m_pWriter != 0)
+    {
+        EncodeKey(key);
+        m_pWriter->Write(ACCESS_GET, (pElement != 0) ? AccessRecord::FLAG_RESULT : 0, m_key);
+    }
+    return pElement;
+}
+
+//! @param	key				Element to release
+//! @param	forceEviction	If @c true, the element is immediately removed from the cache storage.
+
+template <typename Cache>
+template <typename K, typename>
+void RecordingCache<Cache>::Release(K const & key, bool forceEviction /* = false*/)
+{
+    if (m_pWriter != 0)
+    {
+        EncodeKey(key);
+        m_pWriter->Write(ACCESS_RELEASE, forceEviction ? AccessRecord::FLAG_FORCE : 0, m_key);
+    }
+    Cache::Release(key, forceEviction);
+}
+
+//! The element's key is found with the cache's BackDoor before the element is released. A release of an element
+//! that is not in the cache is not recorded.
+//!
+//! @param	pElement		Element to release
+//! @param	forceEviction	If @c true, the element is immediately removed from the cache storage.
+
+template <typename Cache>
+void RecordingCache<Cache>::Release(ElementType const * pElement, bool forceEviction /* = false*/)
+{
+    if (m_pWriter != 0)
+    {
+        typename Cache::BackDoor                      backDoor(this);
+        typename Cache::BackDoor::EntryList::iterator pEntry = backDoor.Find(pElement);
+        if (pEntry != backDoor.GetEntries().end())
+        {
+            EncodeKey(pEntry->key);
+            m_pWriter->Write(ACCESS_RELEASE_POINTER, forceEviction ? AccessRecord::FLAG_FORCE : 0, m_key);
+        }
+    }
+    Cache::Release(pElement, forceEviction);
+}
+
+template <typename Cache>
+void RecordingCache<Cache>::Clear()
+{
+    if (m_pWriter != 0)
+    {
+        m_pWriter->Write(ACCESS_CLEAR, 0, std::string());
+    }
+    Cache::Clear();
+}
+
+template <typename Cache>
+void RecordingCache<Cache>::Update()
+{
+    if (m_pWriter != 0)
+    {
+        m_pWriter->Write(ACCESS_UPDATE, 0, std::string());
+    }
+    Cache::Update();
+}
+
+//! @param	available	Vector to which the keys of the newly available elements are appended
+
+template <typename Cache>
+void RecordingCache<Cache>::Update(std::vector<KeyType> & available)
+{
+    if (m_pWriter != 0)
+    {
+        m_pWriter->Write(ACCESS_UPDATE, 0, std::string());
+    }
+    Cache::Update(available);
+}
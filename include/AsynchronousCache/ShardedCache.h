@@ -0,0 +1,644 @@
+/** @file *//********************************************************************************************************
+
+                                                    ShardedCache.h
+
+                                            Copyright 2006, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/AsynchronousCache/ShardedCache.h#1 $
+
+    $NoKeywords: $
+
+********************************************************************************************************************/
+
+#pragma once
+
+#include "AsynchronousCache.h"
+#include "LatencyHistogram.h"
+#include "Numa.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif
+
+//! A thread-safe cache made of independent shards.
+//!
+//! @param	Cache       Type of the cache of each shard. It is a class derived from AsynchronousCache.
+//! @param	Hash        Hash function used to choose the shard of a key. The default is KeyHash.
+//!
+//! An AsynchronousCache is not thread-safe. This class divides the keys among several caches (shards), each
+//! protected by its own mutex, so that threads using different shards do not contend. The shards are created by a
+//! factory function, which also sets them up (e.g. with SetLoadLimits()). The member functions have the same
+//! meaning as those of AsynchronousCache, and they may be called from any thread.
+//!
+//! In NUMA mode, the shards are divided evenly among the NUMA nodes, and each shard is created by a thread running
+//! on its node, so that the shard and any memory touched by the factory are placed on the node. If the shard's cache
+//! has a member function <tt>PlaceOnNode(NumaTopology const &, std::size_t node)</tt> (as StorageCache does), it is
+//! then called so that memory not touched yet (e.g. a storage arena) is bound to the node too. A key normally
+//! belongs to a single shard, on any node. However, keys chosen by a replication policy (e.g. read-mostly hot keys)
+//! are handled by a shard on the node of the calling thread, so each node has its own copy of them. A thread's node
+//! is the node it was running on when it first used a replicated key, so a thread that migrates keeps using the same
+//! copies. A replicated element must be released by a thread on the same node as the thread that requested it, so
+//! it is best released by its address, which finds the right copy.
+//!
+//! If the shards are EventLoopCaches, then on Linux, the cache also has a file descriptor that becomes readable when
+//! a load completes in any shard (an epoll descriptor watching the shards' descriptors), and DrainCompletions()
+//! drains only the shards whose loads have completed.
+//!
+//! @note	Pointers returned by Get() remain valid until the element is released, as with AsynchronousCache.
+//! @note	This class cannot be copied or assigned.
+
+template <typename Cache, typename Hash = KeyHash<typename Cache::KeyType>>
+class ShardedCache
+{
+public:
+
+    typedef typename Cache::ElementType ElementType;    //!< Type of the element stored in the cache
+    typedef typename Cache::KeyType KeyType;            //!< Type of the element key
+    typedef typename Cache::TimePoint TimePoint;        //!< Type of a deadline
+    typedef typename Cache::Usage Usage;                //!< Number of entries in each state and their sizes
+    typedef typename Cache::Statistics Statistics;      //!< Counts of the outcomes of operations
+    typedef typename Cache::EntrySnapshot EntrySnapshot;    //!< A copy of an entry
+
+    //! Returns a new cache for a shard, given the shard's index and node
+    typedef std::function<std::unique_ptr<Cache>(std::size_t shard, std::size_t node)> Factory;
+
+    //! Returns true if an element should be replicated on each node that uses it
+    typedef std::function<bool(KeyType const & key)> ReplicationPolicy;
+
+    //! Constructor
+    ShardedCache(std::size_t               shardsPerNode,
+                 Factory const &           factory,
+                 bool                      numa   = false,
+                 ReplicationPolicy const & policy = ReplicationPolicy());
+
+    //! Destructor
+    ~ShardedCache();
+
+    ShardedCache(ShardedCache const &) = delete;                // Prevent copying
+    ShardedCache & operator =(ShardedCache const &) = delete;   // Prevent assignment
+
+    //! Starts loading a element through the cache
+    template <typename K>
+    bool Request(K && key);
+
+    //! Starts loading a element through the cache, scheduling the load according to when it is needed
+    template <typename K>
+    bool Request(K && key, TimePoint deadline);
+
+    //! Notifies the cache that this element may be needed soon
+    template <typename K>
+    bool Prefetch(K && key);
+
+    //! Returns a pointer to an element in the cache (or nullptr if it is not in the cache)
+    template <typename K>
+    ElementType * Get(K const & key);
+
+    //! Finds an entry in the cache and marks it as no longer used (optionally force eviction)
+    template <typename K,
+              typename = typename std::enable_if<!std::is_convertible<K const &, ElementType const *>::value>::type>
+    void Release(K const & key, bool forceEviction = false);
+
+    //! Finds an entry in the cache and marks it as no longer used (optionally force eviction)
+    void Release(ElementType const * pElement, bool forceEviction = false);
+
+    //! Returns @c true if the element is in the cache (though possibly released)
+    template <typename K>
+    bool IsCached(K const & key);
+
+    //! Updates every shard
+    void Update();
+
+#if defined(__linux__)
+    //! Returns a file descriptor that becomes readable when a load completes in any shard (EventLoopCache shards only)
+    int GetCompletionFd();
+
+    //! Drains the shards whose loads have completed and returns the keys of the elements that became available
+    std::size_t DrainCompletions(std::vector<KeyType> & available);
+#endif // defined(__linux__)
+
+    //! Removes all elements from the cache
+    void Clear();
+
+    //! Returns the number of entries in each state and the memory they use, summed over the shards
+    Usage GetUsage();
+
+    //! Returns the counts of the outcomes of operations, summed over the shards
+    Statistics GetStatistics();
+
+    //! Returns the histogram of the times from requests to the elements becoming available, merged over the shards
+    LatencyHistogram GetRequestLatency();
+
+    //! Returns the histogram of the times from prefetches to the elements being loaded, merged over the shards
+    LatencyHistogram GetPrefetchLatency();
+
+    //! Resets the counts and latency histograms of every shard
+    void ResetStatistics();
+
+    //! Returns copies of the entries of every shard, hottest first (optionally only the hottest few)
+    void GetSnapshot(std::vector<EntrySnapshot> & snapshot, std::size_t maxEntries = 0);
+
+    //! Locks a shard and calls a function with its cache
+    template <typename Function>
+    void Visit(std::size_t shard, Function function);
+
+    //! Returns the number of shards
+    std::size_t GetShardCount() const { return m_shards.size(); }
+
+    //! Returns the number of nodes the shards are divided among (1 unless NUMA mode is enabled)
+    std::size_t GetNodeCount() const { return m_nodeCount; }
+
+    //! Returns the node of a shard
+    std::size_t GetNodeOfShard(std::size_t shard) const { return m_shards[shard]->node; }
+
+    //! Returns the NUMA topology
+    NumaTopology const & GetTopology() const { return m_topology; }
+
+private:
+
+    // A shard. Each shard is aligned to a cache line so that the mutexes of different shards do not share one.
+    struct alignas(64) Shard
+    {
+        std::mutex mutex;               // Protects the cache
+        std::unique_ptr<Cache> pCache;  // The cache
+        std::size_t node;               // The node the shard is on
+    };
+
+    // Returns the shard responsible for a key when it is used by the calling thread
+    template <typename K>
+    Shard & ShardOf(K const & key);
+
+    // Returns true if a key is replicated
+    template <typename K>
+    bool IsReplicated(K const & key) const;
+
+    // Returns the node of the calling thread, which is found on the thread's first call and then kept
+    std::size_t ThreadNode() const;
+
+    // Determines whether a cache can place its memory on a node
+    template <typename C, typename = void>
+    struct can_place_on_node : std::false_type
+    {
+    };
+
+    template <typename C>
+    struct can_place_on_node<C, decltype(void(std::declval<C &>().PlaceOnNode(std::declval<NumaTopology const &>(),
+                                                                                std::size_t())))>
+        : std::true_type
+    {
+    };
+
+    // Mixes the bits of a hash, so that the shard does not depend on only the low bits
+    static std::size_t Mix(std::size_t hash);
+
+    NumaTopology m_topology;                        // The NUMA nodes
+    std::size_t m_nodeCount;                        // Number of nodes the shards are divided among
+    std::size_t m_shardsPerNode;                    // Number of shards on each node
+    std::vector<std::unique_ptr<Shard>> m_shards;   // The shards, grouped by node
+    ReplicationPolicy m_replicationPolicy;          // Chooses the replicated elements, or empty (never changes)
+    [[no_unique_address]] Hash m_hash;              // Hashes the keys (takes no space if it is empty)
+    std::once_flag m_completionFdOnce;              // Creates the completion file descriptor on first use
+    int m_completionFd;                             // Watches the shards' completion file descriptors, or -1
+};
+
+//! @param	shardsPerNode	Number of shards on each node (or in total, if NUMA mode is disabled)
+//! @param	factory			Returns a new cache for a shard. It is called once for each shard, on a thread running on
+//!							the shard's node in NUMA mode.
+//! @param	numa			If @c true, the shards are divided among the NUMA nodes
+//! @param	policy			Chooses the elements that are replicated on each node (none, if it is empty). It is
+//!							only used in NUMA mode, and it may be called from any thread.
+//!
+//! @throw	Any exception thrown by the factory, on the constructing thread
+
+template <typename Cache, typename Hash>
+ShardedCache<Cache, Hash>::ShardedCache(std::size_t               shardsPerNode,
+                                        Factory const &           factory,
+                                        bool                      numa /* = false*/,
+                                        ReplicationPolicy const & policy /* = ReplicationPolicy()*/)
+    : m_nodeCount(numa ? m_topology.GetNodeCount() : 1),
+    m_shardsPerNode(std::max<std::size_t>(shardsPerNode, 1)),
+    m_replicationPolicy(policy),
+    m_completionFd(-1)
+{
+    for (std::size_t node = 0; node < m_nodeCount; ++node)
+    {
+        for (std::size_t i = 0; i < m_shardsPerNode; ++i)
+        {
+            std::size_t            shard = m_shards.size();
+            std::unique_ptr<Shard> pShard;
+            std::function<void()>  create = [&] {
+                pShard.reset(new Shard);
+                pShard->node   = node;
+                pShard->pCache = factory(shard, node);
+            };
+
+            if (numa)
+            {
+                m_topology.RunOnNode(node, create);
+                if constexpr (can_place_on_node<Cache>::value)
+                {
+                    pShard->pCache->PlaceOnNode(m_topology, node);
+                }
+            }
+            else
+            {
+                create();
+            }
+            m_shards.push_back(std::move(pShard));
+        }
+    }
+}
+
+template <typename Cache, typename Hash>
+ShardedCache<Cache, Hash>::~ShardedCache()
+{
+#if defined(__linux__)
+    if (m_completionFd >= 0)
+    {
+        close(m_completionFd);
+    }
+#endif
+}
+
+//! @param	key		Element to load. It is moved into the cache if it is an rvalue.
+
+template <typename Cache, typename Hash>
+template <typename K>
+bool ShardedCache<Cache, Hash>::Request(K && key)
+{
+    Shard &                     shard = ShardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.pCache->Request(std::forward<K>(key));
+}
+
+//! @param	key			Element to load. It is moved into the cache if it is an rvalue.
+//! @param	deadline	When the element is needed
+
+template <typename Cache, typename Hash>
+template <typename K>
+bool ShardedCache<Cache, Hash>::Request(K && key, TimePoint deadline)
+{
+    Shard &                     shard = ShardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.pCache->Request(std::forward<K>(key), deadline);
+}
+
+//! @param	key		Element to prefetch. It is moved into the cache if it is an rvalue.
+
+template <typename Cache, typename Hash>
+template <typename K>
+bool ShardedCache<Cache, Hash>::Prefetch(K && key)
+{
+    Shard &                     shard = ShardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.pCache->Prefetch(std::forward<K>(key));
+}
+
+//! @param	key		Element to access
+
+template <typename Cache, typename Hash>
+template <typename K>
+typename ShardedCache<Cache, Hash>::ElementType * ShardedCache<Cache, Hash>::Get(K const & key)
+{
+    Shard &                     shard = ShardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.pCache->Get(key);
+}
+
+//! @param	key				Element to release
+//! @param	forceEviction	If @c true, the element is immediately removed from the cache storage.
+
+template <typename Cache, typename Hash>
+template <typename K, typename>
+void ShardedCache<Cache, Hash>::Release(K const & key, bool forceEviction /* = false*/)
+{
+    Shard &                     shard = ShardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.pCache->Release(key, forceEviction);
+}
+
+//! The shard holding an element cannot be determined from its address, so every shard is searched.
+//!
+//! @param	pElement		Element to release
+//! @param	forceEviction	If @c true, the element is immediately removed from the cache storage.
+
+template <typename Cache, typename Hash>
+void ShardedCache<Cache, Hash>::Release(ElementType const * pElement, bool forceEviction /* = false*/)
+{
+    for (typename std::vector<std::unique_ptr<Shard>>::iterator i = m_shards.begin(); i != m_shards.end(); ++i)
+    {
+        std::lock_guard<std::mutex> lock((*i)->mutex);
+        typename Cache::BackDoor backDoor((*i)->pCache.get());
+        if (backDoor.Find(pElement) != backDoor.GetEntries().end())
+        {
+            (*i)->pCache->Release(pElement, forceEviction);
+            break;
+        }
+    }
+}
+
+//! @param	key		Element to check
+
+template <typename Cache, typename Hash>
+template <typename K>
+bool ShardedCache<Cache, Hash>::IsCached(K const & key)
+{
+    Shard &                     shard = ShardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.pCache->IsCached(key);
+}
+
+//! Each shard is locked and updated in turn.
+
+template <typename Cache, typename Hash>
+void ShardedCache<Cache, Hash>::Update()
+{
+    for (typename std::vector<std::unique_ptr<Shard>>::iterator i = m_shards.begin(); i != m_shards.end(); ++i)
+    {
+        std::lock_guard<std::mutex> lock((*i)->mutex);
+        (*i)->pCache->Update();
+    }
+}
+
+#if defined(__linux__)
+
+//! The file descriptor is an epoll descriptor watching the completion file descriptors of all the shards. It is
+//! created on first use, and it is owned by the cache.
+//!
+//! @throw	std::system_error	If the file descriptor cannot be created
+
+template <typename Cache, typename Hash>
+int ShardedCache<Cache, Hash>::GetCompletionFd()
+{
+    std::call_once(m_completionFdOnce, [this] {
+        int fd = epoll_create1(EPOLL_CLOEXEC);
+        if (fd < 0)
+        {
+            throw std::system_error(errno, std::generic_category(), "epoll_create1");
+        }
+
+        // Each shard's descriptor is tagged with the shard's index
+
+        for (std::size_t i = 0; i < m_shards.size(); ++i)
+        {
+            epoll_event event = epoll_event();
+            event.events   = EPOLLIN;
+            event.data.u64 = i;
+            if (epoll_ctl(fd, EPOLL_CTL_ADD, m_shards[i]->pCache->GetCompletionFd(), &event) != 0)
+            {
+                int error = errno;
+                close(fd);
+                throw std::system_error(error, std::generic_category(), "epoll_ctl");
+            }
+        }
+        m_completionFd = fd;
+    });
+    return m_completionFd;
+}
+
+//! Only the shards whose completion file descriptors are readable are locked and drained (see
+//! EventLoopCache::DrainCompletions()). This function is normally called when the file descriptor returned by
+//! GetCompletionFd() becomes readable.
+//!
+//! @param	available	Vector to which the keys of the newly available elements are appended
+//!
+//! @return		The number of keys appended to @a available
+
+template <typename Cache, typename Hash>
+std::size_t ShardedCache<Cache, Hash>::DrainCompletions(std::vector<KeyType> & available)
+{
+    static int const MAX_EVENTS = 64;
+
+    int         fd = GetCompletionFd();
+    std::size_t n  = 0;
+    epoll_event events[MAX_EVENTS];
+    int         count;
+
+    do
+    {
+        count = epoll_wait(fd, events, MAX_EVENTS, 0);
+        for (int i = 0; i < count; ++i)
+        {
+            Shard &                     shard = *m_shards[events[i].data.u64];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            n += shard.pCache->DrainCompletions(available);
+        }
+    } while (count == MAX_EVENTS);
+
+    return n;
+}
+
+#endif // defined(__linux__)
+
+template <typename Cache, typename Hash>
+void ShardedCache<Cache, Hash>::Clear()
+{
+    for (typename std::vector<std::unique_ptr<Shard>>::iterator i = m_shards.begin(); i != m_shards.end(); ++i)
+    {
+        std::lock_guard<std::mutex> lock((*i)->mutex);
+        (*i)->pCache->Clear();
+    }
+}
+
+//! The shards are locked one at a time, so the totals are not a snapshot of a single moment.
+
+template <typename Cache, typename Hash>
+typename ShardedCache<Cache, Hash>::Usage ShardedCache<Cache, Hash>::GetUsage()
+{
+    Usage total = Usage();
+    for (typename std::vector<std::unique_ptr<Shard>>::iterator i = m_shards.begin(); i != m_shards.end(); ++i)
+    {
+        Usage usage;
+        {
+            std::lock_guard<std::mutex> lock((*i)->mutex);
+            usage = (*i)->pCache->GetUsage();
+        }
+        total.requested       += usage.requested;
+        total.prefetched      += usage.prefetched;
+        total.available       += usage.available;
+        total.released        += usage.released;
+        total.requestedBytes  += usage.requestedBytes;
+        total.prefetchedBytes += usage.prefetchedBytes;
+        total.availableBytes  += usage.availableBytes;
+        total.releasedBytes   += usage.releasedBytes;
+        total.overheadBytes   += usage.overheadBytes;
+    }
+    return total;
+}
+
+//! Each shard counts its own operations while it is locked, so the counters are never shared between threads. The
+//! shards are locked one at a time, so the totals are not a snapshot of a single moment.
+
+template <typename Cache, typename Hash>
+typename ShardedCache<Cache, Hash>::Statistics ShardedCache<Cache, Hash>::GetStatistics()
+{
+    Statistics total = Statistics();
+    for (typename std::vector<std::unique_ptr<Shard>>::iterator i = m_shards.begin(); i != m_shards.end(); ++i)
+    {
+        Statistics statistics;
+        {
+            std::lock_guard<std::mutex> lock((*i)->mutex);
+            statistics = (*i)->pCache->GetStatistics();
+        }
+        total.getHits          += statistics.getHits;
+        total.getMisses        += statistics.getMisses;
+        total.requestHits      += statistics.requestHits;
+        total.prefetchHits     += statistics.prefetchHits;
+        total.reloads          += statistics.reloads;
+        total.requestMisses    += statistics.requestMisses;
+        total.requestFailures  += statistics.requestFailures;
+        total.prefetches       += statistics.prefetches;
+        total.prefetchFailures += statistics.prefetchFailures;
+        total.evictions        += statistics.evictions;
+    }
+    return total;
+}
+
+//! The shards' histograms are disabled by default, so the factory enables them (with SetLatencyHistograms()) if
+//! they are wanted. A shard whose histograms are disabled adds nothing.
+
+template <typename Cache, typename Hash>
+LatencyHistogram ShardedCache<Cache, Hash>::GetRequestLatency()
+{
+    LatencyHistogram total;
+    for (typename std::vector<std::unique_ptr<Shard>>::iterator i = m_shards.begin(); i != m_shards.end(); ++i)
+    {
+        std::lock_guard<std::mutex> lock((*i)->mutex);
+        total.Merge((*i)->pCache->GetRequestLatency());
+    }
+    return total;
+}
+
+template <typename Cache, typename Hash>
+LatencyHistogram ShardedCache<Cache, Hash>::GetPrefetchLatency()
+{
+    LatencyHistogram total;
+    for (typename std::vector<std::unique_ptr<Shard>>::iterator i = m_shards.begin(); i != m_shards.end(); ++i)
+    {
+        std::lock_guard<std::mutex> lock((*i)->mutex);
+        total.Merge((*i)->pCache->GetPrefetchLatency());
+    }
+    return total;
+}
+
+template <typename Cache, typename Hash>
+void ShardedCache<Cache, Hash>::ResetStatistics()
+{
+    for (typename std::vector<std::unique_ptr<Shard>>::iterator i = m_shards.begin(); i != m_shards.end(); ++i)
+    {
+        std::lock_guard<std::mutex> lock((*i)->mutex);
+        (*i)->pCache->ResetStatistics();
+    }
+}
+
+//! Each shard's entries are copied while it is locked, so each shard's part of the snapshot is consistent, but the
+//! shards are locked one at a time. When only the hottest entries are wanted, only that many are taken from each
+//! shard, since the hottest entries overall are among them.
+//!
+//! @param	snapshot	Receives the copies of the entries, replacing its contents
+//! @param	maxEntries	Maximum number of entries returned (0 means all of them)
+
+template <typename Cache, typename Hash>
+void ShardedCache<Cache, Hash>::GetSnapshot(std::vector<EntrySnapshot> & snapshot, std::size_t maxEntries /* = 0*/)
+{
+    std::vector<EntrySnapshot> shard;
+
+    snapshot.clear();
+    for (typename std::vector<std::unique_ptr<Shard>>::iterator i = m_shards.begin(); i != m_shards.end(); ++i)
+    {
+        {
+            std::lock_guard<std::mutex> lock((*i)->mutex);
+            (*i)->pCache->GetSnapshot(shard, maxEntries);
+        }
+        snapshot.insert(snapshot.end(), std::make_move_iterator(shard.begin()), std::make_move_iterator(shard.end()));
+    }
+
+    if (maxEntries > 0 && maxEntries < snapshot.size())
+    {
+        std::partial_sort(snapshot.begin(), snapshot.begin() + maxEntries, snapshot.end(),
+                          typename EntrySnapshot::hotter());
+        snapshot.resize(maxEntries);
+    }
+    else
+    {
+        std::sort(snapshot.begin(), snapshot.end(), typename EntrySnapshot::hotter());
+    }
+}
+
+//! @param	shard		Index of the shard
+//! @param	function	Function called with a reference to the shard's cache while the shard is locked
+
+template <typename Cache, typename Hash>
+template <typename Function>
+void ShardedCache<Cache, Hash>::Visit(std::size_t shard, Function function)
+{
+    std::lock_guard<std::mutex> lock(m_shards[shard]->mutex);
+    function(*m_shards[shard]->pCache);
+}
+
+template <typename Cache, typename Hash>
+template <typename K>
+typename ShardedCache<Cache, Hash>::Shard & ShardedCache<Cache, Hash>::ShardOf(K const & key)
+{
+    std::size_t hash = Mix(m_hash(key));
+
+    // A replicated key belongs to a shard on the calling thread's node. Otherwise, it belongs to a single shard.
+
+    if (m_nodeCount > 1 && IsReplicated(key))
+    {
+        return *m_shards[ThreadNode() * m_shardsPerNode + hash % m_shardsPerNode];
+    }
+    return *m_shards[hash % m_shards.size()];
+}
+
+template <typename Cache, typename Hash>
+template <typename K>
+bool ShardedCache<Cache, Hash>::IsReplicated(K const & key) const
+{
+    if (!m_replicationPolicy)
+    {
+        return false;
+    }
+    if constexpr (std::is_same<typename std::decay<K>::type, KeyType>::value)
+    {
+        return m_replicationPolicy(key);
+    }
+    else
+    {
+        return m_replicationPolicy(KeyType(key));
+    }
+}
+
+//! Asking the system for the current CPU on every call would send a thread that migrates between nodes to a
+//! different copy of an element than the one it requested.
+
+template <typename Cache, typename Hash>
+std::size_t ShardedCache<Cache, Hash>::ThreadNode() const
+{
+    thread_local std::size_t node = m_topology.GetCurrentNode();
+    return node % m_nodeCount;
+}
+
+template <typename Cache, typename Hash>
+std::size_t ShardedCache<Cache, Hash>::Mix(std::size_t hash)
+{
+    std::uint64_t h = hash;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    return (std::size_t)h;
+}
@@ -0,0 +1,248 @@
+/** @file *//********************************************************************************************************
+
+                                                   SlabAllocator.h
+
+                                            Copyright 2006, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/AsynchronousCache/SlabAllocator.h#1 $
+
+    $NoKeywords: $
+
+********************************************************************************************************************/
+
+#pragma once
+
+#include "Arena.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+//! A slab allocator for elements of a few fixed sizes.
+//!
+//! @param	Arena		Type of the memory managed by the allocator. The default is HeapArena. Large storage may
+//!						use HugePageArena to reduce TLB misses.
+//!
+//! The memory is divided into slabs, one per size class. Each slab holds a fixed number of slots of its class's
+//! size. An allocation is served from the slab of the smallest class that is large enough, and the slots are kept in
+//! an intrusive free list, so allocating, freeing, and checking for room are O(1) (plus a search of the size
+//! classes). Since a slot is never split or merged, the memory never fragments and the memory use is fixed when the
+//! allocator is constructed.
+//!
+//! @note	An allocation never spills into a larger size class, so a class can be full while others are not.
+//! @note	This class cannot be copied or assigned.
+
+template <typename Arena = HeapArena>
+class SlabAllocator
+{
+public:
+
+    //! A size class
+    struct SizeClass
+    {
+        std::size_t size;       //!< Size of each slot in the class
+        std::size_t count;      //!< Number of slots in the class
+    };
+
+    //! Constructor
+    explicit SlabAllocator(std::vector<SizeClass> const & classes);
+
+    SlabAllocator(SlabAllocator const &) = delete;              // Prevent copying
+    SlabAllocator & operator =(SlabAllocator const &) = delete; // Prevent assignment
+
+    //! Allocates a block of memory, or returns nullptr if the size class is full
+    void * Allocate(std::size_t size);
+
+    //! Frees a block of memory returned by Allocate()
+    void Free(void * p);
+
+    //! Slabs do not fragment, so there is never a reason to move a block. This function always returns nullptr.
+    void * AllocateBelow(std::size_t /* size */, void * /* p */) { return 0; }
+
+    //! Slabs do not fragment. This function always returns 0.
+    double GetFragmentation() const { return 0.0; }
+
+    //! Returns true if a block of the given size can be allocated
+    bool HasRoomFor(std::size_t size) const;
+
+    //! Returns true if freeing the block would make room for a block of the given size
+    bool FreeingMakesRoomFor(void * p, std::size_t size) const;
+
+    //! Returns the total size of the slabs
+    std::size_t GetCapacity() const { return m_arena.GetSize(); }
+
+    //! Returns the number of bytes in allocated slots
+    std::size_t GetBytesInUse() const { return m_bytesInUse; }
+
+    //! Returns the arena
+    Arena const & GetArena() const { return m_arena; }
+
+    //! Returns the size of the pages backing the arena, or 0 if it is not known
+    std::size_t GetPageSize() const { return m_arena.GetPageSize(); }
+
+    //! Returns the kind of pages backing the arena
+    PageKind GetPageKind() const { return m_arena.GetPageKind(); }
+
+private:
+
+    // A free slot. The free list is stored in the free slots themselves.
+    struct FreeSlot
+    {
+        FreeSlot * pNext;
+    };
+
+    // A slab of slots of one size
+    struct Slab
+    {
+        std::size_t size;       // Size of each slot (rounded up for alignment)
+        char * pBegin;          // First slot
+        char * pEnd;            // Just past the last slot
+        FreeSlot * pFree;       // List of free slots
+    };
+
+    // Returns the slot size rounded up so that every slot is suitably aligned
+    static std::size_t SlotSize(std::size_t size);
+
+    // Returns the total size of the slabs for the specified size classes
+    static std::size_t TotalSize(std::vector<SizeClass> const & classes);
+
+    // Returns the slab of the smallest class that can hold the size, or m_slabs.end()
+    typename std::vector<Slab>::const_iterator FindSlab(std::size_t size) const;
+
+    Arena m_arena;                  // Memory for the slabs
+    std::vector<Slab> m_slabs;      // The slabs, by increasing size
+    std::size_t m_bytesInUse;       // Number of bytes in allocated slots
+};
+
+//! @param	classes		Size classes. There is one slab per class, holding @c count slots of @c size bytes.
+
+template <typename Arena>
+SlabAllocator<Arena>::SlabAllocator(std::vector<SizeClass> const & classes)
+    : m_arena(TotalSize(classes)),
+    m_bytesInUse(0)
+{
+    std::vector<SizeClass> sorted(classes);
+    std::sort(sorted.begin(), sorted.end(), [] (SizeClass const & a, SizeClass const & b) { return a.size < b.size; });
+
+    // Carve the arena into slabs and thread each slab's slots onto its free list
+
+    char * p = static_cast<char *>(m_arena.GetMemory());
+    for (typename std::vector<SizeClass>::const_iterator c = sorted.begin(); c != sorted.end(); ++c)
+    {
+        Slab slab;
+        slab.size   = SlotSize(c->size);
+        slab.pBegin = p;
+        slab.pEnd   = p + slab.size * c->count;
+        slab.pFree  = 0;
+
+        for (char * pSlot = slab.pEnd; pSlot != slab.pBegin;)
+        {
+            pSlot -= slab.size;
+            FreeSlot * pFree = reinterpret_cast<FreeSlot *>(pSlot);
+            pFree->pNext = slab.pFree;
+            slab.pFree   = pFree;
+        }
+
+        m_slabs.push_back(slab);
+        p = slab.pEnd;
+    }
+}
+
+//! @param	size	Number of bytes to allocate
+//!
+//! @return		The address of the block, or nullptr if there is no free slot in the size class
+
+template <typename Arena>
+void * SlabAllocator<Arena>::Allocate(std::size_t size)
+{
+    typename std::vector<Slab>::const_iterator i = FindSlab(size);
+    if (i == m_slabs.end() || i->pFree == 0)
+    {
+        return 0;
+    }
+
+    Slab &     slab  = m_slabs[i - m_slabs.begin()];
+    FreeSlot * pSlot = slab.pFree;
+    slab.pFree    = pSlot->pNext;
+    m_bytesInUse += slab.size;
+    return pSlot;
+}
+
+//! @param	p	Address of the block to free. If it is nullptr, nothing is done.
+
+template <typename Arena>
+void SlabAllocator<Arena>::Free(void * p)
+{
+    if (p == 0)
+    {
+        return;
+    }
+
+    // The slabs are contiguous and in address order, so the slab containing the block is the first one ending
+    // after it.
+
+    char * pSlot = static_cast<char *>(p);
+    typename std::vector<Slab>::iterator i = m_slabs.begin();
+    while (i->pEnd <= pSlot)
+    {
+        ++i;
+    }
+
+    FreeSlot * pFree = static_cast<FreeSlot *>(p);
+    pFree->pNext  = i->pFree;
+    i->pFree      = pFree;
+    m_bytesInUse -= i->size;
+}
+
+//! @param	size	Number of bytes
+
+template <typename Arena>
+bool SlabAllocator<Arena>::HasRoomFor(std::size_t size) const
+{
+    typename std::vector<Slab>::const_iterator i = FindSlab(size);
+    return i != m_slabs.end() && i->pFree != 0;
+}
+
+//! Freeing a block makes room only if the block is in the slab that would serve the allocation.
+//!
+//! @param	p		Address of an allocated block
+//! @param	size	Number of bytes
+
+template <typename Arena>
+bool SlabAllocator<Arena>::FreeingMakesRoomFor(void * p, std::size_t size) const
+{
+    typename std::vector<Slab>::const_iterator i = FindSlab(size);
+    return i != m_slabs.end() && i->pBegin <= static_cast<char *>(p) && static_cast<char *>(p) < i->pEnd;
+}
+
+template <typename Arena>
+std::size_t SlabAllocator<Arena>::SlotSize(std::size_t size)
+{
+    std::size_t const alignment = alignof(std::max_align_t);
+    size = std::max(size, sizeof(FreeSlot));
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+template <typename Arena>
+std::size_t SlabAllocator<Arena>::TotalSize(std::vector<SizeClass> const & classes)
+{
+    std::size_t total = 0;
+    for (typename std::vector<SizeClass>::const_iterator c = classes.begin(); c != classes.end(); ++c)
+    {
+        total += SlotSize(c->size) * c->count;
+    }
+    return total;
+}
+
+template <typename Arena>
+typename std::vector<typename SlabAllocator<Arena>::Slab>::const_iterator SlabAllocator<Arena>::FindSlab(
+    std::size_t size) const
+{
+    typename std::vector<Slab>::const_iterator i = m_slabs.begin();
+    while (i != m_slabs.end() && i->size < size)
+    {
+        ++i;
+    }
+    return i;
+}
@@ -0,0 +1,792 @@
+/** @file *//********************************************************************************************************
+
+                                                     SpillTier.h
+
+                                            Copyright 2006, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/AsynchronousCache/SpillTier.h#1 $
+
+    $NoKeywords: $
+
+********************************************************************************************************************/
+
+#pragma once
+
+#include "ElementTier.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+//! A tier of elements spilled to files in a local directory.
+//!
+//! @param	Key         Type of a key for accessing an element in the cache
+//!
+//! When a StorageCache with a spill tier unloads an element, the element is written to a file in the spill
+//! directory. When the element is loaded again, it is read from the file instead of from its origin, if that is
+//! expected to be faster. This is intended for a fast local disk in front of a slow origin (e.g. a network file
+//! system).
+//!
+//! All file operations are done by a worker thread, so inserting an element only copies it into a write buffer.
+//! An element whose write is still buffered is extracted directly from the buffer. Reads are done before writes.
+//!
+//! The spill directory contains one file per element and an index file, which is a log of the elements added and
+//! removed. The index is read when the tier is constructed, so the spilled elements survive a restart. Keys are
+//! identified in the index by a name returned by a function supplied to the constructor, which must be unique and
+//! stable across runs. An element's data is assumed never to change, so an element that is already in the tier is
+//! not written again.
+//!
+//! The tier has a fixed capacity, and the least recently used elements are removed to make room. Unlike a
+//! CompressedTier, the tier is inclusive: an element stays in the tier when it is extracted.
+//!
+//! The decision to read an element from the tier is based on a simple cost model: the time to read it from the tier
+//! (the latency, plus the time to transfer it and the reads queued ahead of it) is compared to the time to read it
+//! from its origin. The costs are set with SetCosts(). By default, the origin is assumed to be infinitely slow.
+//!
+//! @note	The member functions must be called from one thread (the cache's thread).
+//! @note	This class cannot be copied or assigned.
+
+template <typename Key>
+class SpillTier : public ElementTier<Key>
+{
+public:
+
+    //! A function returning the name of a key, which identifies it in the index
+    typedef std::function<std::string(Key const &)> NameFunction;
+
+    //! Constructor
+    SpillTier(std::string const & directory,
+              std::size_t         capacity,
+              NameFunction        name,
+              std::size_t         maxBufferedBytes = 64 * 1024 * 1024);
+
+    //! Destructor
+    virtual ~SpillTier();
+
+    SpillTier(SpillTier const &) = delete;                  // Prevent copying
+    SpillTier & operator =(SpillTier const &) = delete;     // Prevent assignment
+
+    //! Sets the parameters of the cost model
+    void SetCosts(double originLatency, double originBytesPerSecond, double spillLatency, double spillBytesPerSecond);
+
+    //! Queues an element to be written to the tier. Returns false if it does not fit or the write buffer is full.
+    virtual bool Insert(Key const & key, void const * pData, std::size_t size) override;
+
+    //! Reads an element from the tier, waiting for the read to complete
+    virtual bool Extract(Key const & key, void * pData, std::size_t size) override;
+
+    //! Starts reading an element from the tier, if it is cheaper than reading it from its origin
+    virtual bool StartExtract(Key const & key, void * pData, std::size_t size, std::atomic<int> * pStatus) override;
+
+    //! Cancels a read started by StartExtract()
+    virtual void CancelExtract(void * pData) override;
+
+    //! Returns true if the element is in the tier
+    bool Contains(Key const & key) const;
+
+    //! Removes an element from the tier
+    void Erase(Key const & key);
+
+    //! Waits until all queued writes and removals are done
+    void Flush();
+
+    //! Returns the capacity of the tier, in bytes
+    std::size_t GetCapacity() const { return m_capacity; }
+
+    //! Returns the number of bytes of the elements in the tier
+    std::size_t GetBytesInUse() const;
+
+private:
+
+    // A spilled element
+    struct Item
+    {
+        std::string name;                                       // Name of the element's key
+        std::uint64_t id;                                       // Identifies the element's file
+        std::size_t size;                                       // Size of the element
+        std::shared_ptr<std::vector<unsigned char> > pBuffer;   // The data, until it has been written, or nullptr
+    };
+
+    typedef std::list<Item> ItemList;
+    typedef std::unordered_map<std::string, typename ItemList::iterator> ItemMap;
+
+    // A file operation done by the worker thread
+    struct Job
+    {
+        enum Type
+        {
+            WRITE,
+            REMOVE,
+            READ
+        };
+
+        Type type;
+        std::uint64_t id;                                       // Identifies the file
+        std::string name;                                       // Name of the key (WRITE and READ)
+        std::size_t size;                                       // Size of the element (WRITE and READ)
+        std::shared_ptr<std::vector<unsigned char> > pBuffer;   // Data to write (WRITE)
+        void * pData;                                           // Destination of the data (READ)
+        std::atomic<int> * pStatus;                             // Receives the status of the read (READ)
+    };
+
+    // Returns the path of a file in the spill directory
+    std::string PathOf(std::uint64_t id, char const * extension) const;
+
+    // Reads the index, discards elements whose files are missing, and rewrites the index
+    void LoadIndex();
+
+    // Reads a name of the given length from the index. Returns false if the index ends first.
+    static bool ReadName(std::FILE * pFile, std::uint64_t length, std::string & name);
+
+    // Starts reading an element, optionally only if it is cheaper than reading it from its origin
+    bool Start(Key const & key, void * pData, std::size_t size, std::atomic<int> * pStatus, bool compareCosts);
+
+    // Removes an item and queues the removal of its file. The lock must be held.
+    void Erase(typename ItemList::iterator pItem);
+
+    // Processes jobs until the tier is destroyed
+    void Work();
+
+    // Does a job
+    bool Write(Job const & job);
+    void Remove(Job const & job);
+    bool Read(Job const & job);
+
+    // Appends a record to the index
+    void Log(char type, std::uint64_t id, std::size_t size, std::string const & name);
+
+    std::string m_directory;                // The spill directory
+    std::size_t m_capacity;                 // Maximum number of bytes in the tier
+    NameFunction m_name;                    // Returns the name of a key
+    std::size_t m_maxBufferedBytes;         // Maximum number of bytes waiting to be written
+    double m_originLatency;                 // Cost model: latency of a read from the origin (seconds)
+    double m_originBytesPerSecond;          // Cost model: transfer rate of the origin
+    double m_spillLatency;                  // Cost model: latency of a read from the tier (seconds)
+    double m_spillBytesPerSecond;           // Cost model: transfer rate of the tier
+
+    mutable std::mutex m_mutex;             // Guards everything below
+    std::condition_variable m_wake;         // Signaled when a job is queued or the tier is being destroyed
+    std::condition_variable m_done;         // Signaled when a job is done
+    ItemList m_items;                       // The elements, least recently used first
+    ItemMap m_index;                        // Index of the elements by name
+    std::size_t m_bytesInUse;               // Number of bytes of the elements
+    std::size_t m_bufferedBytes;            // Number of bytes waiting to be written
+    std::size_t m_queuedReadBytes;          // Number of bytes waiting to be read
+    std::uint64_t m_nextId;                 // Id of the next element's file
+    std::deque<Job> m_reads;                // Queued reads
+    std::deque<Job> m_jobs;                 // Queued writes and removals, in order
+    void * m_pActiveRead;                   // Destination of the read in progress, or nullptr
+    bool m_working;                         // True while the worker is doing a job
+    bool m_stopping;                        // True when the tier is being destroyed
+
+    std::FILE * m_pIndexFile;               // The index, open for appending (used by the worker)
+    std::thread m_worker;                   // Does the file operations
+};
+
+//! The spill directory is created if it does not exist, and the elements already in it are recovered from its
+//! index.
+//!
+//! @param	directory			The spill directory
+//! @param	capacity			Maximum number of bytes in the tier
+//! @param	name				Returns the name of a key. The name must be unique and stable across runs.
+//! @param	maxBufferedBytes	Maximum number of bytes waiting to be written. Elements inserted when the buffer is
+//!								full are dropped.
+//!
+//! @throw	std::system_error	The spill directory or its index cannot be created
+
+template <typename Key>
+SpillTier<Key>::SpillTier(std::string const & directory,
+                          std::size_t         capacity,
+                          NameFunction        name,
+                          std::size_t         maxBufferedBytes /* = 64 * 1024 * 1024*/)
+    : m_directory(directory),
+    m_capacity(capacity),
+    m_name(name),
+    m_maxBufferedBytes(maxBufferedBytes),
+    m_originLatency(std::numeric_limits<double>::infinity()),
+    m_originBytesPerSecond(std::numeric_limits<double>::infinity()),
+    m_spillLatency(0.0),
+    m_spillBytesPerSecond(std::numeric_limits<double>::infinity()),
+    m_bytesInUse(0),
+    m_bufferedBytes(0),
+    m_queuedReadBytes(0),
+    m_nextId(1),
+    m_pActiveRead(0),
+    m_working(false),
+    m_stopping(false),
+    m_pIndexFile(0)
+{
+    std::filesystem::create_directories(m_directory);
+    LoadIndex();
+    m_worker = std::thread(&SpillTier::Work, this);
+}
+
+//! Queued writes and removals are completed before the tier is destroyed. Reads must have been completed or
+//! canceled.
+
+template <typename Key>
+SpillTier<Key>::~SpillTier()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_one();
+    m_worker.join();
+    std::fclose(m_pIndexFile);
+}
+
+//! The costs are compared as time: an element is read from the tier only if
+//! <tt>spillLatency + (queued + size) / spillBytesPerSecond < originLatency + size / originBytesPerSecond</tt>,
+//! where @c queued is the number of bytes of the reads queued ahead of it.
+//!
+//! @param	originLatency			Latency of a read from the origin, in seconds
+//! @param	originBytesPerSecond	Transfer rate of the origin
+//! @param	spillLatency			Latency of a read from the tier, in seconds
+//! @param	spillBytesPerSecond		Transfer rate of the tier
+
+template <typename Key>
+void SpillTier<Key>::SetCosts(double originLatency,
+                              double originBytesPerSecond,
+                              double spillLatency,
+                              double spillBytesPerSecond)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_originLatency        = originLatency;
+    m_originBytesPerSecond = originBytesPerSecond;
+    m_spillLatency         = spillLatency;
+    m_spillBytesPerSecond  = spillBytesPerSecond;
+}
+
+//! The element is copied into a buffer and written by the worker thread. If the element is already in the tier, it
+//! is not written again. The least recently used elements are removed to make room.
+//!
+//! @param	key		Key of the element
+//! @param	pData	The element's data
+//! @param	size	Size of the element
+//!
+//! @return		@c false, if the element does not fit in the tier or the write buffer is full
+
+template <typename Key>
+bool SpillTier<Key>::Insert(Key const & key, void const * pData, std::size_t size)
+{
+    std::string name = m_name(key);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    typename ItemMap::iterator i = m_index.find(name);
+    if (i != m_index.end())
+    {
+        if (i->second->size == size)
+        {
+            m_items.splice(m_items.end(), m_items, i->second);
+            return true;
+        }
+        Erase(i->second);
+    }
+
+    if (size > m_capacity || m_bufferedBytes + size > m_maxBufferedBytes)
+    {
+        return false;
+    }
+
+    while (m_bytesInUse + size > m_capacity)
+    {
+        Erase(m_items.begin());
+    }
+
+    unsigned char const * p = static_cast<unsigned char const *>(pData);
+
+    Item item;
+    item.name    = name;
+    item.id      = m_nextId++;
+    item.size    = size;
+    item.pBuffer = std::make_shared<std::vector<unsigned char> >(p, p + size);
+
+    Job job;
+    job.type    = Job::WRITE;
+    job.id      = item.id;
+    job.name    = name;
+    job.size    = size;
+    job.pBuffer = item.pBuffer;
+    job.pData   = 0;
+    job.pStatus = 0;
+
+    typename ItemList::iterator pItem = m_items.insert(m_items.end(), std::move(item));
+    m_index.insert(typename ItemMap::value_type(std::move(name), pItem));
+    m_bytesInUse    += size;
+    m_bufferedBytes += size;
+    m_jobs.push_back(std::move(job));
+
+    lock.unlock();
+    m_wake.notify_one();
+    return true;
+}
+
+//! Unlike StartExtract(), this function ignores the cost model.
+//!
+//! @param	key		Key of the element
+//! @param	pData	Receives the element's data
+//! @param	size	Size of the element
+//!
+//! @return		@c false, if the element is not in the tier or could not be read
+
+template <typename Key>
+bool SpillTier<Key>::Extract(Key const & key, void * pData, std::size_t size)
+{
+    std::atomic<int> status(ElementTier<Key>::EXTRACT_PENDING);
+    if (!Start(key, pData, size, &status, false))
+    {
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [&status] { return status != ElementTier<Key>::EXTRACT_PENDING; });
+    return status == ElementTier<Key>::EXTRACT_DONE;
+}
+
+//! If the element's write is still buffered, it is copied from the buffer immediately. Otherwise, the read is queued
+//! for the worker thread, provided that the cost model says that it is faster than reading it from its origin.
+//!
+//! @param	key			Key of the element
+//! @param	pData		Receives the element's data
+//! @param	size		Size of the element
+//! @param	pStatus		Receives the status of the read
+//!
+//! @return		@c false, if the element is not in the tier or it is cheaper to read it from its origin
+
+template <typename Key>
+bool SpillTier<Key>::StartExtract(Key const & key, void * pData, std::size_t size, std::atomic<int> * pStatus)
+{
+    return Start(key, pData, size, pStatus, true);
+}
+
+//! If the read is queued, it is removed from the queue. If it is in progress, this function waits for it to finish.
+//!
+//! @param	pData		The destination of the read
+
+template <typename Key>
+void SpillTier<Key>::CancelExtract(void * pData)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    for (typename std::deque<Job>::iterator i = m_reads.begin(); i != m_reads.end(); ++i)
+    {
+        if (i->pData == pData)
+        {
+            m_queuedReadBytes -= i->size;
+            m_reads.erase(i);
+            return;
+        }
+    }
+
+    m_done.wait(lock, [this, pData] { return m_pActiveRead != pData; });
+}
+
+//! @param	key		Key of the element
+
+template <typename Key>
+bool SpillTier<Key>::Contains(Key const & key) const
+{
+    std::string name = m_name(key);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_index.find(name) != m_index.end();
+}
+
+//! @param	key		Key of the element
+
+template <typename Key>
+void SpillTier<Key>::Erase(Key const & key)
+{
+    std::string name = m_name(key);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    typename ItemMap::iterator i = m_index.find(name);
+    if (i != m_index.end())
+    {
+        Erase(i->second);
+        lock.unlock();
+        m_wake.notify_one();
+    }
+}
+
+template <typename Key>
+void SpillTier<Key>::Flush()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this] { return m_jobs.empty() && !m_working; });
+}
+
+template <typename Key>
+std::size_t SpillTier<Key>::GetBytesInUse() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_bytesInUse;
+}
+
+template <typename Key>
+std::string SpillTier<Key>::PathOf(std::uint64_t id, char const * extension) const
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx%s", (unsigned long long)id, extension);
+    return (std::filesystem::path(m_directory) / name).string();
+}
+
+//! The index is a sequence of records. An 'A' record (an element was added) consists of the type, the id, the size,
+//! the length of the name, and the name. An 'R' record (an element was removed) consists of the type and the id.
+//! Numbers are stored as 8-byte native integers. A truncated record at the end is ignored.
+
+template <typename Key>
+void SpillTier<Key>::LoadIndex()
+{
+    std::string indexPath = (std::filesystem::path(m_directory) / "index").string();
+
+    // Replay the log. The elements are kept in the order in which they were added.
+
+    std::map<std::uint64_t, Item> items;
+    if (std::FILE * pFile = std::fopen(indexPath.c_str(), "rb"))
+    {
+        char type;
+        std::uint64_t id;
+        while (std::fread(&type, 1, 1, pFile) == 1 && std::fread(&id, sizeof(id), 1, pFile) == 1)
+        {
+            if (type == 'A')
+            {
+                std::uint64_t size;
+                std::uint64_t length;
+                if (std::fread(&size, sizeof(size), 1, pFile) != 1 ||
+                    std::fread(&length, sizeof(length), 1, pFile) != 1)
+                {
+                    break;
+                }
+                std::string name;
+                if (!ReadName(pFile, length, name))
+                {
+                    break;
+                }
+                Item & item = items[id];
+                item.name  = std::move(name);
+                item.id    = id;
+                item.size  = (std::size_t)size;
+            }
+            else if (type == 'R')
+            {
+                items.erase(id);
+            }
+            else
+            {
+                break;
+            }
+
+            if (id >= m_nextId)
+            {
+                m_nextId = id + 1;
+            }
+        }
+        std::fclose(pFile);
+    }
+
+    // Keep the elements whose files are intact, and remove any other files (e.g. unfinished writes)
+
+    std::error_code error;
+    for (typename std::map<std::uint64_t, Item>::iterator i = items.begin(); i != items.end(); ++i)
+    {
+        Item & item = i->second;
+        if (m_index.find(item.name) == m_index.end() &&
+            std::filesystem::file_size(PathOf(item.id, ".spill"), error) == item.size && !error)
+        {
+            typename ItemList::iterator pItem = m_items.insert(m_items.end(), std::move(item));
+            m_index.insert(typename ItemMap::value_type(pItem->name, pItem));
+            m_bytesInUse += item.size;
+        }
+    }
+
+    std::vector<std::uint64_t> kept;
+    for (typename ItemList::iterator i = m_items.begin(); i != m_items.end(); ++i)
+    {
+        kept.push_back(i->id);
+    }
+    std::sort(kept.begin(), kept.end());
+
+    for (std::filesystem::directory_iterator i(m_directory); i != std::filesystem::directory_iterator(); ++i)
+    {
+        std::filesystem::path path = i->path();
+        if (path.extension() == ".spill" || path.extension() == ".tmp")
+        {
+            std::uint64_t id = std::strtoull(path.stem().string().c_str(), 0, 16);
+            if (path.extension() == ".tmp" || !std::binary_search(kept.begin(), kept.end(), id))
+            {
+                std::filesystem::remove(path, error);
+            }
+        }
+    }
+
+    // Rewrite the index without the removed elements
+
+    std::string newPath = indexPath + ".new";
+    m_pIndexFile = std::fopen(newPath.c_str(), "wb");
+    if (m_pIndexFile == 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "SpillTier: cannot create the index");
+    }
+    for (typename ItemList::iterator i = m_items.begin(); i != m_items.end(); ++i)
+    {
+        Log('A', i->id, i->size, i->name);
+    }
+    std::fclose(m_pIndexFile);
+    std::filesystem::rename(newPath, indexPath);
+
+    m_pIndexFile = std::fopen(indexPath.c_str(), "ab");
+    if (m_pIndexFile == 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "SpillTier: cannot open the index");
+    }
+
+    while (m_bytesInUse > m_capacity)
+    {
+        Erase(m_items.begin());
+    }
+}
+
+//! The name is read in chunks, so a corrupt length in the index cannot cause a huge allocation.
+
+template <typename Key>
+bool SpillTier<Key>::ReadName(std::FILE * pFile, std::uint64_t length, std::string & name)
+{
+    char chunk[4096];
+    while (length > 0)
+    {
+        std::size_t n = (std::size_t)std::min<std::uint64_t>(length, sizeof(chunk));
+        if (std::fread(chunk, 1, n, pFile) != n)
+        {
+            return false;
+        }
+        name.append(chunk, n);
+        length -= n;
+    }
+    return true;
+}
+
+template <typename Key>
+bool SpillTier<Key>::Start(Key const &       key,
+                           void *            pData,
+                           std::size_t       size,
+                           std::atomic<int> * pStatus,
+                           bool              compareCosts)
+{
+    std::string name = m_name(key);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    typename ItemMap::iterator i = m_index.find(name);
+    if (i == m_index.end() || i->second->size != size)
+    {
+        return false;
+    }
+
+    Item & item = *i->second;
+    m_items.splice(m_items.end(), m_items, i->second);
+
+    // An element that has not been written yet is copied from its buffer
+
+    if (item.pBuffer)
+    {
+        std::memcpy(pData, item.pBuffer->data(), size);
+        *pStatus = ElementTier<Key>::EXTRACT_DONE;
+        return true;
+    }
+
+    if (compareCosts)
+    {
+        double spillCost  = m_spillLatency + (double)(m_queuedReadBytes + size) / m_spillBytesPerSecond;
+        double originCost = m_originLatency + (double)size / m_originBytesPerSecond;
+        if (!(spillCost < originCost))
+        {
+            return false;
+        }
+    }
+
+    Job job;
+    job.type    = Job::READ;
+    job.id      = item.id;
+    job.name    = name;
+    job.size    = size;
+    job.pData   = pData;
+    job.pStatus = pStatus;
+    m_reads.push_back(job);
+    m_queuedReadBytes += size;
+
+    lock.unlock();
+    m_wake.notify_one();
+    return true;
+}
+
+template <typename Key>
+void SpillTier<Key>::Erase(typename ItemList::iterator pItem)
+{
+    Job job;
+    job.type    = Job::REMOVE;
+    job.id      = pItem->id;
+    job.size    = 0;
+    job.pData   = 0;
+    job.pStatus = 0;
+    m_jobs.push_back(job);
+
+    m_bytesInUse -= pItem->size;
+    m_index.erase(pItem->name);
+    m_items.erase(pItem);
+}
+
+template <typename Key>
+void SpillTier<Key>::Work()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+        m_wake.wait(lock, [this] { return m_stopping || !m_reads.empty() || !m_jobs.empty(); });
+
+        Job job;
+        if (!m_reads.empty())
+        {
+            job = m_reads.front();
+            m_reads.pop_front();
+            m_queuedReadBytes -= job.size;
+            m_pActiveRead      = job.pData;
+        }
+        else if (!m_jobs.empty())
+        {
+            job = m_jobs.front();
+            m_jobs.pop_front();
+        }
+        else
+        {
+            break;  // Stopping, and there is nothing left to do
+        }
+        m_working = true;
+
+        lock.unlock();
+        bool ok = true;
+        switch (job.type)
+        {
+        case Job::WRITE:    ok = Write(job);   break;
+        case Job::REMOVE:   Remove(job);       break;
+        case Job::READ:     ok = Read(job);    break;
+        }
+        lock.lock();
+
+        // Once an element has been written, its buffer is released. An element that could not be written or read
+        // is removed from the tier. The element may have been removed (or even replaced) in the meantime.
+
+        if (job.type == Job::WRITE)
+        {
+            m_bufferedBytes -= job.size;
+        }
+        if (job.type != Job::REMOVE)
+        {
+            typename ItemMap::iterator i = m_index.find(job.name);
+            if (i != m_index.end() && i->second->id == job.id)
+            {
+                if (!ok)
+                {
+                    Erase(i->second);
+                }
+                else if (job.type == Job::WRITE)
+                {
+                    i->second->pBuffer.reset();
+                }
+            }
+        }
+        if (job.type == Job::READ)
+        {
+            job.pStatus->store(ok ? ElementTier<Key>::EXTRACT_DONE : ElementTier<Key>::EXTRACT_FAILED);
+            m_pActiveRead = 0;
+        }
+
+        m_working = false;
+        m_done.notify_all();
+    }
+}
+
+//! The data is written to a temporary file, which is renamed when it is complete, and then the element is added to
+//! the index. If the process dies in the middle, the temporary file is removed when the tier is next constructed.
+
+template <typename Key>
+bool SpillTier<Key>::Write(Job const & job)
+{
+    std::string tmpPath = PathOf(job.id, ".tmp");
+    std::FILE * pFile   = std::fopen(tmpPath.c_str(), "wb");
+    if (pFile == 0)
+    {
+        return false;
+    }
+
+    bool ok = std::fwrite(job.pBuffer->data(), 1, job.size, pFile) == job.size;
+    ok = (std::fclose(pFile) == 0) && ok;
+    ok = ok && std::rename(tmpPath.c_str(), PathOf(job.id, ".spill").c_str()) == 0;
+    if (!ok)
+    {
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+
+    Log('A', job.id, job.size, job.name);
+    return true;
+}
+
+template <typename Key>
+void SpillTier<Key>::Remove(Job const & job)
+{
+    Log('R', job.id, 0, std::string());
+    std::remove(PathOf(job.id, ".spill").c_str());
+}
+
+template <typename Key>
+bool SpillTier<Key>::Read(Job const & job)
+{
+    std::FILE * pFile = std::fopen(PathOf(job.id, ".spill").c_str(), "rb");
+    if (pFile == 0)
+    {
+        return false;
+    }
+
+    bool ok = std::fread(job.pData, 1, job.size, pFile) == job.size;
+    std::fclose(pFile);
+    return ok;
+}
+
+template <typename Key>
+void SpillTier<Key>::Log(char type, std::uint64_t id, std::size_t size, std::string const & name)
+{
+    std::fwrite(&type, 1, 1, m_pIndexFile);
+    std::fwrite(&id, sizeof(id), 1, m_pIndexFile);
+    if (type == 'A')
+    {
+        std::uint64_t size64   = size;
+        std::uint64_t length64 = name.size();
+        std::fwrite(&size64, sizeof(size64), 1, m_pIndexFile);
+        std::fwrite(&length64, sizeof(length64), 1, m_pIndexFile);
+        std::fwrite(name.data(), 1, name.size(), m_pIndexFile);
+    }
+    std::fflush(m_pIndexFile);
+}
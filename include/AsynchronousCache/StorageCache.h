@@ -0,0 +1,538 @@
+/** @file *//********************************************************************************************************
+
+                                                    StorageCache.h
+
+                                            Copyright 2006, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/AsynchronousCache/StorageCache.h#1 $
+
+    $NoKeywords: $
+
+********************************************************************************************************************/
+
+#pragma once
+
+#include "Arena.h"
+#include "AsynchronousCache.h"
+#include "ElementTier.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+//! A block of storage holding an element of a StorageCache.
+//!
+//! @param	Key         Type of a key for accessing an element in the cache
+
+template <typename Key>
+struct StorageBlock
+{
+    Key key;                    //!< Key of the element in the block
+    void * pMemory;             //!< Address of the element's memory
+    std::size_t size;           //!< Size of the element
+    std::atomic<bool> loaded;   //!< True if the element has been read into the memory
+    std::size_t index;          //!< Index of the block in the cache's list of blocks (used internally)
+    std::size_t compaction;     //!< Index of the block in the cache's compaction order, if any (used internally)
+    void const * pEntry;        //!< The block's entry in the cache (used internally)
+    ElementTier<Key> * pTier;   //!< Tier the element is being extracted from, or nullptr (used internally)
+    std::atomic<int> status;    //!< Status of the extraction from the tier (used internally)
+};
+
+//! Asynchronous Cache with storage provided by an allocator.
+//!
+//! @param	Element     Type of the elements stored in the cache. Elements are stored as raw bytes, so the type must
+//!						be trivially copyable.
+//! @param	Key         Type of a key for accessing an element in the cache
+//! @param	Allocator   Type of the storage allocator (e.g. SlabAllocator)
+//! @param	Tracer      Receives an event on every change of state of an entry. The default is NullTracer.
+//!
+//! @note	This class is an abstract base class and must be derived from in order to be used.
+//!
+//! This class implements the storage half of an AsynchronousCache: Load() allocates memory for the element from
+//! the allocator, Unload() frees it, HasRoomFor() asks the allocator whether there is room, and GetElement()
+//! returns the memory once it has been read. The handle of an element is the address of its StorageBlock.
+//!
+//! When deriving from this class, the following member functions must be overloaded:
+//!		- SizeOf()
+//!		- StartRead()
+//!
+//! The derived class calls ReadCompleted() when the read started by StartRead() is complete. It may also overload
+//! CancelRead().
+//!
+//! The storage may be compacted incrementally: elements are moved to lower addresses so that the free memory
+//! coalesces. Compaction is done in Update() up to a budget set by SetCompactionBudget(), and it can also be done
+//! explicitly by calling Compact(). Elements that are in use (i.e. available) are only moved when Compact() is
+//! called at a safe point. Handles are not affected by compaction. The incremental compaction sweeps the blocks from
+//! the highest address down, resuming where the previous update stopped, and it is skipped while the allocator's
+//! fragmentation is below a threshold, so each update costs a bounded amount of work.
+//!
+//! A secondary tier (e.g. a CompressedTier) may be attached with SetVictimTier(). Loaded elements are offered to
+//! the tier when they are evicted to make room (but not when they are evicted by force or by Clear()), and an
+//! element found in the tier is copied from it instead of being read.
+//!
+//! A spill tier (e.g. a SpillTier) may be attached with SetSpillTier(). It is like the victim tier, but it is
+//! checked after the victim tier, and elements are extracted from it asynchronously. If an extraction fails, the
+//! element is read instead.
+//!
+//! The allocator is not owned by the cache. An allocator must provide these member functions:
+//!		- <tt>void * Allocate(std::size_t size)</tt>
+//!		- <tt>void Free(void * p)</tt>
+//!		- <tt>bool HasRoomFor(std::size_t size) const</tt>
+//!		- <tt>bool FreeingMakesRoomFor(void * p, std::size_t size) const</tt>
+//!		- <tt>void * AllocateBelow(std::size_t size, void * p)</tt>
+//!		- <tt>double GetFragmentation() const</tt> (the fraction of the free memory unusable by the largest
+//!			allocation)
+//!
+//! PlaceOnNode() also requires <tt>GetArena()</tt>, returning an arena with <tt>GetMemory()</tt> and
+//! <tt>GetSize()</tt>, as SlabAllocator and BuddyAllocator do. GetPageSize() and GetPageKind() report the pages
+//! backing the storage if the allocator has functions of the same names (as SlabAllocator and BuddyAllocator do),
+//! so that they can be exported with the cache's metrics.
+
+template <typename Element, typename Key, typename Allocator, typename Tracer = NullTracer>
+class StorageCache : public AsynchronousCache<Element, Key, StorageBlock<Key> *, KeyHash<Key>, Tracer>
+{
+public:
+
+    typedef StorageBlock<Key> Block;    //!< Type of a block of storage
+
+    //! Constructor
+    explicit StorageCache(Allocator & allocator)
+        : m_allocator(allocator),
+        m_compactionBudget(0),
+        m_maxBlocksCompacted(0),
+        m_minFragmentation(0.0),
+        m_compactionCursor(0),
+        m_pVictimTier(0),
+        m_pSpillTier(0)
+    {
+    }
+
+    //! Destructor
+    virtual ~StorageCache();
+
+    //! Returns the allocator
+    Allocator & GetAllocator() const { return m_allocator; }
+
+    //! Sets the limits on the work done by compaction in each Update() (a budget of 0 bytes disables it)
+    void SetCompactionBudget(std::size_t maxBytesPerUpdate,
+                             std::size_t maxBlocksPerUpdate = 64,
+                             double      minFragmentation   = 0.25);
+
+    //! Moves elements to lower addresses to close holes in the storage. Returns the number of bytes moved.
+    std::size_t Compact(std::size_t maxBytes, bool safePoint = false);
+
+    //! Attaches a secondary tier for unloaded elements (or detaches it if @c nullptr). The tier is not owned.
+    void SetVictimTier(ElementTier<Key> * pTier) { m_pVictimTier = pTier; }
+
+    //! Attaches a spill tier for unloaded elements (or detaches it if @c nullptr). The tier is not owned.
+    void SetSpillTier(ElementTier<Key> * pTier) { m_pSpillTier = pTier; }
+
+    //! Asks the system to place the allocator's memory on a NUMA node. Returns false if it could not be bound.
+    template <typename Topology>
+    bool PlaceOnNode(Topology const & topology, std::size_t node);
+
+    //! Returns the size of the pages backing the storage, or 0 if it is not known
+    std::size_t GetPageSize() const;
+
+    //! Returns the kind of pages backing the storage
+    PageKind GetPageKind() const;
+
+protected:
+
+    // ****	Functions to override
+
+    //! Returns the size of an element.
+    //!
+    //! @param	key		Key identifying the element
+    //! @note	This function must be overridden.
+
+    virtual std::size_t SizeOf(Key const & key) override = 0;
+
+    //! Starts reading an element into its block.
+    //!
+    //! The derived class reads the element identified by @c pBlock->key into the @c pBlock->size bytes at
+    //! @c pBlock->pMemory, and calls ReadCompleted() when the read is done. ReadCompleted() may be called before
+    //! this function returns.
+    //!
+    //! @param	pBlock		The block to read the element into
+    //! @note	This function must be overridden.
+
+    virtual void StartRead(Block * pBlock) = 0;
+
+    //! Cancels a read started by StartRead().
+    //!
+    //! This function is called when an element is unloaded before its read has completed. After this function
+    //! returns, the memory is freed and the block is destroyed, so the read must no longer write to it. The default
+    //! implementation does nothing, which is only correct if reads are synchronous.
+    //!
+    //! @param	pBlock		The block being read
+
+    virtual void CancelRead(Block * /* pBlock */) {}
+
+    // ****
+
+    //! Marks a block's element as loaded. This function may be called from any thread (e.g. an I/O completion).
+    void ReadCompleted(Block * pBlock) { pBlock->loaded.store(true, std::memory_order_release); }
+
+    // Overrides AsynchronousCache
+
+    virtual Block * Load(Key const & key) override;
+    virtual void Unload(Block * const & pBlock) override;
+    virtual void Discard(Block * const & pBlock) override;
+    virtual bool HasRoomFor(Key const & key) override;
+    virtual Element * GetElement(Block * const & pBlock) override;
+    virtual bool EvictionMakesRoomFor(Block * const & pVictim, Key const & key) override;
+    virtual void UpdateStorage() override;
+    virtual void SetEntry(Block * const & pBlock, typename StorageCache::EntryRef entry) override;
+
+private:
+
+    // Index of a block that is not in the compaction order
+    static std::size_t const NOT_IN_ORDER = ~(std::size_t)0;
+
+    // Determines whether an allocator reports the pages backing its memory
+    template <typename A, typename = void>
+    struct reports_pages : std::false_type
+    {
+    };
+
+    template <typename A>
+    struct reports_pages<A, decltype(void(std::declval<A const &>().GetPageKind()))> : std::true_type
+    {
+    };
+
+    // Frees a block and its memory, offering a loaded element to the tiers first if requested
+    void FreeBlock(Block * pBlock, bool offer);
+
+    // Moves a block to a lower address if possible. Returns the number of bytes moved.
+    std::size_t Relocate(Block * pBlock, bool safePoint);
+
+    // A functor which returns true if the first block is at a higher address than the second
+    struct higher_address
+    {
+        bool operator ()(Block const * a, Block const * b) const
+        {
+            return std::less<void *>()(b->pMemory, a->pMemory);
+        }
+    };
+
+    Allocator & m_allocator;        // Allocates the storage for the elements
+    std::vector<Block *> m_blocks;  // The blocks in use
+    std::size_t m_compactionBudget; // Maximum number of bytes moved by compaction per update
+    std::size_t m_maxBlocksCompacted;   // Maximum number of blocks examined by compaction per update
+    double m_minFragmentation;          // Fragmentation below which compaction is skipped
+    std::vector<Block *> m_compactionOrder; // Blocks by decreasing address, as of the start of the current sweep
+    std::size_t m_compactionCursor;     // Index of the next block of the sweep to be examined
+    ElementTier<Key> * m_pVictimTier;   // Secondary tier for unloaded elements, or nullptr
+    ElementTier<Key> * m_pSpillTier;    // Spill tier for unloaded elements, or nullptr
+};
+
+template <typename Element, typename Key, typename Allocator, typename Tracer>
+StorageCache<Element, Key, Allocator, Tracer>::~StorageCache()
+{
+    // The derived class has already been destroyed, so the remaining blocks can only be freed here. Any reads in
+    // progress must have been canceled by the derived class (e.g. by calling Clear()).
+
+    for (typename std::vector<Block *>::iterator i = m_blocks.begin(); i != m_blocks.end(); ++i)
+    {
+        m_allocator.Free((*i)->pMemory);
+        delete *i;
+    }
+}
+
+//! This function allocates the element's memory and starts reading the element into it, unless the element can be
+//! extracted from the victim tier or the spill tier. The cache has already checked that there is room for the
+//! element, but if the allocator fails anyway, the load fails.
+//!
+//! @return		The element's block, or nullptr if its memory cannot be allocated
+
+template <typename Element, typename Key, typename Allocator, typename Tracer>
+StorageBlock<Key> * StorageCache<Element, Key, Allocator, Tracer>::Load(Key const & key)
+{
+    std::size_t size    = SizeOf(key);
+    void *      pMemory = m_allocator.Allocate(size);
+    if (pMemory == 0)
+    {
+        return 0;
+    }
+
+    Block * pBlock = new Block;
+    pBlock->key        = key;
+    pBlock->size       = size;
+    pBlock->pMemory    = pMemory;
+    pBlock->loaded.store(false, std::memory_order_relaxed);
+    pBlock->index      = m_blocks.size();
+    pBlock->compaction = NOT_IN_ORDER;
+    pBlock->pEntry     = 0;
+    pBlock->pTier      = 0;
+    pBlock->status     = ElementTier<Key>::EXTRACT_PENDING;
+    m_blocks.push_back(pBlock);
+
+    if (m_pVictimTier != 0 && m_pVictimTier->Extract(key, pBlock->pMemory, pBlock->size))
+    {
+        pBlock->loaded.store(true, std::memory_order_relaxed);
+    }
+    else if (m_pSpillTier != 0 && m_pSpillTier->StartExtract(key, pBlock->pMemory, pBlock->size, &pBlock->status))
+    {
+        pBlock->pTier = m_pSpillTier;
+    }
+    else
+    {
+        StartRead(pBlock);
+    }
+    return pBlock;
+}
+
+//! This function cancels the read or extraction if it is still in progress (or offers the element to the tiers if
+//! it has been loaded), then frees the element's memory and its block.
+
+template <typename Element, typename Key, typename Allocator, typename Tracer>
+void StorageCache<Element, Key, Allocator, Tracer>::Unload(Block * const & pBlock)
+{
+    FreeBlock(pBlock, true);
+}
+
+//! This function is the same as Unload(), except that the element is not offered to the tiers.
+
+template <typename Element, typename Key, typename Allocator, typename Tracer>
+void StorageCache<Element, Key, Allocator, Tracer>::Discard(Block * const & pBlock)
+{
+    FreeBlock(pBlock, false);
+}
+
+template <typename Element, typename Key, typename Allocator, typename Tracer>
+void StorageCache<Element, Key, Allocator, Tracer>::FreeBlock(Block * pBlock, bool offer)
+{
+    if (!pBlock->loaded.load(std::memory_order_acquire))
+    {
+        if (pBlock->pTier != 0)
+        {
+            pBlock->pTier->CancelExtract(pBlock->pMemory);
+        }
+        else
+        {
+            CancelRead(pBlock);
+        }
+    }
+    else if (offer)
+    {
+        if (m_pVictimTier != 0)
+        {
+            m_pVictimTier->Insert(pBlock->key, pBlock->pMemory, pBlock->size);
+        }
+        if (m_pSpillTier != 0)
+        {
+            m_pSpillTier->Insert(pBlock->key, pBlock->pMemory, pBlock->size);
+        }
+    }
+
+    m_allocator.Free(pBlock->pMemory);
+
+    if (pBlock->compaction != NOT_IN_ORDER)
+    {
+        m_compactionOrder[pBlock->compaction] = 0;
+    }
+
+    // The order of the blocks does not matter, so the last one is moved into the unloaded one's place.
+
+    m_blocks[pBlock->index]        = m_blocks.back();
+    m_blocks[pBlock->index]->index = pBlock->index;
+    m_blocks.pop_back();
+    delete pBlock;
+}
+
+template <typename Element, typename Key, typename Allocator, typename Tracer>
+bool StorageCache<Element, Key, Allocator, Tracer>::HasRoomFor(Key const & key)
+{
+    return m_allocator.HasRoomFor(SizeOf(key));
+}
+
+//! If the element is being extracted from a tier, this function checks whether the extraction is done. If the
+//! extraction failed, the element is read instead.
+
+template <typename Element, typename Key, typename Allocator, typename Tracer>
+Element * StorageCache<Element, Key, Allocator, Tracer>::GetElement(Block * const & pBlock)
+{
+    if (pBlock->pTier != 0)
+    {
+        int status = pBlock->status;
+        if (status != ElementTier<Key>::EXTRACT_PENDING)
+        {
+            pBlock->pTier = 0;
+            if (status == ElementTier<Key>::EXTRACT_DONE)
+            {
+                pBlock->loaded.store(true, std::memory_order_relaxed);
+            }
+            else
+            {
+                StartRead(pBlock);
+            }
+        }
+    }
+
+    return pBlock->loaded.load(std::memory_order_acquire) ? static_cast<Element *>(pBlock->pMemory) : 0;
+}
+
+template <typename Element, typename Key, typename Allocator, typename Tracer>
+bool StorageCache<Element, Key, Allocator, Tracer>::EvictionMakesRoomFor(Block * const & pVictim, Key const & key)
+{
+    return m_allocator.FreeingMakesRoomFor(pVictim->pMemory, SizeOf(key));
+}
+
+//! A ShardedCache in NUMA mode calls this function after creating the shard. The arena is bound with
+//! NumaTopology::BindToNode(), which does not move pages that have already been touched, so it only places the
+//! memory that the allocator has not used yet. The allocator should belong to this cache alone.
+//!
+//! @param	topology	The NUMA topology (a NumaTopology)
+//! @param	node		The node
+
+template <typename Element, typename Key, typename Allocator, typename Tracer>
+template <typename Topology>
+bool StorageCache<Element, Key, Allocator, Tracer>::PlaceOnNode(Topology const & topology, std::size_t node)
+{
+    return topology.BindToNode(m_allocator.GetArena().GetMemory(), m_allocator.GetArena().GetSize(), node);
+}
+
+template <typename Element, typename Key, typename Allocator, typename Tracer>
+std::size_t StorageCache<Element, Key, Allocator, Tracer>::GetPageSize() const
+{
+    if constexpr (reports_pages<Allocator>::value)
+    {
+        return m_allocator.GetPageSize();
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+template <typename Element, typename Key, typename Allocator, typename Tracer>
+PageKind StorageCache<Element, Key, Allocator, Tracer>::GetPageKind() const
+{
+    if constexpr (reports_pages<Allocator>::value)
+    {
+        return m_allocator.GetPageKind();
+    }
+    else
+    {
+        return PAGE_UNKNOWN;
+    }
+}
+
+//! @param	maxBytesPerUpdate	Maximum number of bytes moved in each Update() (0 disables compaction)
+//! @param	maxBlocksPerUpdate	Maximum number of blocks examined in each Update()
+//! @param	minFragmentation	Compaction is skipped while the allocator's fragmentation is below this value
+
+template <typename Element, typename Key, typename Allocator, typename Tracer>
+void StorageCache<Element, Key, Allocator, Tracer>::SetCompactionBudget(std::size_t maxBytesPerUpdate,
+                                                                        std::size_t maxBlocksPerUpdate /* = 64*/,
+                                                                        double      minFragmentation /* = 0.25*/)
+{
+    m_compactionBudget   = maxBytesPerUpdate;
+    m_maxBlocksCompacted = maxBlocksPerUpdate;
+    m_minFragmentation   = minFragmentation;
+}
+
+//! This function moves elements from the top of the storage to free blocks lower down, highest first, until
+//! @a maxBytes have been moved or no more elements can be moved. Elements that are still being read are never
+//! moved, and elements that are in use (available) are only moved at a safe point. Unlike the incremental
+//! compaction done by Update(), it examines every block.
+//!
+//! @param	maxBytes	Maximum number of bytes to move
+//! @param	safePoint	If @c true, the application guarantees that it holds no pointers returned by Get(), so
+//!						available elements may be moved too. Get() must be called again to get their new addresses.
+//!
+//! @return		The number of bytes moved
+
+template <typename Element, typename Key, typename Allocator, typename Tracer>
+std::size_t StorageCache<Element, Key, Allocator, Tracer>::Compact(std::size_t maxBytes, bool safePoint /* = false*/)
+{
+    std::vector<Block *> blocks(m_blocks);
+    std::sort(blocks.begin(), blocks.end(), higher_address());
+
+    std::size_t moved = 0;
+    for (typename std::vector<Block *>::iterator i = blocks.begin(); i != blocks.end() && moved < maxBytes; ++i)
+    {
+        moved += Relocate(*i, safePoint);
+    }
+
+    return moved;
+}
+
+//! Each update examines the next few blocks of a sweep through the blocks from the highest address down. When the
+//! sweep is finished, the next one starts with the blocks in use at that time. Blocks loaded during a sweep wait for
+//! the next one, and blocks unloaded during a sweep are skipped.
+
+template <typename Element, typename Key, typename Allocator, typename Tracer>
+void StorageCache<Element, Key, Allocator, Tracer>::UpdateStorage()
+{
+    if (m_compactionBudget == 0 || m_allocator.GetFragmentation() < m_minFragmentation)
+    {
+        return;
+    }
+
+    if (m_compactionCursor >= m_compactionOrder.size())
+    {
+        for (typename std::vector<Block *>::iterator i = m_compactionOrder.begin(); i != m_compactionOrder.end(); ++i)
+        {
+            if (*i != 0)
+            {
+                (*i)->compaction = NOT_IN_ORDER;
+            }
+        }
+        m_compactionOrder = m_blocks;
+        std::sort(m_compactionOrder.begin(), m_compactionOrder.end(), higher_address());
+        for (std::size_t i = 0; i < m_compactionOrder.size(); ++i)
+        {
+            m_compactionOrder[i]->compaction = i;
+        }
+        m_compactionCursor = 0;
+    }
+
+    std::size_t moved = 0;
+    std::size_t end   = std::min(m_compactionCursor + m_maxBlocksCompacted, m_compactionOrder.size());
+    while (m_compactionCursor < end && moved < m_compactionBudget)
+    {
+        Block * pBlock = m_compactionOrder[m_compactionCursor++];
+        if (pBlock != 0)
+        {
+            moved += Relocate(pBlock, false);
+        }
+    }
+}
+
+//! The entry reference lets the cache check whether the block may be moved in constant time.
+
+template <typename Element, typename Key, typename Allocator, typename Tracer>
+void StorageCache<Element, Key, Allocator, Tracer>::SetEntry(Block * const &                    pBlock,
+                                                             typename StorageCache::EntryRef entry)
+{
+    pBlock->pEntry = entry;
+}
+
+template <typename Element, typename Key, typename Allocator, typename Tracer>
+std::size_t StorageCache<Element, Key, Allocator, Tracer>::Relocate(Block * pBlock, bool safePoint)
+{
+    if (!pBlock->loaded.load(std::memory_order_acquire) || !this->IsRelocatable(pBlock->pEntry, safePoint))
+    {
+        return 0;
+    }
+
+    void * pNew = m_allocator.AllocateBelow(pBlock->size, pBlock->pMemory);
+    if (pNew == 0)
+    {
+        return 0;
+    }
+
+    std::memcpy(pNew, pBlock->pMemory, pBlock->size);
+    m_allocator.Free(pBlock->pMemory);
+    pBlock->pMemory = pNew;
+    this->Relocated(pBlock->pEntry, static_cast<Element *>(pNew));
+    return pBlock->size;
+}
@@ -0,0 +1,228 @@
+/** @file *//********************************************************************************************************
+
+                                                       Tracer.h
+
+                                            Copyright 2006, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/AsynchronousCache/Tracer.h#1 $
+
+    $NoKeywords: $
+
+********************************************************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+//! Events reported to the tracer of an AsynchronousCache
+enum TraceEvent
+{
+    TRACE_FETCH,        //!< An entry was added to the cache by a request or a prefetch
+    TRACE_PROMOTE,      //!< A loaded element became available (or a loaded prefetch was retired)
+    TRACE_RELEASE,      //!< An element was released
+    TRACE_EVICT,        //!< An element was evicted
+    TRACE_RELOAD,       //!< A released element was requested again
+    TRACE_PREFETCH,     //!< An element already in the cache was prefetched and moved to the end of the eviction list
+    TRACE_FAIL          //!< An entry was removed without being loaded, because there was no room for it
+};
+
+//! A tracer that ignores every event.
+//!
+//! This is the default tracer of an AsynchronousCache. Its Trace() function is empty and inline, so the calls to it
+//! and the computation of their arguments compile away entirely. The cache's tracer is declared
+//! <tt>[[no_unique_address]]</tt>, so an empty tracer takes no space either (with compilers that honor it).
+//!
+//! A tracer is any class with this member function, which is called on every change of state of an entry:
+//!		- <tt>template <typename K> void Trace(TraceEvent event, K const & key, std::size_t hash, std::size_t size)</tt>
+//!
+//! The key is the entry's key, @a hash is its hash, and @a size is its size as returned by SizeOf().
+
+struct NullTracer
+{
+    //! Ignores an event
+    template <typename K>
+    void Trace(TraceEvent /* event */, K const & /* key */, std::size_t /* hash */, std::size_t /* size */)
+    {
+    }
+};
+
+//! A tracer that records events in a lock-free ring buffer.
+//!
+//! Each event is recorded as a fixed-size binary TraceRecord with a timestamp, the key's hash (keys themselves are
+//! not recorded), and the element's size. Recording an event takes one atomic increment and a few stores, and any
+//! number of threads may record events at the same time. A single consumer thread drains the buffer with Drain() or
+//! Write(), for example once per second, and the records can be analyzed offline.
+//!
+//! When the buffer is full, the oldest records are overwritten, so tracing never blocks the cache. Records that are
+//! lost this way are counted and reported by GetDropped().
+//!
+//! A cache constructs its tracer with the default capacity, and AsynchronousCache::GetTracer() returns it.
+//!
+//! @note	This class cannot be copied or assigned.
+
+class RingBufferTracer
+{
+public:
+
+    //! A recorded event, as written by Write()
+    struct TraceRecord
+    {
+        std::uint64_t time;     //!< When the event occurred, in nanoseconds since the steady clock's epoch
+        std::uint64_t hash;     //!< Hash of the entry's key
+        std::uint64_t size;     //!< Size of the element
+        std::uint64_t event;    //!< The TraceEvent
+    };
+
+    static std::size_t const DEFAULT_CAPACITY = 65536;  //!< Default number of records in the buffer
+
+    //! Constructor
+    explicit RingBufferTracer(std::size_t capacity = DEFAULT_CAPACITY);
+
+    RingBufferTracer(RingBufferTracer const &) = delete;                // Prevent copying
+    RingBufferTracer & operator =(RingBufferTracer const &) = delete;   // Prevent assignment
+
+    //! Records an event. This function may be called from any thread.
+    template <typename K>
+    void Trace(TraceEvent event, K const & key, std::size_t hash, std::size_t size);
+
+    //! Appends the records written since the last call to @a records. Returns the number of records appended.
+    std::size_t Drain(std::vector<TraceRecord> & records);
+
+    //! Drains the records into a file. Returns false if the file could not be written.
+    bool Write(std::FILE * pFile);
+
+    //! Returns the number of records overwritten before they were drained
+    unsigned long long GetDropped() const { return m_dropped; }
+
+    //! Returns the capacity of the buffer, in records
+    std::size_t GetCapacity() const { return m_mask + 1; }
+
+private:
+
+    // A slot in the buffer. The sequence number is odd while the record is being written, and it is
+    // 2 * (position + 1) once the record at the position has been written (like a seqlock).
+    struct Slot
+    {
+        std::atomic<std::uint64_t> sequence;
+        std::atomic<std::uint64_t> time;
+        std::atomic<std::uint64_t> hash;
+        std::atomic<std::uint64_t> size;
+        std::atomic<std::uint64_t> event;
+    };
+
+    std::unique_ptr<Slot[]> m_slots;        // The buffer
+    std::size_t m_mask;                     // Capacity - 1 (the capacity is a power of two)
+    std::atomic<std::uint64_t> m_head;      // Position of the next record to be written
+    std::uint64_t m_tail;                   // Position of the next record to be drained
+    unsigned long long m_dropped;           // Number of records overwritten before they were drained
+};
+
+//! @param	capacity	Number of records in the buffer. It is rounded up to a power of two.
+
+inline RingBufferTracer::RingBufferTracer(std::size_t capacity)
+    : m_head(0),
+    m_tail(0),
+    m_dropped(0)
+{
+    std::size_t size = 1;
+    while (size < capacity)
+    {
+        size *= 2;
+    }
+    m_slots.reset(new Slot[size]);
+    m_mask = size - 1;
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        m_slots[i].sequence.store(0, std::memory_order_relaxed);
+    }
+}
+
+//! @param	event	The event
+//! @param	key		Key of the entry (not recorded)
+//! @param	hash	Hash of the key
+//! @param	size	Size of the element
+
+template <typename K>
+void RingBufferTracer::Trace(TraceEvent event, K const & /* key */, std::size_t hash, std::size_t size)
+{
+    std::uint64_t time = (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    std::uint64_t position = m_head.fetch_add(1, std::memory_order_relaxed);
+    Slot &        slot     = m_slots[position & m_mask];
+
+    slot.sequence.store(2 * position + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.time.store(time, std::memory_order_relaxed);
+    slot.hash.store(hash, std::memory_order_relaxed);
+    slot.size.store(size, std::memory_order_relaxed);
+    slot.event.store(event, std::memory_order_relaxed);
+    slot.sequence.store(2 * position + 2, std::memory_order_release);
+}
+
+//! Records that are still being written are left for the next call. Only one thread may drain the buffer.
+//!
+//! @param	records		Vector to which the records are appended
+
+inline std::size_t RingBufferTracer::Drain(std::vector<TraceRecord> & records)
+{
+    std::size_t   count = 0;
+    std::uint64_t head  = m_head.load(std::memory_order_acquire);
+
+    // Skip the records that have already been overwritten
+
+    if (head - m_tail > GetCapacity())
+    {
+        m_dropped += head - GetCapacity() - m_tail;
+        m_tail     = head - GetCapacity();
+    }
+
+    for (; m_tail < head; ++m_tail)
+    {
+        Slot const &  slot     = m_slots[m_tail & m_mask];
+        std::uint64_t expected = 2 * m_tail + 2;
+        std::uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence < expected)
+        {
+            break;  // Still being written
+        }
+
+        TraceRecord record;
+        record.time  = slot.time.load(std::memory_order_relaxed);
+        record.hash  = slot.hash.load(std::memory_order_relaxed);
+        record.size  = slot.size.load(std::memory_order_relaxed);
+        record.event = slot.event.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        // If the slot has been (or is being) overwritten by a later record, then this record is lost
+
+        if (sequence != expected || slot.sequence.load(std::memory_order_relaxed) != expected)
+        {
+            ++m_dropped;
+            continue;
+        }
+
+        records.push_back(record);
+        ++count;
+    }
+
+    return count;
+}
+
+//! The records are written in the format of TraceRecord, in the byte order of the machine.
+//!
+//! @param	pFile	The file to write to
+
+inline bool RingBufferTracer::Write(std::FILE * pFile)
+{
+    std::vector<TraceRecord> records;
+    Drain(records);
+    return records.empty() || std::fwrite(records.data(), sizeof(TraceRecord), records.size(), pFile) == records.size();
+}
@@ -0,0 +1,215 @@
+#include "TestCache.h"
+
+#include <AsynchronousCache/AccessTrace.h>
+#include <AsynchronousCache/RecordingCache.h>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+typedef RecordingCache<TestCache> TestRecordingCache;
+
+// Returns the bytes of an int key, as recorded
+std::string KeyBytes(int key)
+{
+    std::string bytes;
+    AccessKeyCodec<int>::Encode(key, bytes);
+    return bytes;
+}
+
+// Reads every record in a trace, rewinding it first
+std::vector<AccessRecord> ReadAll(std::FILE * pFile, bool * pGood = nullptr)
+{
+    std::rewind(pFile);
+    AccessTraceReader         reader(pFile);
+    std::vector<AccessRecord> records;
+    AccessRecord              record;
+    while (reader.Read(record))
+    {
+        records.push_back(record);
+    }
+    if (pGood != nullptr)
+    {
+        *pGood = reader.IsGood();
+    }
+    return records;
+}
+
+// Writes the header of a trace followed by some raw bytes, and leaves the file rewound
+void WriteRaw(std::FILE * pFile, std::string const & bytes)
+{
+    std::fwrite(ACCESS_TRACE_MAGIC, 1, sizeof(ACCESS_TRACE_MAGIC), pFile);
+    std::fwrite(bytes.data(), 1, bytes.size(), pFile);
+    std::rewind(pFile);
+}
+
+} // anonymous namespace
+
+TEST(AccessTrace, RecordingCacheRoundTrip)
+{
+    std::FILE * pFile = std::tmpfile();
+    ASSERT_NE(pFile, nullptr);
+
+    {
+        AccessTraceWriter  writer(pFile);
+        TestRecordingCache cache;
+        cache.SetSize(1, 100);
+        cache.SetTraceWriter(&writer);
+
+        EXPECT_TRUE(cache.Request(1));
+        EXPECT_TRUE(cache.Request(2, std::chrono::steady_clock::now() + std::chrono::seconds(1)));
+        EXPECT_TRUE(cache.Prefetch(3));
+        EXPECT_EQ(cache.Get(1), nullptr);
+        cache.Complete(1);
+        int * pElement = cache.Get(1);
+        ASSERT_NE(pElement, nullptr);
+        cache.Release(pElement);
+        cache.Release(2, true);
+        cache.Update();
+        cache.Clear();
+
+        cache.SetTraceWriter(nullptr);
+        EXPECT_TRUE(writer.IsGood());
+    }
+
+    bool                      good    = false;
+    std::vector<AccessRecord> records = ReadAll(pFile, &good);
+    std::fclose(pFile);
+    EXPECT_TRUE(good);
+
+    ASSERT_EQ(records.size(), 9u);
+
+    AccessOp const ops[] = { ACCESS_REQUEST, ACCESS_REQUEST_DEADLINE, ACCESS_PREFETCH, ACCESS_GET, ACCESS_GET,
+                             ACCESS_RELEASE_POINTER, ACCESS_RELEASE, ACCESS_UPDATE, ACCESS_CLEAR };
+    for (std::size_t i = 0; i < records.size(); ++i)
+    {
+        EXPECT_EQ(records[i].op, ops[i]) << "record " << i;
+        if (i > 0)
+        {
+            EXPECT_GE(records[i].time, records[i - 1].time);
+        }
+    }
+
+    EXPECT_EQ(records[0].key, KeyBytes(1));
+    EXPECT_EQ(records[0].size, 100u);
+    EXPECT_EQ(records[0].flags, (unsigned)AccessRecord::FLAG_RESULT);
+
+    EXPECT_EQ(records[1].key, KeyBytes(2));
+    EXPECT_GT(records[1].deadline, 0u);
+    EXPECT_LE(records[1].deadline, 1000000000u);
+
+    EXPECT_EQ(records[2].key, KeyBytes(3));
+    EXPECT_EQ(records[3].flags, 0u);
+    EXPECT_EQ(records[4].flags, (unsigned)AccessRecord::FLAG_RESULT);
+    EXPECT_EQ(records[5].key, KeyBytes(1));
+    EXPECT_EQ(records[6].key, KeyBytes(2));
+    EXPECT_EQ(records[6].flags, (unsigned)AccessRecord::FLAG_FORCE);
+    EXPECT_TRUE(records[7].key.empty());
+    EXPECT_TRUE(records[8].key.empty());
+}
+
+TEST(AccessTrace, CallsAreNotRecordedWithoutAWriter)
+{
+    std::FILE * pFile = std::tmpfile();
+    ASSERT_NE(pFile, nullptr);
+
+    {
+        AccessTraceWriter  writer(pFile);
+        TestRecordingCache cache;
+        EXPECT_TRUE(cache.Request(1));
+        cache.SetTraceWriter(&writer);
+        EXPECT_TRUE(cache.Request(2));
+        cache.SetTraceWriter(nullptr);
+        EXPECT_TRUE(cache.Request(3));
+    }
+
+    std::vector<AccessRecord> records = ReadAll(pFile);
+    std::fclose(pFile);
+
+    ASSERT_EQ(records.size(), 1u);
+    EXPECT_EQ(records[0].key, KeyBytes(2));
+}
+
+TEST(AccessTrace, BadHeaderIsRejected)
+{
+    std::FILE * pFile = std::tmpfile();
+    ASSERT_NE(pFile, nullptr);
+    std::fputs("NOTATRACE", pFile);
+    std::rewind(pFile);
+
+    AccessTraceReader reader(pFile);
+    AccessRecord      record;
+    EXPECT_FALSE(reader.IsGood());
+    EXPECT_FALSE(reader.Read(record));
+    std::fclose(pFile);
+}
+
+TEST(AccessTrace, CorruptRecordsAreDetected)
+{
+    // An unknown operation
+
+    {
+        std::FILE * pFile = std::tmpfile();
+        ASSERT_NE(pFile, nullptr);
+        WriteRaw(pFile, std::string(1, (char)ACCESS_OP_COUNT) + std::string(2, '\0'));
+
+        AccessTraceReader reader(pFile);
+        AccessRecord      record;
+        EXPECT_FALSE(reader.Read(record));
+        EXPECT_FALSE(reader.IsGood());
+        std::fclose(pFile);
+    }
+
+    // A record cut off in its key
+
+    {
+        std::FILE * pFile = std::tmpfile();
+        ASSERT_NE(pFile, nullptr);
+        std::string bytes;
+        bytes.push_back((char)ACCESS_GET);
+        bytes.push_back(0);     // Time
+        bytes.push_back(0);     // Flags
+        bytes.push_back(4);     // Length of the key
+        bytes.append("ab");     // Only half of the key
+        WriteRaw(pFile, bytes);
+
+        AccessTraceReader reader(pFile);
+        AccessRecord      record;
+        EXPECT_TRUE(reader.IsGood());
+        EXPECT_FALSE(reader.Read(record));
+        EXPECT_FALSE(reader.IsGood());
+        std::fclose(pFile);
+    }
+}
+
+TEST(AccessTrace, HugeKeyLengthFailsWithoutAllocatingIt)
+{
+    std::FILE * pFile = std::tmpfile();
+    ASSERT_NE(pFile, nullptr);
+
+    // A key length of 2^63 - 1, followed by a few bytes of the key
+
+    std::string bytes;
+    bytes.push_back((char)ACCESS_GET);
+    bytes.push_back(0);
+    bytes.push_back(0);
+    for (int i = 0; i < 8; ++i)
+    {
+        bytes.push_back((char)0xff);
+    }
+    bytes.push_back(0x7f);
+    bytes.append("key");
+    WriteRaw(pFile, bytes);
+
+    AccessTraceReader reader(pFile);
+    AccessRecord      record;
+    EXPECT_FALSE(reader.Read(record));
+    EXPECT_FALSE(reader.IsGood());
+    std::fclose(pFile);
+}
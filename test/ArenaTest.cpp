@@ -0,0 +1,108 @@
+#include "TestStorageCache.h"
+
+#include <AsynchronousCache/Arena.h>
+#include <AsynchronousCache/BuddyAllocator.h>
+#include <AsynchronousCache/SlabAllocator.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <vector>
+
+namespace
+{
+
+// An allocator that gets each block from the heap and does not report its pages
+struct PlainAllocator
+{
+    void * Allocate(std::size_t size) { return ::operator new(size); }
+    void Free(void * p) { ::operator delete(p); }
+    bool HasRoomFor(std::size_t /* size */) const { return true; }
+    bool FreeingMakesRoomFor(void * /* p */, std::size_t /* size */) const { return true; }
+    void * AllocateBelow(std::size_t /* size */, void * /* p */) { return 0; }
+    double GetFragmentation() const { return 0.0; }
+};
+
+} // anonymous namespace
+
+TEST(Arena, HeapArenaIsUsable)
+{
+    HeapArena arena(1000);
+    ASSERT_NE(arena.GetMemory(), nullptr);
+    EXPECT_EQ(arena.GetSize(), 1000u);
+    std::memset(arena.GetMemory(), 0xff, arena.GetSize());
+    EXPECT_EQ(arena.GetPageSize(), 0u);
+    EXPECT_EQ(arena.GetPageKind(), PAGE_UNKNOWN);
+}
+
+TEST(Arena, HugePageArenaIsUsableAndAligned)
+{
+    std::size_t const size = 3 * 1024 * 1024 + 1;
+    HugePageArena arena(size);
+    ASSERT_NE(arena.GetMemory(), nullptr);
+    EXPECT_EQ(arena.GetSize(), size);
+    std::memset(arena.GetMemory(), 0xff, arena.GetSize());
+
+#if defined(__linux__)
+    ASSERT_GT(arena.GetPageSize(), 0u);
+    EXPECT_EQ((std::uintptr_t)arena.GetMemory() % arena.GetPageSize(), 0u);
+    EXPECT_NE(arena.GetPageKind(), PAGE_UNKNOWN);
+    EXPECT_EQ(arena.IsHugeTlb(), arena.GetPageKind() == PAGE_HUGE_TLB);
+    if (arena.GetPageKind() == PAGE_HUGE_TLB || arena.GetPageKind() == PAGE_TRANSPARENT_HUGE)
+    {
+        EXPECT_GT(arena.GetPageSize(), 4096u);
+    }
+#endif
+}
+
+TEST(Arena, TinyHugePageArena)
+{
+    HugePageArena arena(1);
+    ASSERT_NE(arena.GetMemory(), nullptr);
+    *static_cast<unsigned char *>(arena.GetMemory()) = 1;
+}
+
+TEST(Arena, AllocatorsUseHugePageArenas)
+{
+    typedef SlabAllocator<HugePageArena> Slab;
+    Slab::SizeClass size = { 256, 4 };
+    Slab slab(std::vector<Slab::SizeClass>({ size }));
+    TestStorageCache<Slab> slabCache(slab, 256);
+    EXPECT_TRUE(slabCache.Request(1));
+    EXPECT_TRUE(slabCache.IsIntact(1, slabCache.Get(1), 256));
+    EXPECT_EQ(slab.GetArena().GetSize(), slab.GetCapacity());
+
+    typedef BuddyAllocator<HugePageArena> Buddy;
+    Buddy buddy(1024 * 1024);
+    TestStorageCache<Buddy> buddyCache(buddy, 10000);
+    EXPECT_TRUE(buddyCache.Request(2));
+    EXPECT_TRUE(buddyCache.IsIntact(2, buddyCache.Get(2), 10000));
+}
+
+TEST(Arena, StorageCachesReportTheirPages)
+{
+    typedef BuddyAllocator<HugePageArena> Buddy;
+    Buddy                   buddy(1024 * 1024);
+    TestStorageCache<Buddy> buddyCache(buddy, 10000);
+    EXPECT_EQ(buddy.GetPageSize(), buddy.GetArena().GetPageSize());
+    EXPECT_EQ(buddyCache.GetPageSize(), buddy.GetArena().GetPageSize());
+    EXPECT_EQ(buddyCache.GetPageKind(), buddy.GetArena().GetPageKind());
+
+    typedef SlabAllocator<> Slab;
+    Slab::SizeClass        size = { 256, 4 };
+    Slab                   slab(std::vector<Slab::SizeClass>({ size }));
+    TestStorageCache<Slab> slabCache(slab, 256);
+    EXPECT_EQ(slabCache.GetPageSize(), 0u);
+    EXPECT_EQ(slabCache.GetPageKind(), PAGE_UNKNOWN);
+
+    // An allocator need not report its pages
+
+    PlainAllocator                   plain;
+    TestStorageCache<PlainAllocator> plainCache(plain, 100);
+    EXPECT_TRUE(plainCache.Request(1));
+    EXPECT_TRUE(plainCache.IsIntact(1, plainCache.Get(1), 100));
+    EXPECT_EQ(plainCache.GetPageSize(), 0u);
+    EXPECT_EQ(plainCache.GetPageKind(), PAGE_UNKNOWN);
+}
@@ -0,0 +1,163 @@
+#include "TestStorageCache.h"
+
+#include <AsynchronousCache/BuddyAllocator.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <functional>
+
+namespace
+{
+
+typedef BuddyAllocator<> Allocator;
+
+std::size_t const KB = 1024;
+
+bool IsBelow(void * a, void * b)
+{
+    return std::less<void *>()(a, b);
+}
+
+} // anonymous namespace
+
+TEST(BuddyAllocator, RoundsAllocationsUpToAPowerOfTwo)
+{
+    Allocator allocator(64 * KB);
+    EXPECT_EQ(allocator.GetCapacity(), 64 * KB);
+    EXPECT_EQ(allocator.GetLargestFreeBlock(), 64 * KB);
+
+    void * p = allocator.Allocate(1);
+    ASSERT_NE(p, nullptr);
+    EXPECT_EQ(allocator.GetBytesInUse(), 4 * KB);
+    EXPECT_EQ(allocator.GetLargestFreeBlock(), 32 * KB);
+
+    void * q = allocator.Allocate(5 * KB);
+    ASSERT_NE(q, nullptr);
+    EXPECT_EQ(allocator.GetBytesInUse(), 12 * KB);
+
+    EXPECT_FALSE(allocator.HasRoomFor(64 * KB));
+    EXPECT_EQ(allocator.Allocate(64 * KB), nullptr);
+    EXPECT_FALSE(allocator.HasRoomFor(65 * KB));
+}
+
+TEST(BuddyAllocator, FreedBlocksMergeWithTheirBuddies)
+{
+    Allocator allocator(64 * KB);
+    void * blocks[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        blocks[i] = allocator.Allocate(16 * KB);
+        ASSERT_NE(blocks[i], nullptr);
+    }
+    EXPECT_FALSE(allocator.HasRoomFor(1));
+    EXPECT_EQ(allocator.Allocate(1), nullptr);
+    EXPECT_EQ(allocator.GetLargestFreeBlock(), 0u);
+
+    std::sort(blocks, blocks + 4, std::less<void *>());
+
+    // The middle two blocks are not buddies, so they do not merge
+
+    allocator.Free(blocks[1]);
+    allocator.Free(blocks[2]);
+    EXPECT_EQ(allocator.GetLargestFreeBlock(), 16 * KB);
+    EXPECT_FALSE(allocator.HasRoomFor(32 * KB));
+
+    allocator.Free(blocks[0]);
+    EXPECT_EQ(allocator.GetLargestFreeBlock(), 32 * KB);
+
+    allocator.Free(blocks[3]);
+    EXPECT_EQ(allocator.GetLargestFreeBlock(), 64 * KB);
+    EXPECT_EQ(allocator.GetBytesInUse(), 0u);
+}
+
+TEST(BuddyAllocator, FreeingMakesRoomOnlyIfTheBuddiesAreFree)
+{
+    Allocator allocator(64 * KB);
+    void * blocks[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        blocks[i] = allocator.Allocate(16 * KB);
+    }
+    std::sort(blocks, blocks + 4, std::less<void *>());
+
+    allocator.Free(blocks[1]);
+    EXPECT_TRUE(allocator.FreeingMakesRoomFor(blocks[0], 16 * KB));
+    EXPECT_TRUE(allocator.FreeingMakesRoomFor(blocks[0], 32 * KB));
+    EXPECT_FALSE(allocator.FreeingMakesRoomFor(blocks[0], 64 * KB));
+    EXPECT_FALSE(allocator.FreeingMakesRoomFor(blocks[2], 32 * KB));
+}
+
+TEST(BuddyAllocator, AllocatesBelowAnAddress)
+{
+    Allocator allocator(64 * KB);
+    void * blocks[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        blocks[i] = allocator.Allocate(16 * KB);
+    }
+    std::sort(blocks, blocks + 4, std::less<void *>());
+    allocator.Free(blocks[0]);
+    allocator.Free(blocks[2]);
+
+    EXPECT_EQ(allocator.AllocateBelow(16 * KB, blocks[0]), nullptr);
+    EXPECT_EQ(allocator.AllocateBelow(32 * KB, blocks[3]), nullptr);
+
+    // The lowest free block is chosen, and a larger one is split
+
+    void * p = allocator.AllocateBelow(4 * KB, blocks[3]);
+    EXPECT_EQ(p, blocks[0]);
+    void * q = allocator.AllocateBelow(4 * KB, blocks[3]);
+    EXPECT_TRUE(IsBelow(q, blocks[1]));
+    EXPECT_EQ(allocator.GetBytesInUse(), 2 * 16 * KB + 2 * 4 * KB);
+}
+
+TEST(BuddyAllocator, CapacityNeedNotBeAPowerOfTwo)
+{
+    Allocator allocator(3 * 4 * KB + 100);
+    EXPECT_EQ(allocator.GetLargestFreeBlock(), 8 * KB);
+    EXPECT_TRUE(allocator.HasRoomFor(8 * KB));
+    EXPECT_FALSE(allocator.HasRoomFor(12 * KB));
+
+    void * blocks[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        blocks[i] = allocator.Allocate(4 * KB);
+        ASSERT_NE(blocks[i], nullptr);
+    }
+    EXPECT_EQ(allocator.Allocate(1), nullptr);
+
+    for (int i = 0; i < 3; ++i)
+    {
+        allocator.Free(blocks[i]);
+    }
+    EXPECT_EQ(allocator.GetBytesInUse(), 0u);
+    EXPECT_EQ(allocator.GetLargestFreeBlock(), 8 * KB);
+    EXPECT_NE(allocator.Allocate(8 * KB), nullptr);
+    EXPECT_NE(allocator.Allocate(4 * KB), nullptr);
+}
+
+TEST(BuddyAllocator, StorageCacheEvictsVictimsThatMakeRoom)
+{
+    Allocator allocator(64 * KB);
+    TestStorageCache<Allocator> cache(allocator, 16 * KB);
+    cache.SetSize(9, 32 * KB);
+
+    for (int key = 1; key <= 4; ++key)
+    {
+        EXPECT_TRUE(cache.Request(key));
+        EXPECT_NE(cache.Get(key), nullptr);
+    }
+
+    // After 3 is evicted, releasing 1 and 4 frees 32 KB more, but evicting 1 (the least recently released) would
+    // not make room, since its buddy is in use. The cache evicts 4, whose buddy is free, instead.
+
+    cache.Release(3, true);
+    cache.Release(1);
+    cache.Release(4);
+    EXPECT_TRUE(cache.Request(9));
+    EXPECT_TRUE(cache.IsIntact(9, cache.Get(9), 32 * KB));
+    EXPECT_EQ(cache.GetStatistics().evictions, 1u);
+    EXPECT_TRUE(cache.IsCached(1));
+    EXPECT_FALSE(cache.IsCached(4));
+}
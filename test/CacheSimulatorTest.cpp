@@ -0,0 +1,173 @@
+#include "CacheSimulator.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <list>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+
+// Returns a trace of keys, each with its own size
+Trace MakeTrace(std::vector<int> const & keys, std::vector<std::uint64_t> const & sizes)
+{
+    Trace                                          trace = { std::vector<Access>(), 0, 0, 0 };
+    std::unordered_map<std::string, std::uint32_t> ids;
+    for (std::vector<int>::const_iterator pKey = keys.begin(); pKey != keys.end(); ++pKey)
+    {
+        AddAccess(trace, ids, std::to_string(*pKey), sizes[*pKey]);
+    }
+    trace.keyCount = (std::uint32_t)ids.size();
+    return trace;
+}
+
+// Returns the misses of an LRU cache of a single capacity, simulated directly. A missing element is added as the
+// most recently used, and then the least recently used elements are evicted until the rest fit.
+Result NaiveLru(Trace const & trace, std::uint64_t capacity)
+{
+    std::list<Access> lru;      // Most recently used first
+    std::uint64_t     bytesInUse = 0;
+    Result            result     = { 0, 0 };
+    for (std::vector<Access>::const_iterator a = trace.accesses.begin(); a != trace.accesses.end(); ++a)
+    {
+        std::list<Access>::iterator i = lru.begin();
+        while (i != lru.end() && i->id != a->id)
+        {
+            ++i;
+        }
+        if (i == lru.end())
+        {
+            ++result.misses;
+            result.missBytes += (long long)a->size;
+            bytesInUse       += a->size;
+        }
+        else
+        {
+            lru.erase(i);
+        }
+        lru.push_front(*a);
+        while (bytesInUse > capacity)
+        {
+            bytesInUse -= lru.back().size;
+            lru.pop_back();
+        }
+    }
+    return result;
+}
+
+} // anonymous namespace
+
+TEST(CacheSimulator, LruMatchesANaiveLruAtEveryCapacity)
+{
+    // Skewed keys of mixed sizes, some of them larger than the smaller capacities
+
+    std::mt19937                       random(7);
+    std::uniform_int_distribution<int> hot(0, 7);
+    std::uniform_int_distribution<int> cold(0, 63);
+    std::bernoulli_distribution        isHot(0.6);
+    std::uniform_int_distribution<int> size(1, 40);
+    std::vector<std::uint64_t>         sizes;
+    for (int key = 0; key < 64; ++key)
+    {
+        sizes.push_back((std::uint64_t)size(random));
+    }
+    std::vector<int> keys;
+    for (int i = 0; i < 5000; ++i)
+    {
+        keys.push_back(isHot(random) ? hot(random) : cold(random));
+    }
+    Trace trace = MakeTrace(keys, sizes);
+
+    std::vector<std::uint64_t> capacities;
+    for (std::uint64_t capacity = 0; capacity <= 1400; capacity += 25)
+    {
+        capacities.push_back(capacity);
+    }
+    std::vector<Result> results(capacities.size());
+    SimulateLru(trace, capacities, results);
+
+    for (std::size_t c = 0; c < capacities.size(); ++c)
+    {
+        Result expected = NaiveLru(trace, capacities[c]);
+        EXPECT_EQ(results[c].misses, expected.misses) << "capacity " << capacities[c];
+        EXPECT_EQ(results[c].missBytes, expected.missBytes) << "capacity " << capacities[c];
+    }
+}
+
+TEST(CacheSimulator, FifoEvictsInOrderOfInsertion)
+{
+    // At a capacity of 30, A and B fit; C evicts A even though A was just used, so A misses again
+
+    std::vector<std::uint64_t> const sizes    = { 10, 20, 15 };
+    Trace                            trace    = MakeTrace({ 0, 1, 0, 2, 0, 1 }, sizes);
+    std::vector<std::uint64_t>       capacity = { 30 };
+    std::vector<Result>              fifo(1);
+    std::vector<Result>              lru(1);
+    SimulateFifo(trace, capacity, fifo);
+    SimulateLru(trace, capacity, lru);
+
+    EXPECT_EQ(fifo[0].misses, 5);
+    EXPECT_EQ(fifo[0].missBytes, 10 + 20 + 15 + 10 + 20);
+    EXPECT_EQ(lru[0].misses, 4);
+    EXPECT_EQ(lru[0].missBytes, NaiveLru(trace, 30).missBytes);
+}
+
+TEST(CacheSimulator, OptimalMatchesAHandComputedTrace)
+{
+    // A B C A B D A, with room for two unit elements. MIN keeps A and B and does not cache C or D, which are never
+    // used again, so it misses only the first access of each key. LRU and FIFO both miss every access.
+
+    std::vector<std::uint64_t> const sizes      = { 1, 1, 1, 1 };
+    Trace                            trace      = MakeTrace({ 0, 1, 2, 0, 1, 3, 0 }, sizes);
+    std::vector<std::uint64_t>       capacities = { 2, 3 };
+    std::vector<Result>              opt(2);
+    std::vector<Result>              lru(2);
+    std::vector<Result>              fifo(2);
+    std::vector<Result>              cache(2);
+    SimulateOptimal(trace, capacities, opt);
+    SimulateLru(trace, capacities, lru);
+    SimulateFifo(trace, capacities, fifo);
+    SimulateCache(trace, capacities, cache);
+
+    EXPECT_EQ(opt[0].misses, 4);
+    EXPECT_EQ(opt[0].missBytes, 4);
+    EXPECT_EQ(lru[0].misses, 7);
+    EXPECT_EQ(fifo[0].misses, 7);
+
+    // With room for three, LRU evicts C for D, but FIFO evicts A and misses it again
+
+    EXPECT_EQ(opt[1].misses, 4);
+    EXPECT_EQ(lru[1].misses, 4);
+    EXPECT_EQ(fifo[1].misses, 5);
+
+    // MIN is a lower bound, so the headroom of every policy is never negative
+
+    for (std::size_t c = 0; c < capacities.size(); ++c)
+    {
+        EXPECT_LE(opt[c].misses, lru[c].misses);
+        EXPECT_LE(lru[c].misses, fifo[c].misses);
+        EXPECT_LE(opt[c].misses, cache[c].misses);
+        EXPECT_LE(opt[c].missBytes, cache[c].missBytes);
+    }
+}
+
+TEST(CacheSimulator, OptimalNeverCachesAnElementThatDoesNotFit)
+{
+    // B is larger than the cache, so it always misses, and it does not evict A
+
+    std::vector<std::uint64_t> const sizes      = { 4, 20 };
+    Trace                            trace      = MakeTrace({ 0, 1, 0, 1, 0 }, sizes);
+    std::vector<std::uint64_t>       capacities = { 10 };
+    std::vector<Result>              opt(1);
+    std::vector<Result>              lru(1);
+    SimulateOptimal(trace, capacities, opt);
+    SimulateLru(trace, capacities, lru);
+
+    EXPECT_EQ(opt[0].misses, 3);
+    EXPECT_EQ(opt[0].missBytes, 4 + 20 + 20);
+    EXPECT_EQ(lru[0].misses, 5);
+}
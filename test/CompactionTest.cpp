@@ -0,0 +1,182 @@
+#include "TestStorageCache.h"
+
+#include <AsynchronousCache/BuddyAllocator.h>
+#include <AsynchronousCache/SlabAllocator.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+namespace
+{
+
+std::size_t const KB = 1024;
+
+// A buddy allocator that counts the calls to AllocateBelow()
+class CountingAllocator : public BuddyAllocator<>
+{
+public:
+
+    explicit CountingAllocator(std::size_t capacity) : BuddyAllocator<>(capacity), m_calls(0) {}
+
+    void * AllocateBelow(std::size_t size, void * p)
+    {
+        ++m_calls;
+        return BuddyAllocator<>::AllocateBelow(size, p);
+    }
+
+    std::size_t GetCalls() const { return m_calls; }
+
+private:
+
+    std::size_t m_calls;
+};
+
+// Returns the offset of an element in the allocator's memory
+template <typename Allocator>
+std::size_t OffsetOf(Allocator const & allocator, unsigned char const * pElement)
+{
+    return pElement - static_cast<unsigned char const *>(allocator.GetArena().GetMemory());
+}
+
+} // anonymous namespace
+
+TEST(Compaction, FragmentationIsTheFreeMemoryOutsideTheLargestBlock)
+{
+    BuddyAllocator<> allocator(64 * KB);
+    EXPECT_EQ(allocator.GetFragmentation(), 0.0);
+
+    void * blocks[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        blocks[i] = allocator.Allocate(16 * KB);
+    }
+    EXPECT_EQ(allocator.GetFragmentation(), 0.0);
+
+    std::sort(blocks, blocks + 4, std::less<void *>());
+    allocator.Free(blocks[0]);
+    allocator.Free(blocks[2]);
+    EXPECT_EQ(allocator.GetFragmentation(), 0.5);
+
+    SlabAllocator<>::SizeClass size = { 16, 4 };
+    SlabAllocator<> slab(std::vector<SlabAllocator<>::SizeClass>({ size }));
+    EXPECT_EQ(slab.GetFragmentation(), 0.0);
+}
+
+TEST(Compaction, UpdateMovesReleasedElementsDown)
+{
+    BuddyAllocator<> allocator(64 * KB);
+    TestStorageCache<BuddyAllocator<>> cache(allocator, 16 * KB);
+    for (int key = 1; key <= 4; ++key)
+    {
+        EXPECT_TRUE(cache.Request(key));
+        EXPECT_EQ(OffsetOf(allocator, cache.Get(key)), (key - 1) * 16 * KB);
+    }
+    cache.Release(1, true);
+    cache.Release(3, true);
+    cache.Release(4);
+    EXPECT_EQ(allocator.GetFragmentation(), 0.5);
+
+    cache.SetCompactionBudget(64 * KB);
+    cache.Update();
+    EXPECT_EQ(allocator.GetLargestFreeBlock(), 32 * KB);
+    EXPECT_EQ(allocator.GetFragmentation(), 0.0);
+
+    EXPECT_TRUE(cache.Request(4));
+    EXPECT_EQ(OffsetOf(allocator, cache.Get(4)), 0u);
+    EXPECT_TRUE(cache.IsIntact(4, cache.Get(4), 16 * KB));
+}
+
+TEST(Compaction, ElementsInUseAreOnlyMovedAtASafePoint)
+{
+    BuddyAllocator<> allocator(64 * KB);
+    TestStorageCache<BuddyAllocator<>> cache(allocator, 16 * KB);
+    for (int key = 1; key <= 4; ++key)
+    {
+        EXPECT_TRUE(cache.Request(key));
+        EXPECT_NE(cache.Get(key), nullptr);
+    }
+    cache.Release(1, true);
+    cache.Release(3, true);
+
+    cache.SetCompactionBudget(64 * KB);
+    cache.Update();
+    EXPECT_EQ(OffsetOf(allocator, cache.Get(4)), 48 * KB);
+    EXPECT_EQ(cache.Compact(64 * KB), 0u);
+
+    EXPECT_EQ(cache.Compact(64 * KB, true), 16 * KB);
+    EXPECT_EQ(OffsetOf(allocator, cache.Get(4)), 0u);
+    EXPECT_TRUE(cache.IsIntact(4, cache.Get(4), 16 * KB));
+    EXPECT_EQ(allocator.GetLargestFreeBlock(), 32 * KB);
+}
+
+TEST(Compaction, EachUpdateExaminesABoundedNumberOfBlocks)
+{
+    CountingAllocator allocator(64 * KB);
+    TestStorageCache<CountingAllocator> cache(allocator, 16 * KB);
+    for (int key = 1; key <= 4; ++key)
+    {
+        EXPECT_TRUE(cache.Request(key));
+        EXPECT_NE(cache.Get(key), nullptr);
+    }
+
+    // 2 is released and may be moved to where 1 was. 3 and 4 are in use, and they are examined first.
+
+    cache.Release(1, true);
+    cache.Release(2);
+    cache.SetCompactionBudget(64 * KB, 1, 0.0);
+
+    cache.Update();
+    cache.Update();
+    EXPECT_EQ(allocator.GetCalls(), 0u);
+    cache.Update();
+    EXPECT_EQ(allocator.GetCalls(), 1u);
+
+    EXPECT_TRUE(cache.Request(2));
+    EXPECT_EQ(OffsetOf(allocator, cache.Get(2)), 0u);
+}
+
+TEST(Compaction, BlocksUnloadedDuringASweepAreSkipped)
+{
+    CountingAllocator allocator(64 * KB);
+    TestStorageCache<CountingAllocator> cache(allocator, 16 * KB);
+    for (int key = 1; key <= 4; ++key)
+    {
+        EXPECT_TRUE(cache.Request(key));
+        EXPECT_NE(cache.Get(key), nullptr);
+    }
+    cache.Release(1, true);
+    cache.Release(2);
+    cache.SetCompactionBudget(64 * KB, 1, 0.0);
+
+    cache.Update();
+    cache.Release(3, true);
+    cache.Update();
+    EXPECT_EQ(allocator.GetCalls(), 0u);
+    cache.Update();
+    EXPECT_EQ(allocator.GetCalls(), 1u);
+}
+
+TEST(Compaction, IsSkippedWhileFragmentationIsLow)
+{
+    CountingAllocator allocator(64 * KB);
+    TestStorageCache<CountingAllocator> cache(allocator, 16 * KB);
+    for (int key = 1; key <= 4; ++key)
+    {
+        EXPECT_TRUE(cache.Request(key));
+        EXPECT_NE(cache.Get(key), nullptr);
+    }
+    cache.Release(1, true);
+    cache.Release(2);
+    cache.Release(3);
+    cache.Release(4);
+    cache.SetCompactionBudget(64 * KB);
+
+    for (int i = 0; i < 4; ++i)
+    {
+        cache.Update();
+    }
+    EXPECT_EQ(allocator.GetCalls(), 0u);
+}
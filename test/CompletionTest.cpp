@@ -0,0 +1,121 @@
+#include "TestCache.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+
+// A test cache that reports its completed loads
+class ReportingTestCache : public TestCache
+{
+public:
+
+    // Completes the load of an element and reports it in the next update
+    void Report(int key)
+    {
+        TestLoad * pLoad = Complete(key);
+        if (pLoad != 0)
+        {
+            m_reported.push_back(pLoad);
+        }
+    }
+
+protected:
+
+    virtual bool PollCompletedLoads(std::vector<TestLoad *> & completed) override
+    {
+        completed.insert(completed.end(), m_reported.begin(), m_reported.end());
+        m_reported.clear();
+        return true;
+    }
+
+private:
+
+    std::vector<TestLoad *> m_reported;
+};
+
+} // anonymous namespace
+
+TEST(Completion, UpdatePromotesTheCompletedLoads)
+{
+    TestCache cache;
+    for (int key = 1; key <= 4; ++key)
+    {
+        EXPECT_TRUE(cache.Request(key));
+    }
+    EXPECT_TRUE(cache.Prefetch(5));
+
+    cache.Complete(2);
+    cache.Complete(4);
+    cache.Complete(5);
+
+    std::vector<int> available;
+    cache.Update(available);
+    std::sort(available.begin(), available.end());
+    EXPECT_EQ(available, std::vector<int>({ 2, 4 }));
+    EXPECT_EQ(cache.GetUsage().available, 2u);
+    EXPECT_EQ(cache.GetUsage().requested, 2u);
+    EXPECT_EQ(cache.GetUsage().prefetched, 1u);
+
+    cache.CompleteAll();
+    available.clear();
+    cache.Update(available);
+    std::sort(available.begin(), available.end());
+    EXPECT_EQ(available, std::vector<int>({ 1, 3 }));
+}
+
+TEST(Completion, EachLoadInFlightIsCheckedOncePerUpdate)
+{
+    TestCache cache;
+    cache.SetLazyPromotion(false);
+    for (int key = 1; key <= 8; ++key)
+    {
+        EXPECT_TRUE(cache.Request(key));
+    }
+
+    cache.Complete(3);
+    cache.Complete(8);
+    std::size_t count = cache.GetElementCount();
+    cache.Update();
+    EXPECT_EQ(cache.GetElementCount() - count, 8u);
+
+    count = cache.GetElementCount();
+    cache.Update();
+    EXPECT_EQ(cache.GetElementCount() - count, 6u);
+
+    EXPECT_EQ(*cache.Get(3), 30);
+    EXPECT_EQ(*cache.Get(8), 80);
+    EXPECT_EQ(cache.Get(1), nullptr);
+}
+
+TEST(Completion, OnlyReportedLoadsAreChecked)
+{
+    ReportingTestCache cache;
+    cache.SetLazyPromotion(false);
+    for (int key = 1; key <= 8; ++key)
+    {
+        EXPECT_TRUE(cache.Request(key));
+    }
+
+    cache.Report(5);
+    cache.Report(5);    // Reporting twice is harmless
+    cache.Report(9);    // So is reporting a load that is not in flight
+    std::size_t count = cache.GetElementCount();
+
+    std::vector<int> available;
+    cache.Update(available);
+    EXPECT_EQ(cache.GetElementCount() - count, 1u);
+    EXPECT_EQ(available, std::vector<int>({ 5 }));
+
+    // A released load is no longer in flight
+
+    cache.Release(6);
+    cache.Complete(7);
+    count = cache.GetElementCount();
+    cache.Update();
+    EXPECT_EQ(cache.GetElementCount() - count, 0u);
+    EXPECT_EQ(cache.Get(7), nullptr);
+}
@@ -0,0 +1,171 @@
+#include "TestStorageCache.h"
+
+#include <AsynchronousCache/CompressedTier.h>
+#include <AsynchronousCache/LzCodec.h>
+#include <AsynchronousCache/SlabAllocator.h>
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+namespace
+{
+
+std::vector<unsigned char> Text(std::size_t size)
+{
+    static char const WORDS[] = "the quick brown fox jumps over the lazy dog ";
+    std::vector<unsigned char> data(size);
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        data[i] = (unsigned char)WORDS[i % (sizeof(WORDS) - 1)];
+    }
+    return data;
+}
+
+std::vector<unsigned char> Noise(std::size_t size)
+{
+    std::mt19937 random(1);
+    std::vector<unsigned char> data(size);
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        data[i] = (unsigned char)random();
+    }
+    return data;
+}
+
+bool RoundTrips(std::vector<unsigned char> const & data)
+{
+    std::vector<unsigned char> compressed;
+    LzCodec::Compress(data.data(), data.size(), compressed);
+    std::vector<unsigned char> decompressed(data.size());
+    return LzCodec::Decompress(compressed.data(), compressed.size(), decompressed.data(), decompressed.size()) &&
+           decompressed == data;
+}
+
+typedef SlabAllocator<> Allocator;
+
+} // anonymous namespace
+
+TEST(LzCodec, RoundTrips)
+{
+    EXPECT_TRUE(RoundTrips(std::vector<unsigned char>()));
+    EXPECT_TRUE(RoundTrips(Text(3)));
+    EXPECT_TRUE(RoundTrips(Text(100000)));
+    EXPECT_TRUE(RoundTrips(Noise(100000)));
+    EXPECT_TRUE(RoundTrips(std::vector<unsigned char>(70000, 7)));
+}
+
+TEST(LzCodec, CompressesRepetitiveData)
+{
+    std::vector<unsigned char> data = Text(100000);
+    std::vector<unsigned char> compressed;
+    LzCodec::Compress(data.data(), data.size(), compressed);
+    EXPECT_LT(compressed.size(), data.size() / 10);
+}
+
+TEST(LzCodec, RejectsCorruptData)
+{
+    std::vector<unsigned char> data = Text(1000);
+    std::vector<unsigned char> compressed;
+    LzCodec::Compress(data.data(), data.size(), compressed);
+    std::vector<unsigned char> decompressed(data.size());
+
+    // Wrong size, truncated input, and a match reaching before the start of the output
+
+    EXPECT_FALSE(LzCodec::Decompress(compressed.data(), compressed.size(), decompressed.data(), data.size() - 1));
+    EXPECT_FALSE(LzCodec::Decompress(compressed.data(), compressed.size() / 2, decompressed.data(), data.size()));
+
+    unsigned char bad[] = { 0x10, 'a', 0xff, 0xff };
+    EXPECT_FALSE(LzCodec::Decompress(bad, sizeof(bad), decompressed.data(), decompressed.size()));
+}
+
+TEST(CompressedTier, ExtractsWhatWasInserted)
+{
+    CompressedTier<int> tier(4096);
+    std::vector<unsigned char> text  = Text(1000);
+    std::vector<unsigned char> noise = Noise(1000);
+
+    EXPECT_TRUE(tier.Insert(1, text.data(), text.size()));
+    EXPECT_TRUE(tier.Insert(2, noise.data(), noise.size()));
+    EXPECT_LT(tier.GetBytesInUse(), 2000u);
+    EXPECT_TRUE(tier.Contains(1));
+
+    std::vector<unsigned char> out(1000);
+    EXPECT_TRUE(tier.Extract(1, out.data(), out.size()));
+    EXPECT_EQ(out, text);
+    EXPECT_TRUE(tier.Extract(2, out.data(), out.size()));
+    EXPECT_EQ(out, noise);
+
+    // The tier is exclusive
+
+    EXPECT_FALSE(tier.Contains(1));
+    EXPECT_FALSE(tier.Extract(1, out.data(), out.size()));
+    EXPECT_EQ(tier.GetBytesInUse(), 0u);
+}
+
+TEST(CompressedTier, DiscardsTheOldestElementsToMakeRoom)
+{
+    CompressedTier<int> tier(2500);
+    std::vector<unsigned char> noise = Noise(1000);
+
+    EXPECT_TRUE(tier.Insert(1, noise.data(), noise.size()));
+    EXPECT_TRUE(tier.Insert(2, noise.data(), noise.size()));
+    EXPECT_TRUE(tier.Insert(3, noise.data(), noise.size()));
+    EXPECT_FALSE(tier.Contains(1));
+    EXPECT_TRUE(tier.Contains(2));
+    EXPECT_TRUE(tier.Contains(3));
+
+    std::vector<unsigned char> big = Noise(3000);
+    EXPECT_FALSE(tier.Insert(4, big.data(), big.size()));
+
+    // An element of the wrong size is discarded
+
+    std::vector<unsigned char> out(999);
+    EXPECT_FALSE(tier.Extract(2, out.data(), out.size()));
+    EXPECT_FALSE(tier.Contains(2));
+}
+
+TEST(CompressedTier, EvictedElementsArePromotedFromTheTier)
+{
+    Allocator allocator(SlabClasses(256, 2));
+    CompressedTier<int> tier(4096);
+    TestStorageCache<Allocator> cache(allocator, 256);
+    cache.SetVictimTier(&tier);
+
+    EXPECT_TRUE(cache.Request(1));
+    EXPECT_TRUE(cache.Request(2));
+    EXPECT_NE(cache.Get(1), nullptr);
+    cache.Release(1);
+    EXPECT_TRUE(cache.Request(3));  // Evicts 1 into the tier
+    EXPECT_TRUE(tier.Contains(1));
+    EXPECT_EQ(cache.GetReadCount(), 3u);
+
+    cache.Release(3);
+    EXPECT_TRUE(cache.Request(1));
+    EXPECT_EQ(cache.GetReadCount(), 3u);
+    EXPECT_TRUE(cache.IsIntact(1, cache.Get(1), 256));
+    EXPECT_FALSE(tier.Contains(1));
+    EXPECT_TRUE(tier.Contains(3));
+}
+
+TEST(CompressedTier, ForcedEvictionsAndClearSkipTheTier)
+{
+    Allocator allocator(SlabClasses(256, 2));
+    CompressedTier<int> tier(4096);
+    TestStorageCache<Allocator> cache(allocator, 256);
+    cache.SetVictimTier(&tier);
+
+    EXPECT_TRUE(cache.Request(1));
+    EXPECT_TRUE(cache.Request(2));
+    EXPECT_NE(cache.Get(1), nullptr);
+    EXPECT_NE(cache.Get(2), nullptr);
+
+    cache.Release(1, true);
+    EXPECT_FALSE(tier.Contains(1));
+
+    cache.Clear();
+    EXPECT_FALSE(tier.Contains(2));
+    EXPECT_EQ(tier.GetBytesInUse(), 0u);
+    EXPECT_EQ(allocator.GetBytesInUse(), 0u);
+}
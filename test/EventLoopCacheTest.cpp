@@ -0,0 +1,109 @@
+#include "TestCache.h"
+
+#include <AsynchronousCache/EventLoopCache.h>
+#include <AsynchronousCache/ShardedCache.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <poll.h>
+
+namespace
+{
+
+// A test cache whose loads are notified by the test
+class TestEventLoopCache : public BasicTestCache<EventLoopCache<int, int, TestLoad *>>
+{
+public:
+
+    using EventLoopCache<int, int, TestLoad *>::NotifyLoadCompleted;
+};
+
+bool IsReadable(int fd)
+{
+    pollfd p = { fd, POLLIN, 0 };
+    return poll(&p, 1, 0) == 1 && (p.revents & POLLIN) != 0;
+}
+
+} // anonymous namespace
+
+TEST(EventLoopCache, NotificationsMakeTheDescriptorReadable)
+{
+    TestEventLoopCache cache;
+    cache.SetLazyPromotion(false);
+    EXPECT_TRUE(cache.Request(1));
+    EXPECT_TRUE(cache.Request(2));
+    EXPECT_FALSE(IsReadable(cache.GetCompletionFd()));
+
+    cache.NotifyLoadCompleted(cache.Complete(2));
+    EXPECT_TRUE(IsReadable(cache.GetCompletionFd()));
+
+    std::vector<int> available;
+    EXPECT_EQ(cache.DrainCompletions(available), 1u);
+    EXPECT_EQ(available, std::vector<int>({ 2 }));
+    EXPECT_FALSE(IsReadable(cache.GetCompletionFd()));
+    EXPECT_EQ(*cache.Get(2), 20);
+    EXPECT_EQ(cache.Get(1), nullptr);
+}
+
+TEST(EventLoopCache, AnEarlyNotificationIsCheckedAgain)
+{
+    TestEventLoopCache cache;
+    cache.SetLazyPromotion(false);
+    EXPECT_TRUE(cache.Request(1));
+
+    // The load is notified before its element is ready
+
+    cache.NotifyLoadCompleted(cache.GetLoad(1));
+    std::vector<int> available;
+    EXPECT_EQ(cache.DrainCompletions(available), 0u);
+    EXPECT_TRUE(cache.HasPendingCompletions());
+
+    cache.Complete(1);
+    EXPECT_EQ(cache.DrainCompletions(available), 1u);
+    EXPECT_EQ(available, std::vector<int>({ 1 }));
+    EXPECT_FALSE(cache.HasPendingCompletions());
+}
+
+TEST(EventLoopCache, ShardedCacheDrainsOnlyTheShardsWithCompletions)
+{
+    typedef ShardedCache<TestEventLoopCache> Cache;
+    Cache cache(4, [](std::size_t, std::size_t) {
+        return std::unique_ptr<TestEventLoopCache>(new TestEventLoopCache);
+    });
+    for (std::size_t i = 0; i < cache.GetShardCount(); ++i)
+    {
+        cache.Visit(i, [](TestEventLoopCache & shard) { shard.SetLazyPromotion(false); });
+    }
+
+    for (int key = 0; key < 16; ++key)
+    {
+        EXPECT_TRUE(cache.Request(key));
+    }
+    EXPECT_FALSE(IsReadable(cache.GetCompletionFd()));
+
+    int completed[] = { 3, 7, 11 };
+    for (std::size_t i = 0; i < cache.GetShardCount(); ++i)
+    {
+        cache.Visit(i, [&](TestEventLoopCache & shard) {
+            for (int key : completed)
+            {
+                if (shard.GetLoad(key) != 0)
+                {
+                    shard.NotifyLoadCompleted(shard.Complete(key));
+                }
+            }
+        });
+    }
+    EXPECT_TRUE(IsReadable(cache.GetCompletionFd()));
+
+    std::vector<int> available;
+    EXPECT_EQ(cache.DrainCompletions(available), 3u);
+    std::sort(available.begin(), available.end());
+    EXPECT_EQ(available, std::vector<int>({ 3, 7, 11 }));
+    EXPECT_FALSE(IsReadable(cache.GetCompletionFd()));
+    EXPECT_EQ(*cache.Get(7), 70);
+}
@@ -0,0 +1,108 @@
+#include "TestCache.h"
+
+#include <AsynchronousCache/LatencyHistogram.h>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+
+TEST(LatencyHistogram, SmallValuesAreExact)
+{
+    LatencyHistogram histogram;
+    for (unsigned long long value = 1; value <= 50; ++value)
+    {
+        histogram.Record(value);
+    }
+    EXPECT_EQ(histogram.GetCount(), 50u);
+    EXPECT_EQ(histogram.GetMin(), 1u);
+    EXPECT_EQ(histogram.GetMax(), 50u);
+    EXPECT_DOUBLE_EQ(histogram.GetMean(), 25.5);
+    EXPECT_EQ(histogram.GetPercentile(50.0), 25u);
+    EXPECT_EQ(histogram.GetPercentile(100.0), 50u);
+}
+
+TEST(LatencyHistogram, PercentilesAreNeverTooLowOrTooFarOff)
+{
+    LatencyHistogram histogram;
+    for (unsigned long long value = 1; value <= 100000; ++value)
+    {
+        histogram.Record(value * 1000);
+    }
+
+    unsigned long long p99 = histogram.GetPercentile(99.0);
+    EXPECT_GE(p99, 99000000u);
+    EXPECT_LE(p99, 99000000u + 99000000u / 32);
+    EXPECT_EQ(histogram.GetPercentile(100.0), 100000000u);
+}
+
+TEST(LatencyHistogram, BucketsCoverEveryValue)
+{
+    std::size_t const count = LatencyHistogram::BUCKET_COUNT;
+    EXPECT_EQ(LatencyHistogram::IndexOf(0), 0u);
+    EXPECT_LT(LatencyHistogram::IndexOf(~0ull), count);
+    for (unsigned long long value = 1; value < (1ull << 62); value = value * 3 + 1)
+    {
+        std::size_t index = LatencyHistogram::IndexOf(value);
+        EXPECT_LE(LatencyHistogram::GetLowerBound(index), value);
+        EXPECT_GE(LatencyHistogram::GetUpperBound(index), value);
+    }
+}
+
+TEST(LatencyHistogram, Merge)
+{
+    LatencyHistogram a;
+    LatencyHistogram b;
+    a.Record(10);
+    b.Record(5);
+    b.Record(1000);
+    a.Merge(b);
+    a.Merge(LatencyHistogram());
+    EXPECT_EQ(a.GetCount(), 3u);
+    EXPECT_EQ(a.GetMin(), 5u);
+    EXPECT_EQ(a.GetMax(), 1000u);
+
+    a.Reset();
+    EXPECT_EQ(a.GetCount(), 0u);
+    EXPECT_EQ(a.GetMax(), 0u);
+}
+
+TEST(LatencyHistogram, CacheHistogramsAreDisabledByDefault)
+{
+    TestCache cache;
+    std::size_t overhead = cache.GetUsage().overheadBytes;
+    EXPECT_LT(sizeof(AsynchronousCache<int, int, TestLoad *>), sizeof(LatencyHistogram));
+
+    EXPECT_TRUE(cache.Request(1));
+    cache.Complete(1);
+    cache.Update();
+    EXPECT_EQ(cache.GetRequestLatency().GetCount(), 0u);
+
+    cache.SetLatencyHistograms(true);
+    EXPECT_GT(cache.GetUsage().overheadBytes, overhead + sizeof(LatencyHistogram));
+}
+
+TEST(LatencyHistogram, CacheRecordsLoadTimes)
+{
+    TestCache cache;
+    cache.SetLatencyHistograms(true);
+
+    EXPECT_TRUE(cache.Request(1));
+    EXPECT_TRUE(cache.Prefetch(2));
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    cache.CompleteAll();
+    cache.Update();
+
+    EXPECT_EQ(cache.GetRequestLatency().GetCount(), 1u);
+    EXPECT_GE(cache.GetRequestLatency().GetMin(), 2000000u);
+    EXPECT_EQ(cache.GetPrefetchLatency().GetCount(), 1u);
+
+    cache.ResetStatistics();
+    EXPECT_EQ(cache.GetRequestLatency().GetCount(), 0u);
+
+    cache.SetLatencyHistograms(false);
+    EXPECT_TRUE(cache.Request(3));
+    cache.Complete(3);
+    cache.Update();
+    EXPECT_EQ(cache.GetRequestLatency().GetCount(), 0u);
+}
@@ -0,0 +1,115 @@
+#include "TestCache.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+
+namespace
+{
+
+std::chrono::steady_clock::time_point Soon()
+{
+    return std::chrono::steady_clock::now() + std::chrono::seconds(1);
+}
+
+} // anonymous namespace
+
+TEST(LoadLimits, NoLimitsByDefault)
+{
+    TestCache cache;
+    for (int key = 0; key < 10; ++key)
+    {
+        EXPECT_TRUE(cache.Request(key, Soon()));
+    }
+    EXPECT_EQ(cache.GetLoadCount(), 10u);
+}
+
+TEST(LoadLimits, LoadsBeyondTheLimitAreQueued)
+{
+    TestCache cache;
+    cache.SetLoadLimits(2);
+
+    EXPECT_TRUE(cache.Request(1, Soon()));
+    EXPECT_TRUE(cache.Request(2, Soon()));
+    EXPECT_TRUE(cache.Request(3, Soon()));
+    EXPECT_EQ(cache.GetLoadCount(), 2u);
+    EXPECT_EQ(cache.GetUsage().requested, 3u);
+
+    // A queued load starts when a load in flight completes
+
+    cache.Update();
+    EXPECT_EQ(cache.GetLoadCount(), 2u);
+
+    cache.Complete(1);
+    cache.Update();
+    EXPECT_EQ(cache.GetLoadCount(), 3u);
+    EXPECT_EQ(*cache.Get(1), 10);
+    EXPECT_EQ(cache.Get(3), nullptr);
+}
+
+TEST(LoadLimits, RequestsWithoutDeadlinesAreNeverQueued)
+{
+    TestCache cache;
+    cache.SetLoadLimits(1);
+
+    EXPECT_TRUE(cache.Request(1));
+    EXPECT_TRUE(cache.Request(2));
+    EXPECT_EQ(cache.GetLoadCount(), 2u);
+}
+
+TEST(LoadLimits, RequestingAQueuedElementWithoutADeadlineStartsIt)
+{
+    TestCache cache;
+    cache.SetLoadLimits(1);
+
+    EXPECT_TRUE(cache.Request(1, Soon()));
+    EXPECT_TRUE(cache.Request(2, Soon()));
+    EXPECT_EQ(cache.GetLoadCount(), 1u);
+
+    EXPECT_TRUE(cache.Request(2));
+    EXPECT_EQ(cache.GetLoadCount(), 2u);
+}
+
+TEST(LoadLimits, PrefetchesAreRefusedWhenTheQueueIsFull)
+{
+    TestCache cache;
+    cache.SetLoadLimits(1, 0, 1);
+
+    EXPECT_TRUE(cache.Request(1));
+    EXPECT_TRUE(cache.Prefetch(2));
+    EXPECT_FALSE(cache.Prefetch(3));
+    EXPECT_EQ(cache.GetLoadCount(), 1u);
+    EXPECT_EQ(cache.GetStatistics().prefetches, 1u);
+    EXPECT_EQ(cache.GetStatistics().prefetchFailures, 1u);
+
+    cache.Complete(1);
+    cache.Update();
+    EXPECT_EQ(cache.GetLoadCount(), 2u);
+    EXPECT_TRUE(cache.Prefetch(3));
+}
+
+TEST(LoadLimits, BandwidthIsLimitedByATokenBucket)
+{
+    TestCache cache;
+    for (int key = 1; key <= 3; ++key)
+    {
+        cache.SetSize(key, 100);
+    }
+
+    // The bucket starts with a second's worth of bytes. A load may start as long as the bucket is not empty, so the
+    // second load overdraws it and the third must wait for it to refill.
+
+    cache.SetLoadLimits(0, 150);
+    EXPECT_TRUE(cache.Request(1, Soon()));
+    EXPECT_TRUE(cache.Request(2, Soon()));
+    EXPECT_TRUE(cache.Request(3, Soon()));
+    EXPECT_EQ(cache.GetLoadCount(), 2u);
+
+    cache.Update();
+    EXPECT_EQ(cache.GetLoadCount(), 2u);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    cache.Update();
+    EXPECT_EQ(cache.GetLoadCount(), 3u);
+}
@@ -0,0 +1,175 @@
+#include "TestCache.h"
+
+#include <AsynchronousCache/AsynchronousCache.h>
+#include <AsynchronousCache/MissRatioEstimator.h>
+#include <AsynchronousCache/PrefetchPredictor.h>
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+
+// A key which counts how many times it is constructed from a lookup value
+struct Name
+{
+    explicit Name(std::string_view v) : value(v) { ++constructions; }
+
+    bool operator ==(Name const & other) const { return value == other.value; }
+    bool operator ==(std::string_view other) const { return value == other; }
+
+    std::string value;
+    static int constructions;
+};
+
+int Name::constructions = 0;
+
+// A transparent hash for names
+struct NameHash
+{
+    typedef void is_transparent;
+
+    std::size_t operator ()(Name const & name) const { return std::hash<std::string_view>()(name.value); }
+    std::size_t operator ()(std::string_view name) const { return std::hash<std::string_view>()(name); }
+};
+
+// A move-only key without a std::hash, so every key hashes to 0
+struct Unique
+{
+    explicit Unique(int v) : pValue(new int(v)) {}
+
+    bool operator ==(Unique const & other) const { return *pValue == *other.pValue; }
+
+    std::unique_ptr<int> pValue;
+};
+
+// A key which counts how many times it is compared
+struct Counted
+{
+    explicit Counted(int v) : value(v) {}
+
+    bool operator ==(Counted const & other) const { ++comparisons; return value == other.value; }
+
+    int value;
+    static int comparisons;
+};
+
+int Counted::comparisons = 0;
+
+// A hash for counted keys
+struct CountedHash
+{
+    std::size_t operator ()(Counted const & key) const { return std::hash<int>()(key.value); }
+};
+
+// Returns the element of a key in an ImmediateCache: the length or value of the key
+std::size_t ImmediateValueOf(Name const & key) { return key.value.size(); }
+std::size_t ImmediateValueOf(Unique const & key) { return (std::size_t)*key.pValue; }
+std::size_t ImmediateValueOf(Counted const & key) { return (std::size_t)key.value; }
+
+// An immediate cache whose elements are sized by their values
+template <typename Key, typename Hash>
+class SizedCache : public BasicImmediateCache<Key, std::size_t, Hash>
+{
+public:
+
+    virtual ~SizedCache()
+    {
+        this->Clear();
+    }
+
+protected:
+
+    virtual std::size_t SizeOf(Key const & key) override { return ImmediateValueOf(key); }
+};
+
+// A predictor which records the keys it observes and predicts nothing
+class RecordingPredictor : public PrefetchPredictor<Name>
+{
+public:
+
+    virtual void Observe(Name const & key) override { observed.push_back(key.value); }
+    virtual void Predict(Name const & /* key */, std::vector<Name> & /* predictions */) override {}
+
+    std::vector<std::string> observed;
+};
+
+} // anonymous namespace
+
+TEST(Lookup, KeysAreConstructedOnlyForNewEntries)
+{
+    Name::constructions = 0;
+    SizedCache<Name, NameHash> cache;
+
+    EXPECT_TRUE(cache.Request(std::string_view("alpha")));
+    EXPECT_EQ(Name::constructions, 1);
+
+    EXPECT_TRUE(cache.Request(std::string_view("alpha")));
+    EXPECT_TRUE(cache.Prefetch(std::string_view("alpha")));
+    ASSERT_NE(cache.Get(std::string_view("alpha")), nullptr);
+    EXPECT_EQ(*cache.Get(std::string_view("alpha")), 5u);
+    cache.Release(std::string_view("alpha"));
+    EXPECT_EQ(Name::constructions, 1);
+}
+
+TEST(Lookup, ThePredictorAndEstimatorDoNotConstructKeys)
+{
+    Name::constructions = 0;
+    SizedCache<Name, NameHash> cache;
+    RecordingPredictor predictor;
+    MissRatioEstimator estimator(1.0);
+    cache.SetPredictor(&predictor);
+    cache.SetMissRatioEstimator(&estimator);
+
+    EXPECT_TRUE(cache.Request(std::string_view("alpha")));
+    EXPECT_TRUE(cache.Request(std::string_view("beta")));
+    EXPECT_TRUE(cache.Request(std::string_view("alpha")));
+    EXPECT_EQ(Name::constructions, 2);
+
+    std::vector<std::string> expected = { "alpha", "beta", "alpha" };
+    EXPECT_EQ(predictor.observed, expected);
+    EXPECT_EQ(estimator.GetReferences(), 3u);
+}
+
+TEST(Lookup, MoveOnlyKeysWithCollidingHashes)
+{
+    SizedCache<Unique, KeyHash<Unique>> cache;
+
+    for (int i = 1; i <= 10; ++i)
+    {
+        EXPECT_TRUE(cache.Request(Unique(i)));
+    }
+    for (int i = 1; i <= 10; ++i)
+    {
+        ASSERT_NE(cache.Get(Unique(i)), nullptr);
+        EXPECT_EQ(*cache.Get(Unique(i)), (std::size_t)i);
+    }
+
+    cache.Release(Unique(3), true);
+    EXPECT_EQ(cache.Get(Unique(3)), nullptr);
+    EXPECT_NE(cache.Get(Unique(4)), nullptr);
+    EXPECT_EQ(cache.GetUsage().available, 9u);
+}
+
+TEST(Lookup, KeysAreComparedOnlyWhenTheirHashesMatch)
+{
+    SizedCache<Counted, CountedHash> cache;
+    for (int i = 1; i <= 100; ++i)
+    {
+        EXPECT_TRUE(cache.Request(Counted(i)));
+    }
+
+    Counted::comparisons = 0;
+    ASSERT_NE(cache.Get(Counted(50)), nullptr);
+    EXPECT_EQ(Counted::comparisons, 1);
+
+    Counted::comparisons = 0;
+    EXPECT_EQ(cache.Get(Counted(1000)), nullptr);
+    EXPECT_EQ(Counted::comparisons, 0);
+}
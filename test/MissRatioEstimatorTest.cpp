@@ -0,0 +1,172 @@
+#include <AsynchronousCache/LatencyHistogram.h>
+#include <AsynchronousCache/MissRatioEstimator.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+// Returns the miss ratio of an exact LRU cache holding a number of unit-sized elements
+double ExactMissRatio(std::vector<std::size_t> const & keys, std::size_t capacity)
+{
+    std::list<std::size_t> lru;     // Most recently used first
+    std::size_t            misses = 0;
+    for (std::vector<std::size_t>::const_iterator pKey = keys.begin(); pKey != keys.end(); ++pKey)
+    {
+        std::list<std::size_t>::iterator i = std::find(lru.begin(), lru.end(), *pKey);
+        if (i == lru.end())
+        {
+            ++misses;
+        }
+        else
+        {
+            lru.erase(i);
+        }
+        lru.push_front(*pKey);
+        if (lru.size() > capacity)
+        {
+            lru.pop_back();
+        }
+    }
+    return (double)misses / (double)keys.size();
+}
+
+// Returns a skewed sequence of keys, so that the curve is not a straight line
+std::vector<std::size_t> MakeKeys(std::size_t count, std::size_t distinct)
+{
+    std::mt19937                               random(42);
+    std::uniform_int_distribution<std::size_t> hot(0, distinct / 8);
+    std::uniform_int_distribution<std::size_t> cold(0, distinct - 1);
+    std::bernoulli_distribution                isHot(0.7);
+
+    std::vector<std::size_t> keys;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        keys.push_back(isHot(random) ? hot(random) : cold(random));
+    }
+    return keys;
+}
+
+} // anonymous namespace
+
+TEST(MissRatioEstimator, NothingRecordedMissesEverything)
+{
+    MissRatioEstimator estimator(1.0);
+    EXPECT_EQ(estimator.GetMissRatio(100), 1.0);
+
+    std::vector<MissRatioEstimator::Point> curve;
+    estimator.GetCurve(curve);
+    EXPECT_TRUE(curve.empty());
+}
+
+TEST(MissRatioEstimator, FullRateMatchesExactLru)
+{
+    // At a rate of 1 every key is tracked, so the estimate is exact at the upper bound of each bucket
+
+    std::vector<std::size_t> keys = MakeKeys(20000, 400);
+
+    MissRatioEstimator estimator(1.0);
+    for (std::vector<std::size_t>::const_iterator pKey = keys.begin(); pKey != keys.end(); ++pKey)
+    {
+        if (estimator.Sample(*pKey))
+        {
+            estimator.Record(*pKey, 1);
+        }
+    }
+    EXPECT_EQ(estimator.GetReferences(), keys.size());
+    EXPECT_EQ(estimator.GetSampleCount(), 400u);
+    EXPECT_EQ(estimator.GetRate(), 1.0);
+
+    std::size_t const buckets[] = { 0, 1, 8, 30, 63, 70, 80, 90, 100 };
+    for (std::size_t i = 0; i < sizeof(buckets) / sizeof(buckets[0]); ++i)
+    {
+        std::uint64_t capacity = LatencyHistogram::GetUpperBound(buckets[i]);
+        EXPECT_NEAR(estimator.GetMissRatio(capacity), ExactMissRatio(keys, (std::size_t)capacity), 1e-9)
+            << "capacity " << capacity;
+    }
+
+    // The curve never rises
+
+    std::vector<MissRatioEstimator::Point> curve;
+    estimator.GetCurve(curve);
+    ASSERT_FALSE(curve.empty());
+    for (std::size_t i = 1; i < curve.size(); ++i)
+    {
+        EXPECT_GT(curve[i].capacity, curve[i - 1].capacity);
+        EXPECT_LE(curve[i].missRatio, curve[i - 1].missRatio);
+    }
+    EXPECT_NEAR(curve.back().missRatio, 400.0 / (double)keys.size(), 1e-9);
+}
+
+TEST(MissRatioEstimator, SizesAreCountedInBytes)
+{
+    // Two elements of 10 bytes each, requested alternately, hit in 20 bytes but not in 19
+
+    MissRatioEstimator estimator(1.0);
+    for (int i = 0; i < 100; ++i)
+    {
+        std::size_t key = (std::size_t)(i % 2);
+        if (estimator.Sample(key))
+        {
+            estimator.Record(key, 10);
+        }
+    }
+    EXPECT_NEAR(estimator.GetMissRatio(20), 0.02, 1e-9);
+    EXPECT_EQ(estimator.GetMissRatio(19), 1.0);
+    EXPECT_GT(estimator.GetMarginalUtility(19, 1), 0.0);
+    EXPECT_EQ(estimator.GetMarginalUtility(20, 10), 0.0);
+}
+
+TEST(MissRatioEstimator, TrackedKeysAreBounded)
+{
+    std::vector<std::size_t> keys = MakeKeys(20000, 4000);
+
+    MissRatioEstimator estimator(1.0, 256);
+    for (std::vector<std::size_t>::const_iterator pKey = keys.begin(); pKey != keys.end(); ++pKey)
+    {
+        if (estimator.Sample(*pKey))
+        {
+            estimator.Record(*pKey, 1);
+        }
+    }
+    EXPECT_LE(estimator.GetSampleCount(), 256u);
+    EXPECT_LT(estimator.GetRate(), 1.0);
+
+    // The estimate is approximate, but it is still close to the exact curve
+
+    std::uint64_t capacity = LatencyHistogram::GetUpperBound(100);
+    EXPECT_NEAR(estimator.GetMissRatio(capacity), ExactMissRatio(keys, (std::size_t)capacity), 0.1);
+}
+
+TEST(MissRatioEstimator, ResetClearsTheCounts)
+{
+    MissRatioEstimator estimator(1.0);
+    for (int i = 0; i < 10; ++i)
+    {
+        if (estimator.Sample(1))
+        {
+            estimator.Record(1, 1);
+        }
+    }
+    EXPECT_LT(estimator.GetMissRatio(1), 1.0);
+
+    estimator.Reset();
+    EXPECT_EQ(estimator.GetReferences(), 0u);
+    EXPECT_EQ(estimator.GetMissRatio(1), 1.0);
+    EXPECT_EQ(estimator.GetSampleCount(), 1u);
+
+    // The key is still tracked, so its next request is a hit
+
+    if (estimator.Sample(1))
+    {
+        estimator.Record(1, 1);
+    }
+    EXPECT_EQ(estimator.GetMissRatio(1), 0.0);
+}
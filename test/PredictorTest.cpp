@@ -0,0 +1,91 @@
+#include "TestCache.h"
+
+#include <AsynchronousCache/PrefetchPredictor.h>
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+TEST(MarkovPredictor, PredictsTheMostFrequentSuccessor)
+{
+    MarkovPredictor<int> predictor(16);
+    int sequence[] = { 1, 2, 1, 2, 1, 3 };
+    for (int key : sequence)
+    {
+        predictor.Observe(key);
+    }
+
+    std::vector<int> predictions;
+    predictor.Predict(1, predictions);
+    ASSERT_EQ(predictions.size(), 2u);
+    EXPECT_EQ(predictions[0], 2);
+    EXPECT_EQ(predictions[1], 3);
+
+    predictions.clear();
+    predictor.Predict(4, predictions);
+    EXPECT_TRUE(predictions.empty());
+}
+
+TEST(MarkovPredictor, ForgetsTheLeastRecentlyRequestedKey)
+{
+    MarkovPredictor<int> predictor(2);
+    predictor.Observe(1);
+    predictor.Observe(2);
+    predictor.Observe(3);
+
+    std::vector<int> predictions;
+    predictor.Predict(1, predictions);
+    EXPECT_TRUE(predictions.empty());
+    predictor.Predict(2, predictions);
+    ASSERT_EQ(predictions.size(), 1u);
+    EXPECT_EQ(predictions[0], 3);
+}
+
+TEST(MarkovPredictor, CachePrefetchesThePredictions)
+{
+    MarkovPredictor<int> predictor(16);
+    TestCache cache;
+    cache.SetPredictor(&predictor);
+
+    EXPECT_TRUE(cache.Request(1));
+    EXPECT_TRUE(cache.Request(2));
+    cache.Release(1, true);
+    cache.Release(2, true);
+    EXPECT_EQ(cache.GetStatistics().prefetches, 0u);
+
+    // 2 has followed 1, so requesting 1 prefetches 2
+
+    EXPECT_TRUE(cache.Request(1));
+    EXPECT_EQ(cache.GetStatistics().prefetches, 1u);
+    EXPECT_EQ(cache.GetUsage().prefetched, 1u);
+    EXPECT_EQ(cache.GetLoadCount(), 4u);
+
+    // A prediction that is already in the cache is not prefetched again
+
+    cache.Release(1, true);
+    EXPECT_TRUE(cache.Request(1));
+    EXPECT_EQ(cache.GetStatistics().prefetches, 1u);
+    EXPECT_EQ(cache.GetLoadCount(), 5u);
+}
+
+TEST(MarkovPredictor, PredictedPrefetchesAreLimitedPerUpdate)
+{
+    MarkovPredictor<int> predictor(16);
+    TestCache cache;
+    cache.SetPredictor(&predictor, 1);
+
+    int sequence[] = { 1, 2, 3, 4 };
+    for (int key : sequence)
+    {
+        EXPECT_TRUE(cache.Request(key));
+    }
+    cache.Clear();
+
+    EXPECT_TRUE(cache.Request(1));
+    EXPECT_TRUE(cache.Request(3));
+    EXPECT_EQ(cache.GetStatistics().prefetches, 1u);
+
+    cache.Update();
+    EXPECT_TRUE(cache.Request(3));  // 4 is predicted again, and now there is a budget for it
+    EXPECT_EQ(cache.GetStatistics().prefetches, 2u);
+}
@@ -0,0 +1,167 @@
+#include "TestCache.h"
+#include "TestStorageCache.h"
+
+#include <AsynchronousCache/BuddyAllocator.h>
+#include <AsynchronousCache/PrometheusExporter.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+// Returns true if the text contains a line
+bool HasLine(std::string const & text, std::string const & line)
+{
+    return ("\n" + text).find("\n" + line + "\n") != std::string::npos;
+}
+
+// Returns the number of times a substring appears in the text
+std::size_t CountOf(std::string const & text, std::string const & substring)
+{
+    std::size_t count = 0;
+    for (std::size_t i = text.find(substring); i != std::string::npos; i = text.find(substring, i + 1))
+    {
+        ++count;
+    }
+    return count;
+}
+
+} // anonymous namespace
+
+TEST(PrometheusExporter, RendersUsageAndCounters)
+{
+    TestCache cache;
+    cache.SetSize(1, 100);
+    cache.SetSize(2, 20);
+
+    EXPECT_TRUE(cache.Request(1));
+    EXPECT_TRUE(cache.Prefetch(2));
+    cache.Complete(1);
+    EXPECT_NE(cache.Get(1), nullptr);
+    EXPECT_EQ(cache.Get(3), nullptr);
+
+    PrometheusExporter<TestCache> exporter(cache, "test_cache");
+    std::string                   text;
+    exporter.Render(text);
+
+    EXPECT_TRUE(HasLine(text, "# HELP test_cache_entries Number of entries in each state"));
+    EXPECT_TRUE(HasLine(text, "# TYPE test_cache_entries gauge"));
+    EXPECT_TRUE(HasLine(text, "test_cache_entries{state=\"available\"} 1"));
+    EXPECT_TRUE(HasLine(text, "test_cache_entries{state=\"prefetched\"} 1"));
+    EXPECT_TRUE(HasLine(text, "test_cache_entries{state=\"requested\"} 0"));
+    EXPECT_TRUE(HasLine(text, "test_cache_bytes{state=\"available\"} 100"));
+    EXPECT_TRUE(HasLine(text, "test_cache_bytes{state=\"prefetched\"} 20"));
+    EXPECT_TRUE(HasLine(text, "# TYPE test_cache_get_hits_total counter"));
+    EXPECT_TRUE(HasLine(text, "test_cache_get_hits_total 1"));
+    EXPECT_TRUE(HasLine(text, "test_cache_get_misses_total 1"));
+    EXPECT_TRUE(HasLine(text, "test_cache_request_misses_total 1"));
+    EXPECT_TRUE(HasLine(text, "test_cache_prefetches_total 1"));
+
+    // Each metric has exactly one HELP and TYPE line, and every line ends with a newline
+
+    EXPECT_EQ(CountOf(text, "# TYPE test_cache_entries "), 1u);
+    EXPECT_EQ(CountOf(text, "# HELP test_cache_evictions_total "), 1u);
+    ASSERT_FALSE(text.empty());
+    EXPECT_EQ(text[text.size() - 1], '\n');
+}
+
+TEST(PrometheusExporter, LabelsAreAddedToEverySample)
+{
+    TestCache                     cache;
+    PrometheusExporter<TestCache> exporter(cache, "c", "cache=\"textures\"");
+    std::string                   text;
+    exporter.Render(text);
+
+    EXPECT_TRUE(HasLine(text, "c_entries{cache=\"textures\",state=\"available\"} 0"));
+    EXPECT_TRUE(HasLine(text, "c_evictions_total{cache=\"textures\"} 0"));
+    EXPECT_TRUE(HasLine(text, "c_request_latency_seconds_count{cache=\"textures\"} 0"));
+}
+
+TEST(PrometheusExporter, HistogramBucketsAreCumulative)
+{
+    TestCache cache;
+    cache.SetLatencyHistograms(true);
+    for (int key = 0; key < 3; ++key)
+    {
+        EXPECT_TRUE(cache.Request(key));
+        cache.Complete(key);
+    }
+    cache.Update();
+    ASSERT_EQ(cache.GetRequestLatency().GetCount(), 3u);
+
+    // Every load took less than an hour, and more than a picosecond
+
+    PrometheusExporter<TestCache> exporter(cache, "c");
+    exporter.SetLatencyBounds(std::vector<double>({ 1e-12, 3600.0 }));
+    std::string text;
+    exporter.Render(text);
+
+    EXPECT_TRUE(HasLine(text, "# TYPE c_request_latency_seconds histogram"));
+    EXPECT_TRUE(HasLine(text, "c_request_latency_seconds_bucket{le=\"1e-12\"} 0"));
+    EXPECT_TRUE(HasLine(text, "c_request_latency_seconds_bucket{le=\"3600\"} 3"));
+    EXPECT_TRUE(HasLine(text, "c_request_latency_seconds_bucket{le=\"+Inf\"} 3"));
+    EXPECT_TRUE(HasLine(text, "c_request_latency_seconds_count 3"));
+    EXPECT_TRUE(HasLine(text, "c_prefetch_latency_seconds_count 0"));
+    EXPECT_NE(text.find("c_request_latency_seconds_sum "), std::string::npos);
+}
+
+TEST(PrometheusExporter, PageSizeIsReportedByStorageCaches)
+{
+    typedef BuddyAllocator<HugePageArena> Allocator;
+    Allocator                   allocator(1024 * 1024);
+    TestStorageCache<Allocator> cache(allocator, 1000);
+
+    static char const * const KINDS[] = { "unknown", "normal", "transparent_huge", "huge_tlb" };
+    char                      line[128];
+    std::snprintf(line, sizeof(line), "c_page_size_bytes{pages=\"%s\"} %zu",
+                  KINDS[cache.GetPageKind()], cache.GetPageSize());
+
+    PrometheusExporter<TestStorageCache<Allocator>> exporter(cache, "c");
+    std::string                                     text;
+    exporter.Render(text);
+    EXPECT_TRUE(HasLine(text, "# TYPE c_page_size_bytes gauge"));
+    EXPECT_TRUE(HasLine(text, line));
+
+    // A cache without storage does not report pages
+
+    TestCache                     plain;
+    PrometheusExporter<TestCache> plainExporter(plain, "c");
+    text.clear();
+    plainExporter.Render(text);
+    EXPECT_EQ(text.find("page_size_bytes"), std::string::npos);
+}
+
+TEST(PrometheusExporter, WriteReplacesTheFile)
+{
+    TestCache                     cache;
+    PrometheusExporter<TestCache> exporter(cache);
+
+    std::string path = ::testing::TempDir() + "PrometheusExporterTest.prom";
+    ASSERT_TRUE(exporter.Write(path.c_str()));
+
+    std::FILE * pFile = std::fopen(path.c_str(), "r");
+    ASSERT_NE(pFile, nullptr);
+    std::string text;
+    char        buffer[4096];
+    for (std::size_t n; (n = std::fread(buffer, 1, sizeof(buffer), pFile)) > 0;)
+    {
+        text.append(buffer, n);
+    }
+    std::fclose(pFile);
+    std::remove(path.c_str());
+
+    std::string expected;
+    exporter.Render(expected);
+    EXPECT_EQ(text, expected);
+
+    pFile = std::fopen((path + ".tmp").c_str(), "r");
+    EXPECT_EQ(pFile, nullptr);
+    if (pFile != nullptr)
+    {
+        std::fclose(pFile);
+    }
+}
@@ -0,0 +1,187 @@
+#include "TestCache.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+// Records the events reported by a cache
+struct EventTracer
+{
+    template <typename K>
+    void Trace(TraceEvent event, K const & key, std::size_t /* hash */, std::size_t /* size */)
+    {
+        events.push_back(std::make_pair(event, key));
+    }
+
+    std::vector<std::pair<TraceEvent, int>> events;
+};
+
+std::chrono::steady_clock::time_point In(int seconds)
+{
+    return std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+}
+
+} // anonymous namespace
+
+TEST(Scheduling, QueuedLoadsStartEarliestDeadlineFirst)
+{
+    TestCache cache;
+    cache.SetLoadLimits(1);
+
+    EXPECT_TRUE(cache.Request(0));
+    EXPECT_TRUE(cache.Prefetch(1));
+    EXPECT_TRUE(cache.Request(2, In(30)));
+    EXPECT_TRUE(cache.Request(3, In(10)));
+    EXPECT_TRUE(cache.Request(4, In(20)));
+    EXPECT_TRUE(cache.Request(5, In(20)));
+
+    for (int i = 0; i < 5; ++i)
+    {
+        cache.CompleteAll();
+        cache.Update();
+    }
+
+    // Requests with the same deadline start in the order they were made, and prefetches start after all requests
+
+    std::vector<int> expected = { 0, 3, 4, 5, 2, 1 };
+    EXPECT_EQ(cache.GetLoadOrder(), expected);
+}
+
+TEST(Scheduling, AnEarlierDeadlineMovesARequestUp)
+{
+    TestCache cache;
+    cache.SetLoadLimits(1);
+
+    EXPECT_TRUE(cache.Request(0));
+    EXPECT_TRUE(cache.Request(1, In(10)));
+    EXPECT_TRUE(cache.Request(2, In(20)));
+    EXPECT_TRUE(cache.Request(2, In(5)));
+
+    cache.CompleteAll();
+    cache.Update();
+    ASSERT_EQ(cache.GetLoadCount(), 2u);
+    EXPECT_EQ(cache.GetLoadOrder()[1], 2);
+}
+
+TEST(Scheduling, AQueuedRequestWaitsForRoom)
+{
+    TestCache cache(1);
+    cache.SetLoadLimits(1);
+
+    EXPECT_TRUE(cache.Request(1));
+    EXPECT_TRUE(cache.Request(2, In(10)));
+    cache.Complete(1);
+
+    // There is no room for 2 until 1 is released, so it stays queued and is counted as a failure only once
+
+    cache.Update();
+    cache.Update();
+    EXPECT_EQ(cache.GetLoadCount(), 1u);
+    EXPECT_EQ(cache.GetUsage().requested, 1u);
+    EXPECT_EQ(cache.GetStatistics().requestFailures, 1u);
+    EXPECT_EQ(cache.Get(2), nullptr);
+
+    cache.Release(1);
+    cache.Update();
+    EXPECT_EQ(cache.GetLoadCount(), 2u);
+    cache.Complete(2);
+    cache.Update();
+    ASSERT_NE(cache.Get(2), nullptr);
+    EXPECT_EQ(*cache.Get(2), 20);
+    EXPECT_EQ(cache.GetStatistics().requestFailures, 1u);
+}
+
+TEST(Scheduling, AQueuedPrefetchWithoutRoomIsDropped)
+{
+    TestCache cache(1);
+    cache.SetLoadLimits(1);
+
+    EXPECT_TRUE(cache.Request(1));
+    EXPECT_TRUE(cache.Prefetch(2));
+    cache.Complete(1);
+    cache.Update();
+
+    EXPECT_EQ(cache.GetLoadCount(), 1u);
+    EXPECT_EQ(cache.GetUsage().prefetched, 0u);
+    EXPECT_EQ(cache.GetStatistics().prefetchFailures, 1u);
+    EXPECT_FALSE(cache.IsCached(2));
+
+    // The prefetch does not start when there is room later
+
+    cache.Release(1);
+    cache.Update();
+    EXPECT_EQ(cache.GetLoadCount(), 1u);
+}
+
+TEST(Scheduling, AFailedLoadIsNotTracedAsAnEviction)
+{
+    TracedTestCache<EventTracer> cache(1);
+
+    EXPECT_TRUE(cache.Request(1));
+    EXPECT_FALSE(cache.Request(2));
+    EXPECT_EQ(cache.GetStatistics().requestFailures, 1u);
+    EXPECT_EQ(cache.GetUsage().requested, 1u);
+
+    std::vector<std::pair<TraceEvent, int>> expected = {
+        { TRACE_FETCH, 1 },
+        { TRACE_FETCH, 2 },
+        { TRACE_FAIL, 2 }
+    };
+    EXPECT_EQ(cache.GetTracer().events, expected);
+}
+
+TEST(Scheduling, AQueuedRequestWhoseLoadFailsIsRemoved)
+{
+    TestCache cache;
+    cache.SetLoadLimits(1);
+    cache.SetLoadFails(99);
+
+    EXPECT_TRUE(cache.Request(1));
+    EXPECT_TRUE(cache.Request(99, In(10)));
+    EXPECT_TRUE(cache.Request(2, In(20)));
+    cache.Complete(1);
+
+    // The failed load does not hold up the load queued behind it
+
+    cache.Update();
+    EXPECT_EQ(cache.Get(99), nullptr);
+    EXPECT_EQ(cache.GetStatistics().requestFailures, 1u);
+    EXPECT_EQ(cache.GetLoadOrder(), std::vector<int>({ 1, 2 }));
+    EXPECT_EQ(cache.GetUsage().requested, 1u);
+}
+
+TEST(Scheduling, AQueuedRequestWithoutRoomDoesNotBlockTheQueue)
+{
+    TestCache cache;
+    cache.SetLoadLimits(1);
+    cache.SetNoRoom(99);
+
+    EXPECT_TRUE(cache.Request(1));
+    EXPECT_TRUE(cache.Request(99, In(10)));
+    EXPECT_TRUE(cache.Request(2, In(20)));
+    cache.Complete(1);
+
+    // 1 is still in the cache and could be released to make room, so 99 waits, but 2 starts
+
+    cache.Update();
+    EXPECT_EQ(cache.GetUsage().requested, 2u);
+    EXPECT_EQ(cache.GetLoadOrder(), std::vector<int>({ 1, 2 }));
+    EXPECT_EQ(cache.GetStatistics().requestFailures, 1u);
+
+    // Once nothing else is in the cache, nothing could ever make room for 99, so it is removed
+
+    cache.Release(1, true);
+    cache.Complete(2);
+    cache.Update();
+    EXPECT_EQ(cache.GetUsage().requested, 1u);
+    cache.Release(2, true);
+    cache.Update();
+    EXPECT_EQ(cache.GetUsage().requested, 0u);
+    EXPECT_EQ(cache.GetLoadOrder(), std::vector<int>({ 1, 2 }));
+    EXPECT_EQ(cache.GetStatistics().requestFailures, 1u);
+}
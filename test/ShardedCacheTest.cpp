@@ -0,0 +1,122 @@
+#include "TestCache.h"
+
+#include <AsynchronousCache/ShardedCache.h>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+// An immediate cache which records the node it was placed on
+class PlacedCache : public ImmediateCache
+{
+public:
+
+    PlacedCache()
+        : placedNode(~(std::size_t)0)
+    {
+    }
+
+    // Records the node the cache was placed on
+    bool PlaceOnNode(NumaTopology const & /* topology */, std::size_t node)
+    {
+        placedNode = node;
+        return true;
+    }
+
+    std::size_t placedNode;
+};
+
+typedef ShardedCache<PlacedCache> Cache;
+
+std::unique_ptr<PlacedCache> Create(std::size_t /* shard */, std::size_t /* node */)
+{
+    return std::unique_ptr<PlacedCache>(new PlacedCache);
+}
+
+} // anonymous namespace
+
+TEST(ShardedCache, FactoryExceptionsReachTheConstructingThread)
+{
+    Cache::Factory factory = [](std::size_t shard, std::size_t node) {
+        if (shard == 2)
+        {
+            throw std::runtime_error("factory");
+        }
+        return Create(shard, node);
+    };
+
+    EXPECT_THROW(Cache(4, factory), std::runtime_error);
+    EXPECT_THROW(Cache(4, factory, true), std::runtime_error);
+}
+
+TEST(ShardedCache, NumaShardsArePlacedOnTheirNodes)
+{
+    Cache cache(2, Create, true, [](int const & key) { return key < 10; });
+    EXPECT_EQ(cache.GetShardCount(), 2 * cache.GetNodeCount());
+    for (std::size_t i = 0; i < cache.GetShardCount(); ++i)
+    {
+        cache.Visit(i, [&](PlacedCache & shard) { EXPECT_EQ(shard.placedNode, cache.GetNodeOfShard(i)); });
+    }
+
+    // Replicated and unreplicated keys
+
+    for (int key = 0; key < 20; ++key)
+    {
+        EXPECT_TRUE(cache.Request(key));
+        ASSERT_NE(cache.Get(key), nullptr);
+        EXPECT_EQ(*cache.Get(key), key * 10);
+        cache.Release(cache.Get(key));
+    }
+    EXPECT_EQ(cache.GetUsage().available, 0u);
+}
+
+TEST(ShardedCache, ShardsAreNotPlacedOutsideNumaMode)
+{
+    Cache cache(2, Create);
+    cache.Visit(0, [](PlacedCache & shard) { EXPECT_EQ(shard.placedNode, ~(std::size_t)0); });
+}
+
+TEST(ShardedCache, ConcurrentRequestsGetsAndReleases)
+{
+    Cache cache(4, Create);
+    std::atomic<int> errors(0);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t)
+    {
+        threads.emplace_back([&cache, &errors, t] {
+            for (int i = 0; i < 2000; ++i)
+            {
+                int key = t * 64 + (i * 7) % 64;    // Each thread has its own keys, which share the shards
+                if (!cache.Request(key))
+                {
+                    ++errors;
+                    continue;
+                }
+                int * pElement = cache.Get(key);
+                if (pElement == 0 || *pElement != key * 10)
+                {
+                    ++errors;
+                }
+                cache.Release(key);
+            }
+        });
+    }
+    for (std::vector<std::thread>::iterator i = threads.begin(); i != threads.end(); ++i)
+    {
+        i->join();
+    }
+
+    EXPECT_EQ(errors, 0);
+    Cache::Usage usage = cache.GetUsage();
+    EXPECT_EQ(usage.requested + usage.available, 0u);
+    EXPECT_EQ(cache.GetStatistics().requestMisses + cache.GetStatistics().requestHits +
+              cache.GetStatistics().reloads, 16000u);
+}
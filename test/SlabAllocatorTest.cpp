@@ -0,0 +1,145 @@
+#include "TestStorageCache.h"
+
+#include <AsynchronousCache/SlabAllocator.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+typedef SlabAllocator<> Allocator;
+
+// An allocator that claims to have room even when it does not
+class OptimisticAllocator : public Allocator
+{
+public:
+
+    using Allocator::Allocator;
+
+    bool HasRoomFor(std::size_t /* size */) const { return true; }
+};
+
+} // anonymous namespace
+
+TEST(SlabAllocator, AllocatesFromTheSmallestClassThatFits)
+{
+    Allocator allocator(SlabClasses(64, 1, 16, 2));
+    EXPECT_EQ(allocator.GetCapacity(), 2 * 16u + 64u);
+
+    void * p = allocator.Allocate(10);
+    void * q = allocator.Allocate(16);
+    ASSERT_NE(p, nullptr);
+    ASSERT_NE(q, nullptr);
+    EXPECT_NE(p, q);
+    EXPECT_EQ(allocator.GetBytesInUse(), 32u);
+
+    // An allocation never spills into a larger class
+
+    EXPECT_FALSE(allocator.HasRoomFor(8));
+    EXPECT_EQ(allocator.Allocate(8), nullptr);
+    EXPECT_TRUE(allocator.HasRoomFor(17));
+    EXPECT_NE(allocator.Allocate(17), nullptr);
+    EXPECT_FALSE(allocator.HasRoomFor(17));
+    EXPECT_FALSE(allocator.HasRoomFor(65));
+    EXPECT_EQ(allocator.Allocate(65), nullptr);
+}
+
+TEST(SlabAllocator, FreedSlotsAreReused)
+{
+    Allocator allocator(SlabClasses(64, 1, 16, 2));
+    void * p = allocator.Allocate(16);
+    void * q = allocator.Allocate(16);
+    EXPECT_TRUE(allocator.FreeingMakesRoomFor(p, 16));
+    EXPECT_FALSE(allocator.FreeingMakesRoomFor(p, 64));
+
+    allocator.Free(p);
+    EXPECT_EQ(allocator.GetBytesInUse(), 16u);
+    EXPECT_TRUE(allocator.HasRoomFor(16));
+    EXPECT_EQ(allocator.Allocate(16), p);
+
+    allocator.Free(q);
+    allocator.Free(p);
+    allocator.Free(0);
+    EXPECT_EQ(allocator.GetBytesInUse(), 0u);
+}
+
+TEST(SlabAllocator, SlotsAreAligned)
+{
+    Allocator::SizeClass odd = { 3, 4 };
+    Allocator allocator(std::vector<Allocator::SizeClass>({ odd }));
+    for (int i = 0; i < 4; ++i)
+    {
+        void * p = allocator.Allocate(3);
+        ASSERT_NE(p, nullptr);
+        EXPECT_EQ((std::uintptr_t)p % alignof(std::max_align_t), 0u);
+    }
+    EXPECT_EQ(allocator.Allocate(3), nullptr);
+}
+
+TEST(SlabAllocator, NeverMovesBlocks)
+{
+    Allocator allocator(SlabClasses(64, 1, 16, 2));
+    void * p = allocator.Allocate(64);
+    EXPECT_EQ(allocator.AllocateBelow(64, p), nullptr);
+}
+
+TEST(StorageCache, ReadsElementsIntoTheAllocatorsMemory)
+{
+    Allocator allocator(SlabClasses(64, 1, 16, 2));
+    TestStorageCache<Allocator> cache(allocator, 16);
+
+    EXPECT_TRUE(cache.Request(1));
+    EXPECT_TRUE(cache.Request(2));
+    unsigned char * pElement = cache.Get(1);
+    ASSERT_NE(pElement, nullptr);
+    EXPECT_TRUE(cache.IsIntact(1, pElement, 16));
+    EXPECT_EQ(allocator.GetBytesInUse(), 32u);
+
+    // There is no room for a third element until one is released
+
+    EXPECT_FALSE(cache.Request(3));
+    cache.Release(2);
+    EXPECT_TRUE(cache.Request(3));
+    EXPECT_TRUE(cache.IsIntact(3, cache.Get(3), 16));
+    EXPECT_EQ(allocator.GetBytesInUse(), 32u);
+
+    cache.Clear();
+    EXPECT_EQ(allocator.GetBytesInUse(), 0u);
+}
+
+TEST(StorageCache, ALoadFailsIfTheAllocatorFails)
+{
+    OptimisticAllocator allocator(SlabClasses(64, 1, 16, 2));
+    TestStorageCache<OptimisticAllocator> cache(allocator, 64);
+
+    EXPECT_TRUE(cache.Request(1));
+    EXPECT_FALSE(cache.Request(2));
+    EXPECT_EQ(cache.GetReadCount(), 1u);
+    EXPECT_EQ(cache.GetStatistics().requestFailures, 1u);
+    EXPECT_EQ(cache.GetUsage().requested, 1u);
+    EXPECT_TRUE(cache.IsIntact(1, cache.Get(1), 64));
+    EXPECT_FALSE(cache.IsCached(2));
+}
+
+TEST(StorageCache, ReadsMayCompleteOnAnotherThread)
+{
+    Allocator allocator(SlabClasses(64, 1, 16, 2));
+    TestStorageCache<Allocator> cache(allocator, 64, false);
+    cache.SetLazyPromotion(false);
+
+    EXPECT_TRUE(cache.Request(1));
+    cache.Update();
+    EXPECT_EQ(cache.Get(1), nullptr);
+
+    std::thread reader([&cache] { cache.CompleteReads(); });
+    reader.join();
+
+    std::vector<int> available;
+    cache.Update(available);
+    EXPECT_EQ(available, std::vector<int>({ 1 }));
+    EXPECT_TRUE(cache.IsIntact(1, cache.Get(1), 64));
+}
@@ -0,0 +1,169 @@
+#include "TestCache.h"
+
+#include <AsynchronousCache/ShardedCache.h>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+typedef TestCache::EntrySnapshot Snapshot;
+
+// Requests an element a number of times
+void RequestTimes(TestCache & cache, int key, int times)
+{
+    for (int i = 0; i < times; ++i)
+    {
+        EXPECT_TRUE(cache.Request(key));
+    }
+}
+
+} // anonymous namespace
+
+TEST(Snapshot, EmptyCache)
+{
+    TestCache             cache;
+    std::vector<Snapshot> snapshot(3);
+    cache.GetSnapshot(snapshot);
+    EXPECT_TRUE(snapshot.empty());
+}
+
+TEST(Snapshot, EntriesAreCopiedHottestFirst)
+{
+    TestCache cache;
+    cache.SetSize(2, 200);
+
+    RequestTimes(cache, 1, 1);
+    RequestTimes(cache, 2, 3);
+    RequestTimes(cache, 3, 2);
+    EXPECT_TRUE(cache.Prefetch(4));
+    cache.Complete(2);
+    cache.Complete(3);
+    EXPECT_NE(cache.Get(2), nullptr);
+    EXPECT_NE(cache.Get(3), nullptr);
+    cache.Release(3);
+
+    std::vector<Snapshot> snapshot;
+    cache.GetSnapshot(snapshot);
+    ASSERT_EQ(snapshot.size(), 4u);
+
+    EXPECT_EQ(snapshot[0].key, 2);
+    EXPECT_EQ(snapshot[0].accesses, 3u);
+    EXPECT_EQ(snapshot[0].state, Snapshot::AVAILABLE);
+    EXPECT_EQ(snapshot[0].size, 200u);
+
+    EXPECT_EQ(snapshot[1].key, 3);
+    EXPECT_EQ(snapshot[1].accesses, 2u);
+    EXPECT_EQ(snapshot[1].state, Snapshot::RELEASED);
+
+    EXPECT_EQ(snapshot[2].key, 1);
+    EXPECT_EQ(snapshot[2].state, Snapshot::REQUESTED);
+
+    EXPECT_EQ(snapshot[3].key, 4);
+    EXPECT_EQ(snapshot[3].state, Snapshot::PREFETCHED);
+    EXPECT_EQ(snapshot[3].accesses, 0u);
+
+    for (std::size_t i = 1; i < snapshot.size(); ++i)
+    {
+        EXPECT_FALSE(Snapshot::hotter()(snapshot[i], snapshot[i - 1]));
+    }
+}
+
+TEST(Snapshot, TiesGoToTheYoungerEntry)
+{
+    TestCache cache;
+    RequestTimes(cache, 1, 2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    RequestTimes(cache, 2, 2);
+
+    std::vector<Snapshot> snapshot;
+    cache.GetSnapshot(snapshot);
+    ASSERT_EQ(snapshot.size(), 2u);
+    EXPECT_EQ(snapshot[0].key, 2);
+    EXPECT_EQ(snapshot[1].key, 1);
+    EXPECT_LT(snapshot[0].age, snapshot[1].age);
+}
+
+TEST(Snapshot, OnlyTheHottestFewAreReturned)
+{
+    TestCache cache;
+    for (int key = 0; key < 10; ++key)
+    {
+        RequestTimes(cache, key, key + 1);
+    }
+
+    std::vector<Snapshot> snapshot;
+    cache.GetSnapshot(snapshot, 3);
+    ASSERT_EQ(snapshot.size(), 3u);
+    EXPECT_EQ(snapshot[0].key, 9);
+    EXPECT_EQ(snapshot[1].key, 8);
+    EXPECT_EQ(snapshot[2].key, 7);
+
+    // A limit larger than the cache returns every entry
+
+    cache.GetSnapshot(snapshot, 100);
+    EXPECT_EQ(snapshot.size(), 10u);
+    EXPECT_EQ(snapshot[9].key, 0);
+}
+
+TEST(Snapshot, SnapshotIsACopy)
+{
+    TestCache cache;
+    RequestTimes(cache, 1, 1);
+
+    std::vector<Snapshot> snapshot;
+    cache.GetSnapshot(snapshot);
+    cache.Clear();
+
+    ASSERT_EQ(snapshot.size(), 1u);
+    EXPECT_EQ(snapshot[0].key, 1);
+}
+
+TEST(Snapshot, ShardedSnapshotsAreMergedHottestFirst)
+{
+    ShardedCache<ImmediateCache> cache(4, [](std::size_t, std::size_t) {
+        return std::unique_ptr<ImmediateCache>(new ImmediateCache);
+    });
+    for (int key = 0; key < 32; ++key)
+    {
+        for (int i = 0; i <= key; ++i)
+        {
+            EXPECT_TRUE(cache.Request(key));
+        }
+    }
+
+    std::vector<ShardedCache<ImmediateCache>::EntrySnapshot> snapshot;
+    cache.GetSnapshot(snapshot);
+    ASSERT_EQ(snapshot.size(), 32u);
+    for (std::size_t i = 0; i < snapshot.size(); ++i)
+    {
+        EXPECT_EQ(snapshot[i].key, 31 - (int)i);
+    }
+
+    cache.GetSnapshot(snapshot, 5);
+    ASSERT_EQ(snapshot.size(), 5u);
+    for (std::size_t i = 0; i < snapshot.size(); ++i)
+    {
+        EXPECT_EQ(snapshot[i].key, 31 - (int)i);
+    }
+}
+
+TEST(Snapshot, BackDoorFindsEntries)
+{
+    TestCache cache;
+    RequestTimes(cache, 1, 1);
+    cache.Complete(1);
+    int * pElement = cache.Get(1);
+    ASSERT_NE(pElement, nullptr);
+
+    TestCache::BackDoor backDoor(&cache);
+    EXPECT_EQ(backDoor.Find(1)->key, 1);
+    EXPECT_EQ(backDoor.Find(cache.GetLoad(1))->key, 1);
+    EXPECT_EQ(backDoor.Find(pElement)->key, 1);
+    EXPECT_EQ(backDoor.Find(2), backDoor.GetEntries().end());
+}
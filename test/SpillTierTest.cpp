@@ -0,0 +1,199 @@
+#include "TestStorageCache.h"
+
+#include <AsynchronousCache/SlabAllocator.h>
+#include <AsynchronousCache/SpillTier.h>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+// A spill directory that is removed when the test ends
+class SpillDirectory
+{
+public:
+
+    SpillDirectory()
+        : m_path(std::filesystem::temp_directory_path() /
+                 (std::string("AsynchronousCache-") + ::testing::UnitTest::GetInstance()->current_test_info()->name()))
+    {
+        std::filesystem::remove_all(m_path);
+    }
+
+    ~SpillDirectory()
+    {
+        std::error_code error;
+        std::filesystem::remove_all(m_path, error);
+    }
+
+    std::string GetPath() const { return m_path.string(); }
+
+private:
+
+    std::filesystem::path m_path;
+};
+
+std::string NameOf(int const & key)
+{
+    return std::to_string(key);
+}
+
+std::vector<unsigned char> Element(int key, std::size_t size)
+{
+    return std::vector<unsigned char>(size, (unsigned char)key);
+}
+
+typedef SlabAllocator<> Allocator;
+
+} // anonymous namespace
+
+TEST(SpillTier, ExtractsWhatWasInserted)
+{
+    SpillDirectory directory;
+    SpillTier<int> tier(directory.GetPath(), 4096, NameOf);
+    std::vector<unsigned char> element = Element(1, 1000);
+
+    EXPECT_TRUE(tier.Insert(1, element.data(), element.size()));
+    std::vector<unsigned char> out(1000);
+    EXPECT_TRUE(tier.Extract(1, out.data(), out.size()));   // From the write buffer
+    EXPECT_EQ(out, element);
+
+    tier.Flush();
+    out.assign(1000, 0);
+    EXPECT_TRUE(tier.Extract(1, out.data(), out.size()));   // From the file
+    EXPECT_EQ(out, element);
+
+    // The tier is inclusive, and an element of the wrong size is not extracted
+
+    EXPECT_TRUE(tier.Contains(1));
+    EXPECT_FALSE(tier.Extract(1, out.data(), 999));
+    EXPECT_FALSE(tier.Extract(2, out.data(), out.size()));
+}
+
+TEST(SpillTier, RemovesTheLeastRecentlyUsedElementsToMakeRoom)
+{
+    SpillDirectory directory;
+    SpillTier<int> tier(directory.GetPath(), 2500, NameOf);
+    std::vector<unsigned char> out(1000);
+
+    for (int key = 1; key <= 2; ++key)
+    {
+        std::vector<unsigned char> element = Element(key, 1000);
+        EXPECT_TRUE(tier.Insert(key, element.data(), element.size()));
+    }
+    EXPECT_TRUE(tier.Extract(1, out.data(), out.size()));
+
+    std::vector<unsigned char> element = Element(3, 1000);
+    EXPECT_TRUE(tier.Insert(3, element.data(), element.size()));
+    EXPECT_TRUE(tier.Contains(1));
+    EXPECT_FALSE(tier.Contains(2));
+    EXPECT_TRUE(tier.Contains(3));
+    EXPECT_EQ(tier.GetBytesInUse(), 2000u);
+
+    std::vector<unsigned char> big = Element(4, 3000);
+    EXPECT_FALSE(tier.Insert(4, big.data(), big.size()));
+}
+
+TEST(SpillTier, ElementsSurviveARestart)
+{
+    SpillDirectory directory;
+    {
+        SpillTier<int> tier(directory.GetPath(), 4096, NameOf);
+        for (int key = 1; key <= 3; ++key)
+        {
+            std::vector<unsigned char> element = Element(key, 1000);
+            EXPECT_TRUE(tier.Insert(key, element.data(), element.size()));
+        }
+        tier.Erase(2);
+    }
+
+    SpillTier<int> tier(directory.GetPath(), 4096, NameOf);
+    EXPECT_TRUE(tier.Contains(1));
+    EXPECT_FALSE(tier.Contains(2));
+    EXPECT_TRUE(tier.Contains(3));
+    EXPECT_EQ(tier.GetBytesInUse(), 2000u);
+
+    std::vector<unsigned char> out(1000);
+    EXPECT_TRUE(tier.Extract(3, out.data(), out.size()));
+    EXPECT_EQ(out, Element(3, 1000));
+}
+
+TEST(SpillTier, ACorruptIndexIsIgnored)
+{
+    SpillDirectory directory;
+    std::filesystem::create_directories(directory.GetPath());
+
+    // A record whose name is absurdly long
+
+    std::string indexPath = (std::filesystem::path(directory.GetPath()) / "index").string();
+    std::FILE * pFile     = std::fopen(indexPath.c_str(), "wb");
+    ASSERT_NE(pFile, nullptr);
+    char type            = 'A';
+    std::uint64_t id     = 1;
+    std::uint64_t size   = 1000;
+    std::uint64_t length = std::uint64_t(1) << 60;
+    std::fwrite(&type, 1, 1, pFile);
+    std::fwrite(&id, sizeof(id), 1, pFile);
+    std::fwrite(&size, sizeof(size), 1, pFile);
+    std::fwrite(&length, sizeof(length), 1, pFile);
+    std::fwrite("name", 1, 4, pFile);
+    std::fclose(pFile);
+
+    SpillTier<int> tier(directory.GetPath(), 4096, NameOf);
+    EXPECT_EQ(tier.GetBytesInUse(), 0u);
+}
+
+TEST(SpillTier, EvictedElementsAreReadFromTheTier)
+{
+    SpillDirectory directory;
+    SpillTier<int> tier(directory.GetPath(), 4096, NameOf);
+    Allocator allocator(SlabClasses(256, 2));
+    TestStorageCache<Allocator> cache(allocator, 256);
+    cache.SetSpillTier(&tier);
+
+    EXPECT_TRUE(cache.Request(1));
+    EXPECT_TRUE(cache.Request(2));
+    EXPECT_NE(cache.Get(1), nullptr);
+    cache.Release(1);
+    EXPECT_TRUE(cache.Request(3));  // Evicts 1 into the tier
+    tier.Flush();
+    EXPECT_TRUE(tier.Contains(1));
+
+    cache.Release(3);
+    EXPECT_TRUE(cache.Request(1));
+    unsigned char const * pElement = cache.Get(1);
+    for (int i = 0; pElement == 0 && i < 1000; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        pElement = cache.Get(1);
+    }
+    ASSERT_NE(pElement, nullptr);
+    EXPECT_TRUE(cache.IsIntact(1, pElement, 256));
+    EXPECT_EQ(cache.GetReadCount(), 3u);
+}
+
+TEST(SpillTier, ForcedEvictionsAndClearSkipTheTier)
+{
+    SpillDirectory directory;
+    SpillTier<int> tier(directory.GetPath(), 4096, NameOf);
+    Allocator allocator(SlabClasses(256, 2));
+    TestStorageCache<Allocator> cache(allocator, 256);
+    cache.SetSpillTier(&tier);
+
+    EXPECT_TRUE(cache.Request(1));
+    EXPECT_TRUE(cache.Request(2));
+    EXPECT_NE(cache.Get(1), nullptr);
+    EXPECT_NE(cache.Get(2), nullptr);
+
+    cache.Release(1, true);
+    cache.Clear();
+    EXPECT_EQ(tier.GetBytesInUse(), 0u);
+}
@@ -0,0 +1,69 @@
+#include "TestCache.h"
+
+#include <AsynchronousCache/ShardedCache.h>
+
+#include <gtest/gtest.h>
+
+#include <memory>
+
+TEST(Statistics, CountsTheOutcomesOfOperations)
+{
+    TestCache cache(2);
+
+    EXPECT_TRUE(cache.Request(1));          // Miss
+    EXPECT_TRUE(cache.Request(1));          // Hit
+    EXPECT_EQ(cache.Get(1), nullptr);       // Not loaded yet
+    cache.Complete(1);
+    EXPECT_NE(cache.Get(1), nullptr);
+
+    EXPECT_TRUE(cache.Prefetch(2));
+    cache.Complete(2);
+    EXPECT_TRUE(cache.Request(2));          // Prefetch hit
+
+    cache.Release(1);
+    EXPECT_TRUE(cache.Request(1));          // Reload
+    cache.Release(1);
+
+    EXPECT_TRUE(cache.Request(3));          // Evicts 1
+    EXPECT_FALSE(cache.Request(4));         // No room
+    EXPECT_FALSE(cache.Prefetch(5));        // No room
+
+    TestCache::Statistics const & statistics = cache.GetStatistics();
+    EXPECT_EQ(statistics.getHits, 1u);
+    EXPECT_EQ(statistics.getMisses, 1u);
+    EXPECT_EQ(statistics.requestHits, 1u);
+    EXPECT_EQ(statistics.prefetchHits, 1u);
+    EXPECT_EQ(statistics.reloads, 1u);
+    EXPECT_EQ(statistics.requestMisses, 3u);
+    EXPECT_EQ(statistics.requestFailures, 1u);
+    EXPECT_EQ(statistics.prefetches, 2u);
+    EXPECT_EQ(statistics.prefetchFailures, 1u);
+    EXPECT_EQ(statistics.evictions, 1u);
+
+    cache.ResetStatistics();
+    EXPECT_EQ(cache.GetStatistics().requestMisses, 0u);
+    EXPECT_EQ(cache.GetStatistics().evictions, 0u);
+}
+
+TEST(Statistics, ShardedCacheAddsUpItsShards)
+{
+    typedef ShardedCache<TestCache> Cache;
+    Cache cache(4, [](std::size_t, std::size_t) {
+        return std::unique_ptr<TestCache>(new TestCache);
+    });
+
+    for (int key = 0; key < 16; ++key)
+    {
+        EXPECT_TRUE(cache.Request(key));
+        EXPECT_TRUE(cache.Request(key));
+        EXPECT_EQ(cache.Get(key), nullptr);
+    }
+
+    Cache::Statistics statistics = cache.GetStatistics();
+    EXPECT_EQ(statistics.requestMisses, 16u);
+    EXPECT_EQ(statistics.requestHits, 16u);
+    EXPECT_EQ(statistics.getMisses, 16u);
+
+    cache.ResetStatistics();
+    EXPECT_EQ(cache.GetStatistics().requestMisses, 0u);
+}
@@ -0,0 +1,191 @@
+/** @file *//********************************************************************************************************
+
+                                                     TestCache.h
+
+                                            Copyright 2006, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/AsynchronousCache/test/TestCache.h#1 $
+
+    $NoKeywords: $
+
+********************************************************************************************************************/
+
+#pragma once
+
+#include <AsynchronousCache/AsynchronousCache.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <map>
+#include <set>
+#include <vector>
+
+// A load in the test backend
+struct TestLoad
+{
+    int key;        // Key of the element
+    int element;    // The element (10 times its key)
+    bool loaded;    // True once the load has completed
+};
+
+// A cache of ints whose backend completes loads only when the test says so. The capacity is a number of elements
+// (0 means unlimited). The base is an AsynchronousCache<int, int, TestLoad *> or a class derived from one.
+template <typename Base = AsynchronousCache<int, int, TestLoad *>>
+class BasicTestCache : public Base
+{
+public:
+
+    explicit BasicTestCache(std::size_t capacity = 0)
+        : m_capacity(capacity),
+        m_getElementCount(0)
+    {
+    }
+
+    virtual ~BasicTestCache()
+    {
+        this->Clear();
+    }
+
+    // Completes the load of an element. Returns its handle, or nullptr if it is not being loaded.
+    TestLoad * Complete(int key)
+    {
+        for (typename std::vector<TestLoad *>::iterator i = m_loads.begin(); i != m_loads.end(); ++i)
+        {
+            if ((*i)->key == key && !(*i)->loaded)
+            {
+                (*i)->loaded = true;
+                return *i;
+            }
+        }
+        return 0;
+    }
+
+    // Returns the handle of an element's load, or nullptr if it has not been loaded
+    TestLoad * GetLoad(int key) const
+    {
+        for (typename std::vector<TestLoad *>::const_iterator i = m_loads.begin(); i != m_loads.end(); ++i)
+        {
+            if ((*i)->key == key)
+            {
+                return *i;
+            }
+        }
+        return 0;
+    }
+
+    // Completes every load in progress
+    void CompleteAll()
+    {
+        for (typename std::vector<TestLoad *>::iterator i = m_loads.begin(); i != m_loads.end(); ++i)
+        {
+            (*i)->loaded = true;
+        }
+    }
+
+    // Sets the size of an element, as returned by SizeOf()
+    void SetSize(int key, std::size_t size) { m_sizes[key] = size; }
+
+    // Makes Load() fail for an element
+    void SetLoadFails(int key) { m_loadFails.insert(key); }
+
+    // Makes HasRoomFor() return false for an element
+    void SetNoRoom(int key) { m_noRoom.insert(key); }
+
+    // Returns the number of calls to Load()
+    std::size_t GetLoadCount() const { return m_loadOrder.size(); }
+
+    // Returns the keys passed to Load(), in order
+    std::vector<int> const & GetLoadOrder() const { return m_loadOrder; }
+
+    // Returns the number of calls to GetElement()
+    std::size_t GetElementCount() const { return m_getElementCount; }
+
+    // Returns the number of elements loaded or loading
+    std::size_t GetLoadsInUse() const { return m_loads.size(); }
+
+protected:
+
+    virtual TestLoad * Load(int const & key) override
+    {
+        if (m_loadFails.count(key) > 0)
+        {
+            return 0;
+        }
+
+        TestLoad * pLoad = new TestLoad;
+        pLoad->key     = key;
+        pLoad->element = key * 10;
+        pLoad->loaded  = false;
+        m_loads.push_back(pLoad);
+        m_loadOrder.push_back(key);
+        return pLoad;
+    }
+
+    virtual void Unload(TestLoad * const & pLoad) override
+    {
+        m_loads.erase(std::find(m_loads.begin(), m_loads.end(), pLoad));
+        delete pLoad;
+    }
+
+    virtual bool HasRoomFor(int const & key) override
+    {
+        return m_noRoom.count(key) == 0 && (m_capacity == 0 || m_loads.size() < m_capacity);
+    }
+
+    virtual int * GetElement(TestLoad * const & pLoad) override
+    {
+        ++m_getElementCount;
+        return pLoad->loaded ? &pLoad->element : 0;
+    }
+
+    virtual std::size_t SizeOf(int const & key) override
+    {
+        std::map<int, std::size_t>::const_iterator i = m_sizes.find(key);
+        return (i != m_sizes.end()) ? i->second : 0;
+    }
+
+private:
+
+    std::size_t m_capacity;             // Maximum number of elements (0 means unlimited)
+    std::vector<TestLoad *> m_loads;    // Elements loaded or loading
+    std::map<int, std::size_t> m_sizes; // Sizes of the elements
+    std::set<int> m_loadFails;          // Elements whose loads fail
+    std::set<int> m_noRoom;             // Elements for which there is never room
+    std::vector<int> m_loadOrder;       // Keys passed to Load(), in order
+    std::size_t m_getElementCount;      // Number of calls to GetElement()
+};
+
+typedef BasicTestCache<> TestCache;
+
+// A test cache with a tracer
+template <typename Tracer>
+using TracedTestCache = BasicTestCache<AsynchronousCache<int, int, TestLoad *, KeyHash<int>, Tracer>>;
+
+// Returns the element of an int key in an ImmediateCache
+inline int ImmediateValueOf(int key)
+{
+    return key * 10;
+}
+
+// A cache whose loads complete immediately. The element of a key is ImmediateValueOf(key), which is 10 times an int
+// key. A test with other keys declares an ImmediateValueOf() for them.
+template <typename Key = int, typename Element = int, typename Hash = KeyHash<Key>>
+class BasicImmediateCache : public AsynchronousCache<Element, Key, Element *, Hash>
+{
+public:
+
+    virtual ~BasicImmediateCache()
+    {
+        this->Clear();
+    }
+
+protected:
+
+    virtual Element * Load(Key const & key) override { return new Element(ImmediateValueOf(key)); }
+    virtual void Unload(Element * const & pElement) override { delete pElement; }
+    virtual bool HasRoomFor(Key const & /* key */) override { return true; }
+    virtual Element * GetElement(Element * const & pElement) override { return pElement; }
+};
+
+typedef BasicImmediateCache<> ImmediateCache;
@@ -0,0 +1,127 @@
+/** @file *//********************************************************************************************************
+
+                                                  TestStorageCache.h
+
+                                            Copyright 2006, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/AsynchronousCache/test/TestStorageCache.h#1 $
+
+    $NoKeywords: $
+
+********************************************************************************************************************/
+
+#pragma once
+
+#include <AsynchronousCache/SlabAllocator.h>
+#include <AsynchronousCache/StorageCache.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <map>
+#include <vector>
+
+// A storage cache of byte arrays. Every byte of an element is the low byte of its key. Reads complete immediately,
+// or (if they are asynchronous) when the test says so.
+template <typename Allocator, typename Tracer = NullTracer>
+class TestStorageCache : public StorageCache<unsigned char, int, Allocator, Tracer>
+{
+public:
+
+    typedef StorageCache<unsigned char, int, Allocator, Tracer> Base;
+    typedef typename Base::Block Block;
+
+    TestStorageCache(Allocator & allocator, std::size_t size, bool synchronous = true)
+        : Base(allocator),
+        m_size(size),
+        m_synchronous(synchronous),
+        m_readCount(0)
+    {
+    }
+
+    virtual ~TestStorageCache()
+    {
+        this->Clear();
+    }
+
+    // Completes the reads in progress
+    void CompleteReads()
+    {
+        std::vector<Block *> pending;
+        pending.swap(m_pending);
+        for (typename std::vector<Block *>::iterator i = pending.begin(); i != pending.end(); ++i)
+        {
+            Fill(*i);
+            this->ReadCompleted(*i);
+        }
+    }
+
+    // Sets the size of an element
+    void SetSize(int key, std::size_t size) { m_sizes[key] = size; }
+
+    // Returns the number of calls to StartRead()
+    std::size_t GetReadCount() const { return m_readCount; }
+
+    // Returns true if every byte of an element is the low byte of its key
+    static bool IsIntact(int key, unsigned char const * pElement, std::size_t size)
+    {
+        return std::count(pElement, pElement + size, (unsigned char)key) == (std::ptrdiff_t)size;
+    }
+
+protected:
+
+    virtual std::size_t SizeOf(int const & key) override
+    {
+        std::map<int, std::size_t>::const_iterator i = m_sizes.find(key);
+        return (i != m_sizes.end()) ? i->second : m_size;
+    }
+
+    virtual void StartRead(Block * pBlock) override
+    {
+        ++m_readCount;
+        if (m_synchronous)
+        {
+            Fill(pBlock);
+            this->ReadCompleted(pBlock);
+        }
+        else
+        {
+            m_pending.push_back(pBlock);
+        }
+    }
+
+    virtual void CancelRead(Block * pBlock) override
+    {
+        m_pending.erase(std::remove(m_pending.begin(), m_pending.end(), pBlock), m_pending.end());
+    }
+
+private:
+
+    static void Fill(Block * pBlock)
+    {
+        std::memset(pBlock->pMemory, (unsigned char)pBlock->key, pBlock->size);
+    }
+
+    std::size_t m_size;                 // Size of the elements without a size of their own
+    std::map<int, std::size_t> m_sizes; // Sizes of the elements
+    bool m_synchronous;                 // True if reads complete immediately
+    std::vector<Block *> m_pending;     // Reads in progress
+    std::size_t m_readCount;            // Number of calls to StartRead()
+};
+
+// Returns the size classes of a slab allocator: a number of slots of a size, followed by a number of smaller slots
+// (if smallCount is not 0)
+inline std::vector<SlabAllocator<>::SizeClass> SlabClasses(std::size_t size, std::size_t count,
+                                                          std::size_t smallSize = 0, std::size_t smallCount = 0)
+{
+    std::vector<SlabAllocator<>::SizeClass> classes;
+    SlabAllocator<>::SizeClass              large = { size, count };
+    classes.push_back(large);
+    if (smallCount > 0)
+    {
+        SlabAllocator<>::SizeClass small = { smallSize, smallCount };
+        classes.push_back(small);
+    }
+    return classes;
+}
@@ -0,0 +1,94 @@
+#include "TestCache.h"
+
+#include <AsynchronousCache/Tracer.h>
+
+#include <gtest/gtest.h>
+
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+// A tracer with state, which takes the space of a pointer
+struct PointerTracer
+{
+    template <typename K>
+    void Trace(TraceEvent /* event */, K const & /* key */, std::size_t /* hash */, std::size_t /* size */)
+    {
+    }
+
+    void * p;
+};
+
+} // anonymous namespace
+
+TEST(Tracer, AnEmptyTracerAndHashTakeNoSpace)
+{
+    typedef AsynchronousCache<int, int, TestLoad *> Untraced;
+    typedef AsynchronousCache<int, int, TestLoad *, KeyHash<int>, PointerTracer> Traced;
+    EXPECT_EQ(sizeof(Traced), sizeof(Untraced) + sizeof(void *));
+}
+
+TEST(Tracer, RingBufferRecordsTheCachesEvents)
+{
+    TracedTestCache<RingBufferTracer> cache;
+
+    EXPECT_TRUE(cache.Request(1));
+    cache.Complete(1);
+    cache.Update();
+    cache.Release(1);
+
+    std::vector<RingBufferTracer::TraceRecord> records;
+    EXPECT_EQ(cache.GetTracer().Drain(records), 3u);
+    ASSERT_EQ(records.size(), 3u);
+    EXPECT_EQ(records[0].event, (std::uint64_t)TRACE_FETCH);
+    EXPECT_EQ(records[1].event, (std::uint64_t)TRACE_PROMOTE);
+    EXPECT_EQ(records[2].event, (std::uint64_t)TRACE_RELEASE);
+    EXPECT_EQ(records[0].hash, (std::uint64_t)std::hash<int>()(1));
+    EXPECT_LE(records[0].time, records[2].time);
+
+    EXPECT_EQ(cache.GetTracer().Drain(records), 0u);
+}
+
+TEST(Tracer, RingBufferOverwritesTheOldestRecords)
+{
+    RingBufferTracer tracer(3);
+    EXPECT_EQ(tracer.GetCapacity(), 4u);
+
+    for (std::size_t i = 0; i < 10; ++i)
+    {
+        tracer.Trace(TRACE_FETCH, 0, i, 0);
+    }
+
+    std::vector<RingBufferTracer::TraceRecord> records;
+    EXPECT_EQ(tracer.Drain(records), 4u);
+    EXPECT_EQ(records.front().hash, 6u);
+    EXPECT_EQ(records.back().hash, 9u);
+    EXPECT_EQ(tracer.GetDropped(), 6u);
+}
+
+TEST(Tracer, RingBufferAcceptsConcurrentWriters)
+{
+    RingBufferTracer tracer(8192);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&tracer] {
+            for (std::size_t i = 0; i < 1000; ++i)
+            {
+                tracer.Trace(TRACE_EVICT, 0, i, 1);
+            }
+        });
+    }
+    for (std::vector<std::thread>::iterator i = threads.begin(); i != threads.end(); ++i)
+    {
+        i->join();
+    }
+
+    std::vector<RingBufferTracer::TraceRecord> records;
+    EXPECT_EQ(tracer.Drain(records), 4000u);
+    EXPECT_EQ(tracer.GetDropped(), 0u);
+}
@@ -0,0 +1,114 @@
+#include "TestCache.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+
+namespace
+{
+
+// Returns the total number of entries counted by a usage
+template <typename Usage>
+std::size_t CountOf(Usage const & usage)
+{
+    return usage.requested + usage.prefetched + usage.available + usage.released;
+}
+
+} // anonymous namespace
+
+TEST(Usage, EmptyCache)
+{
+    TestCache cache;
+    TestCache::Usage usage = cache.GetUsage();
+    EXPECT_EQ(CountOf(usage), 0u);
+    EXPECT_EQ(usage.requestedBytes + usage.prefetchedBytes + usage.availableBytes + usage.releasedBytes, 0u);
+    EXPECT_GE(usage.overheadBytes, sizeof(AsynchronousCache<int, int, TestLoad *>));
+}
+
+TEST(Usage, FollowsEveryStateTransition)
+{
+    TestCache cache;
+    cache.SetSize(1, 100);
+    cache.SetSize(2, 20);
+
+    EXPECT_TRUE(cache.Request(1));
+    EXPECT_TRUE(cache.Prefetch(2));
+    TestCache::Usage usage = cache.GetUsage();
+    EXPECT_EQ(usage.requested, 1u);
+    EXPECT_EQ(usage.requestedBytes, 100u);
+    EXPECT_EQ(usage.prefetched, 1u);
+    EXPECT_EQ(usage.prefetchedBytes, 20u);
+
+    // Requested -> available
+
+    cache.Complete(1);
+    cache.Update();
+    usage = cache.GetUsage();
+    EXPECT_EQ(usage.requested, 0u);
+    EXPECT_EQ(usage.available, 1u);
+    EXPECT_EQ(usage.availableBytes, 100u);
+
+    // Prefetched -> requested -> available
+
+    EXPECT_TRUE(cache.Request(2));
+    usage = cache.GetUsage();
+    EXPECT_EQ(usage.prefetched, 0u);
+    EXPECT_EQ(usage.requested, 1u);
+    EXPECT_EQ(usage.requestedBytes, 20u);
+    cache.Complete(2);
+    cache.Update();
+    EXPECT_EQ(cache.GetUsage().availableBytes, 120u);
+
+    // Available -> released -> available (reloaded) -> released -> evicted
+
+    cache.Release(1);
+    usage = cache.GetUsage();
+    EXPECT_EQ(usage.available, 1u);
+    EXPECT_EQ(usage.released, 1u);
+    EXPECT_EQ(usage.releasedBytes, 100u);
+
+    EXPECT_TRUE(cache.Request(1));
+    EXPECT_EQ(cache.GetUsage().released, 0u);
+    EXPECT_EQ(cache.GetUsage().availableBytes, 120u);
+
+    cache.Release(1);
+    cache.Release(2, true);
+    usage = cache.GetUsage();
+    EXPECT_EQ(CountOf(usage), 1u);
+    EXPECT_EQ(usage.released, 1u);
+    EXPECT_EQ(usage.availableBytes, 0u);
+
+    cache.Clear();
+    usage = cache.GetUsage();
+    EXPECT_EQ(CountOf(usage), 0u);
+    EXPECT_EQ(usage.releasedBytes, 0u);
+}
+
+TEST(Usage, QueuedAndFailedLoads)
+{
+    TestCache cache(1);
+    cache.SetLoadLimits(1);
+
+    EXPECT_TRUE(cache.Request(1));
+    EXPECT_TRUE(cache.Request(2, std::chrono::steady_clock::now() + std::chrono::seconds(1)));
+    EXPECT_EQ(cache.GetUsage().requested, 2u);
+
+    // A request that fails leaves no entry behind
+
+    EXPECT_FALSE(cache.Request(3));
+    EXPECT_EQ(cache.GetUsage().requested, 2u);
+
+    cache.Release(2);
+    EXPECT_EQ(cache.GetUsage().requested, 1u);
+}
+
+TEST(Usage, OverheadGrowsWithTheEntries)
+{
+    TestCache cache;
+    std::size_t empty = cache.GetUsage().overheadBytes;
+    for (int key = 0; key < 100; ++key)
+    {
+        EXPECT_TRUE(cache.Request(key));
+    }
+    EXPECT_GE(cache.GetUsage().overheadBytes, empty + 100 * sizeof(int));
+}
@@ -0,0 +1,479 @@
+/** @file *//********************************************************************************************************
+
+                                                  CacheBenchmark.cpp
+
+                                            Copyright 2006, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/AsynchronousCache/tools/CacheBenchmark.cpp#1 $
+
+    $NoKeywords: $
+
+********************************************************************************************************************/
+
+//! Measures how a ShardedCache scales with the number of threads using it.
+//!
+//! Usage: CacheBenchmark [--threads <count>,<count>,...] [--seconds <seconds>] [--keys <count>] [--zipf <exponent>]
+//!                       [--capacity <elements>] [--shards <count>] [--numa] [--mix <get>:<request>:<release>]
+//!                       [--hold <count>]
+//!
+//! For each thread count (1, 2, 4, ... 64 by default), the threads call the cache as fast as they can for a fixed
+//! time (1 s by default). Each call is chosen at random according to the mix of Get(), Request(), and Release()
+//! calls (by default 80:10:10), and the key of each Get() and Request() is drawn from a Zipfian distribution over
+//! the keys (100000 keys with an exponent of 0.99 by default), so a few keys are hot and contended. The backend is
+//! synchronous and holds a fixed number of elements (4096 by default), divided evenly among the shards (16 per node
+//! by default), so requests for cold keys evict other elements.
+//!
+//! Like a real user of the cache, each thread releases only the elements it has requested, and reads each one with
+//! Get() before releasing it (a requested element that is released unread is evicted at once). The keys of a
+//! thread's successful requests wait in a queue, and a Release() call reads and releases the oldest of them (or is
+//! skipped if there is none). A thread holds at most a few elements at a time (8 by default), so a request beyond
+//! that first releases the oldest element. The elements still held when the time is up are released before the
+//! next thread count.
+//!
+//! The tool reports the throughput at each thread count, its scaling relative to one thread, the fraction of the
+//! requests that failed for lack of room, and the median, 99th, and 99.9th percentile latency of each type of call.
+//! One thread is always measured first, even if it is not listed, as the baseline of the scaling. Every call is
+//! timed, which adds the cost of reading the clock twice to each call.
+
+#include <AsynchronousCache/AsynchronousCache.h>
+#include <AsynchronousCache/LatencyHistogram.h>
+#include <AsynchronousCache/ShardedCache.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+// An element of the benchmark cache
+struct BenchmarkElement
+{
+    std::uint64_t value;    // Contents of the element
+};
+
+// A cache with a synchronous backend that holds a fixed number of elements
+class BenchmarkCache : public AsynchronousCache<BenchmarkElement, std::uint64_t, BenchmarkElement *>
+{
+public:
+
+    explicit BenchmarkCache(std::size_t capacity)
+        : m_elements(capacity),
+        m_free(capacity)
+    {
+        for (std::size_t i = 0; i < capacity; ++i)
+        {
+            m_free[i] = &m_elements[i];
+        }
+    }
+
+    virtual ~BenchmarkCache()
+    {
+        Clear();
+    }
+
+protected:
+
+    virtual BenchmarkElement * Load(std::uint64_t const & key) override
+    {
+        BenchmarkElement * pElement = m_free.back();
+        m_free.pop_back();
+        pElement->value = key;
+        return pElement;
+    }
+
+    virtual void Unload(BenchmarkElement * const & pElement) override
+    {
+        m_free.push_back(pElement);
+    }
+
+    virtual bool HasRoomFor(std::uint64_t const & /* key */) override
+    {
+        return !m_free.empty();
+    }
+
+    virtual BenchmarkElement * GetElement(BenchmarkElement * const & pElement) override
+    {
+        return pElement;
+    }
+
+private:
+
+    std::vector<BenchmarkElement> m_elements;   // Storage for the elements
+    std::vector<BenchmarkElement *> m_free;     // Elements not in use
+};
+
+typedef ShardedCache<BenchmarkCache> Cache;
+
+// Types of calls
+enum Operation
+{
+    OPERATION_GET,
+    OPERATION_REQUEST,
+    OPERATION_RELEASE,
+    OPERATION_COUNT
+};
+
+char const * const OPERATION_NAMES[OPERATION_COUNT] = { "get", "request", "release" };
+
+// Number of calls prepared for each thread before it starts. The calls are repeated in order.
+std::size_t const SCRIPT_LENGTH = 1 << 16;
+
+// A call prepared for a thread
+struct Call
+{
+    std::uint64_t key;      // The key
+    Operation operation;    // The call
+};
+
+// The results of a thread
+struct ThreadResult
+{
+    LatencyHistogram latency[OPERATION_COUNT];  // Latencies of each type of call, in nanoseconds
+    unsigned long long calls;                   // Number of calls
+    unsigned long long failures;                // Number of requests that failed
+};
+
+// Prepares the calls of a thread. Keys are drawn from a Zipfian distribution by inverting its CDF.
+void Prepare(std::vector<double> const & cdf, unsigned const mix[OPERATION_COUNT], unsigned seed,
+             std::vector<Call> & script)
+{
+    std::mt19937_64                         random(seed);
+    std::uniform_real_distribution<double>  uniform(0.0, 1.0);
+    std::uniform_int_distribution<unsigned> choice(0, mix[OPERATION_GET] + mix[OPERATION_REQUEST] +
+                                                      mix[OPERATION_RELEASE] - 1);
+
+    script.resize(SCRIPT_LENGTH);
+    for (std::vector<Call>::iterator c = script.begin(); c != script.end(); ++c)
+    {
+        double   u    = uniform(random) * cdf.back();
+        unsigned pick = choice(random);
+        c->key        = (std::uint64_t)(std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin());
+        if (pick < mix[OPERATION_GET])
+        {
+            c->operation = OPERATION_GET;
+        }
+        else if (pick < mix[OPERATION_GET] + mix[OPERATION_REQUEST])
+        {
+            c->operation = OPERATION_REQUEST;
+        }
+        else
+        {
+            c->operation = OPERATION_RELEASE;
+        }
+    }
+}
+
+// Makes a call and records its latency. Returns false if it was a request that failed.
+bool Time(Cache & cache, Operation operation, std::uint64_t key, ThreadResult & result)
+{
+    bool ok = true;
+
+    std::chrono::steady_clock::time_point before = std::chrono::steady_clock::now();
+    switch (operation)
+    {
+        case OPERATION_GET:
+            cache.Get(key);
+            break;
+
+        case OPERATION_REQUEST:
+            ok = cache.Request(key);
+            break;
+
+        default:
+            cache.Release(key);
+            break;
+    }
+    std::chrono::steady_clock::time_point after = std::chrono::steady_clock::now();
+
+    result.latency[operation].Record(
+        (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(after - before).count());
+    ++result.calls;
+    return ok;
+}
+
+// Reads and releases the oldest element held by a thread
+void ReleaseOldest(Cache & cache, std::deque<std::uint64_t> & held, ThreadResult & result)
+{
+    Time(cache, OPERATION_GET, held.front(), result);
+    Time(cache, OPERATION_RELEASE, held.front(), result);
+    held.pop_front();
+}
+
+// Calls the cache until told to stop. At most @a hold requested elements are held at a time.
+void Run(Cache & cache, std::vector<Call> const & script, std::size_t hold, std::atomic<bool> const & start,
+         std::atomic<bool> const & stop, ThreadResult & result)
+{
+    while (!start.load(std::memory_order_acquire))
+    {
+        std::this_thread::yield();
+    }
+
+    std::deque<std::uint64_t> held;     // Keys requested and not released yet, oldest first
+    std::size_t               i = 0;
+    while (!stop.load(std::memory_order_relaxed))
+    {
+        Call const & call = script[i];
+        i = (i + 1) & (SCRIPT_LENGTH - 1);
+
+        switch (call.operation)
+        {
+            case OPERATION_GET:
+                Time(cache, OPERATION_GET, call.key, result);
+                break;
+
+            case OPERATION_REQUEST:
+                if (held.size() >= hold)
+                {
+                    ReleaseOldest(cache, held, result);
+                }
+                if (Time(cache, OPERATION_REQUEST, call.key, result))
+                {
+                    held.push_back(call.key);
+                }
+                else
+                {
+                    ++result.failures;
+                }
+                break;
+
+            default:
+                if (!held.empty())
+                {
+                    ReleaseOldest(cache, held, result);
+                }
+                break;
+        }
+    }
+
+    // Release the elements still held, so that the next run starts with none
+
+    for (std::deque<std::uint64_t>::const_iterator k = held.begin(); k != held.end(); ++k)
+    {
+        cache.Release(*k);
+    }
+}
+
+// Parses a list of numbers separated by a character. Returns false if the list is malformed.
+bool ParseList(char const * p, char separator, std::vector<unsigned long long> & values)
+{
+    values.clear();
+    while (*p != 0)
+    {
+        char * pEnd;
+        values.push_back(std::strtoull(p, &pEnd, 10));
+        if (pEnd == p || (*pEnd != 0 && *pEnd != separator))
+        {
+            return false;
+        }
+        p = (*pEnd == separator) ? pEnd + 1 : pEnd;
+    }
+    return !values.empty();
+}
+
+// Prints the usage and exits
+void Usage()
+{
+    std::fprintf(stderr,
+                 "Usage: CacheBenchmark [--threads <count>,<count>,...] [--seconds <seconds>] [--keys <count>] "
+                 "[--zipf <exponent>] [--capacity <elements>] [--shards <count>] [--numa] "
+                 "[--mix <get>:<request>:<release>] [--hold <count>]\n");
+    std::exit(2);
+}
+
+} // anonymous namespace
+
+int main(int argc, char ** argv)
+{
+    std::vector<unsigned long long> threadCounts;
+    double                          seconds  = 1.0;
+    std::size_t                     keys     = 100000;
+    double                          exponent = 0.99;
+    std::size_t                     capacity = 4096;
+    std::size_t                     shards   = 16;
+    bool                            numa     = false;
+    std::size_t                     hold     = 8;
+    unsigned                        mix[OPERATION_COUNT] = { 80, 10, 10 };
+
+    for (unsigned long long n = 1; n <= 64; n *= 2)
+    {
+        threadCounts.push_back(n);
+    }
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--numa") == 0)
+        {
+            numa = true;
+        }
+        else if (i + 1 < argc && std::strcmp(argv[i], "--threads") == 0)
+        {
+            if (!ParseList(argv[++i], ',', threadCounts))
+            {
+                Usage();
+            }
+        }
+        else if (i + 1 < argc && std::strcmp(argv[i], "--seconds") == 0)
+        {
+            seconds = std::strtod(argv[++i], 0);
+        }
+        else if (i + 1 < argc && std::strcmp(argv[i], "--keys") == 0)
+        {
+            keys = (std::size_t)std::strtoull(argv[++i], 0, 10);
+        }
+        else if (i + 1 < argc && std::strcmp(argv[i], "--zipf") == 0)
+        {
+            exponent = std::strtod(argv[++i], 0);
+        }
+        else if (i + 1 < argc && std::strcmp(argv[i], "--capacity") == 0)
+        {
+            capacity = (std::size_t)std::strtoull(argv[++i], 0, 10);
+        }
+        else if (i + 1 < argc && std::strcmp(argv[i], "--shards") == 0)
+        {
+            shards = (std::size_t)std::strtoull(argv[++i], 0, 10);
+        }
+        else if (i + 1 < argc && std::strcmp(argv[i], "--hold") == 0)
+        {
+            hold = (std::size_t)std::strtoull(argv[++i], 0, 10);
+        }
+        else if (i + 1 < argc && std::strcmp(argv[i], "--mix") == 0)
+        {
+            std::vector<unsigned long long> values;
+            if (!ParseList(argv[++i], ':', values) || values.size() != OPERATION_COUNT)
+            {
+                Usage();
+            }
+            for (int op = 0; op < OPERATION_COUNT; ++op)
+            {
+                mix[op] = (unsigned)values[op];
+            }
+        }
+        else
+        {
+            Usage();
+        }
+    }
+    if (seconds <= 0.0 || keys == 0 || shards == 0 || hold == 0 || mix[0] + mix[1] + mix[2] == 0 ||
+        std::find(threadCounts.begin(), threadCounts.end(), 0ull) != threadCounts.end())
+    {
+        Usage();
+    }
+
+    // The scaling is relative to one thread, so one thread is always measured first
+
+    threadCounts.erase(std::remove(threadCounts.begin(), threadCounts.end(), 1ull), threadCounts.end());
+    threadCounts.insert(threadCounts.begin(), 1ull);
+
+    // The probability of the key of rank k is proportional to 1 / k^exponent
+
+    std::vector<double> cdf(keys);
+    double              sum = 0.0;
+    for (std::size_t k = 0; k < keys; ++k)
+    {
+        sum   += 1.0 / std::pow((double)(k + 1), exponent);
+        cdf[k] = sum;
+    }
+
+    std::size_t perShard = std::max<std::size_t>(capacity / shards, 1);
+    Cache       cache(shards,
+                      [perShard](std::size_t, std::size_t)
+                      {
+                          return std::unique_ptr<BenchmarkCache>(new BenchmarkCache(perShard));
+                      },
+                      numa);
+
+    std::printf("%zu keys (Zipf %.2f), %zu elements in %zu shards on %zu node(s), mix %u:%u:%u, hold %zu, "
+                "%u hardware threads\n",
+                keys, exponent, perShard * cache.GetShardCount(), cache.GetShardCount(), cache.GetNodeCount(),
+                mix[0], mix[1], mix[2], hold, std::thread::hardware_concurrency());
+    std::printf("%7s %12s %8s %9s", "threads", "calls/s", "scaling", "failures");
+    for (int op = 0; op < OPERATION_COUNT; ++op)
+    {
+        std::printf("  %7s p50/p99/p999 ns", OPERATION_NAMES[op]);
+    }
+    std::printf("\n");
+
+    double baseline = 0.0;  // Throughput of one thread
+    for (std::vector<unsigned long long>::const_iterator n = threadCounts.begin(); n != threadCounts.end(); ++n)
+    {
+        std::size_t                                count = (std::size_t)*n;
+        std::vector<std::vector<Call>>             scripts(count);
+        std::vector<std::unique_ptr<ThreadResult>> results(count);
+        for (std::size_t t = 0; t < count; ++t)
+        {
+            Prepare(cdf, mix, (unsigned)(t + 1), scripts[t]);
+            results[t].reset(new ThreadResult());
+        }
+
+        std::atomic<bool>        start(false);
+        std::atomic<bool>        stop(false);
+        std::vector<std::thread> threads;
+        for (std::size_t t = 0; t < count; ++t)
+        {
+            threads.push_back(std::thread(Run, std::ref(cache), std::cref(scripts[t]), hold, std::cref(start),
+                                          std::cref(stop), std::ref(*results[t])));
+        }
+
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        start.store(true, std::memory_order_release);
+        std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+        stop.store(true, std::memory_order_relaxed);
+        for (std::vector<std::thread>::iterator t = threads.begin(); t != threads.end(); ++t)
+        {
+            t->join();
+        }
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        LatencyHistogram   latency[OPERATION_COUNT];
+        unsigned long long calls    = 0;
+        unsigned long long failures = 0;
+        for (std::size_t t = 0; t < count; ++t)
+        {
+            for (int op = 0; op < OPERATION_COUNT; ++op)
+            {
+                latency[op].Merge(results[t]->latency[op]);
+            }
+            calls    += results[t]->calls;
+            failures += results[t]->failures;
+        }
+        unsigned long long requests = latency[OPERATION_REQUEST].GetCount();
+
+        double throughput = (double)calls / elapsed;
+        if (baseline == 0.0)
+        {
+            baseline = throughput;
+        }
+
+        std::printf("%7zu %12.0f %7.2fx %8.2f%%", count, throughput, throughput / baseline,
+                    (requests > 0) ? 100.0 * (double)failures / (double)requests : 0.0);
+        for (int op = 0; op < OPERATION_COUNT; ++op)
+        {
+            std::printf("  %8llu/%6llu/%7llu",
+                        latency[op].GetPercentile(50.0), latency[op].GetPercentile(99.0),
+                        latency[op].GetPercentile(99.9));
+        }
+        std::printf("\n");
+    }
+
+    Cache::Statistics statistics = cache.GetStatistics();
+    unsigned long long requests  = statistics.requestHits + statistics.prefetchHits + statistics.reloads +
+                                   statistics.requestMisses;
+    std::printf("request hit ratio %.4f, request failures %llu (%.4f), evictions %llu\n",
+                (requests > 0) ? 1.0 - (double)statistics.requestMisses / (double)requests : 0.0,
+                statistics.requestFailures,
+                (requests > 0) ? (double)statistics.requestFailures / (double)requests : 0.0,
+                statistics.evictions);
+    return 0;
+}
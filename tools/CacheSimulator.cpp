@@ -0,0 +1,295 @@
+/** @file *//********************************************************************************************************
+
+                                                  CacheSimulator.cpp
+
+                                            Copyright 2006, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/AsynchronousCache/tools/CacheSimulator.cpp#1 $
+
+    $NoKeywords: $
+
+********************************************************************************************************************/
+
+//! Simulates caches of many capacities on a key trace and prints their miss-ratio curves.
+//!
+//! Usage: CacheSimulator <trace> [--text] [--policy <lru|fifo|cache|opt|all>,...] [--capacities <bytes>,<bytes>,...]
+//!                               [--points <count>] [--element-size <bytes>]
+//!
+//! The trace is either an access trace recorded by RecordingCache (each request is an access), or with --text, a
+//! text file with one access per line: a key, optionally followed by the size of the element. Each access is a hit
+//! if the element is in the cache, or a miss that loads it. The policies are:
+//!		- lru:		Least recently used. LRU is a stack algorithm, so every capacity is simulated in a single pass by
+//!					computing the reuse distance (in bytes) of each access.
+//!		- fifo:		First in, first out. FIFO is not a stack algorithm, so each capacity is simulated separately, in
+//!					its own pass over the trace.
+//!		- cache:	AsynchronousCache itself, with a backend of the given capacity. Each access is a request, a get,
+//!					and a release, so the cache evicts the least recently released element first. Each capacity is
+//!					simulated separately.
+//!		- opt:		Belady's MIN, which knows the future: a miss evicts the elements (possibly including the new one)
+//!					whose next accesses are furthest away. It is optimal when the elements are the same size, and
+//!					a close heuristic otherwise. Each capacity is simulated separately.
+//!
+//! Several policies may be listed, separated by commas. When both cache and opt are simulated, the headroom (the
+//! difference between their miss ratios) is printed as well, as the policy "headroom".
+//!
+//! The capacities are listed with --capacities, or there are --points capacities evenly spaced up to the total size
+//! of the distinct elements (20 by default). The output is CSV: the policy, the capacity, the number of accesses
+//! and misses, the miss ratio, and the byte-miss ratio (the fraction of the bytes accessed that were loaded).
+
+#include "CacheSimulator.h"
+
+#include <AsynchronousCache/AccessTrace.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+
+// Loads a trace recorded by RecordingCache. Returns false if it cannot be read.
+bool LoadAccessTrace(char const * path, std::uint64_t elementSize, Trace & trace,
+                     std::unordered_map<std::string, std::uint32_t> & ids)
+{
+    std::FILE * pFile = std::fopen(path, "rb");
+    if (pFile == 0)
+    {
+        return false;
+    }
+
+    AccessTraceReader reader(pFile);
+    AccessRecord      record;
+    while (reader.Read(record))
+    {
+        if (record.op == ACCESS_REQUEST || record.op == ACCESS_REQUEST_DEADLINE)
+        {
+            AddAccess(trace, ids, record.key, (record.size > 0) ? record.size : elementSize);
+        }
+    }
+    bool ok = reader.IsGood();
+    std::fclose(pFile);
+    return ok;
+}
+
+// Loads a text trace. Returns false if it cannot be read.
+bool LoadTextTrace(char const * path, std::uint64_t elementSize, Trace & trace,
+                   std::unordered_map<std::string, std::uint32_t> & ids)
+{
+    std::FILE * pFile = std::fopen(path, "r");
+    if (pFile == 0)
+    {
+        return false;
+    }
+
+    char line[4096];
+    while (std::fgets(line, sizeof(line), pFile))
+    {
+        char * pKey = line + std::strspn(line, " \t");
+        char * pEnd = pKey + std::strcspn(pKey, " \t\r\n");
+        if (pEnd == pKey)
+        {
+            continue;   // Blank line
+        }
+
+        std::uint64_t size = elementSize;
+        if (*pEnd == ' ' || *pEnd == '\t')
+        {
+            std::uint64_t s = std::strtoull(pEnd, 0, 10);
+            if (s > 0)
+            {
+                size = s;
+            }
+        }
+        AddAccess(trace, ids, std::string(pKey, pEnd), size);
+    }
+    std::fclose(pFile);
+    return true;
+}
+
+// Prints the results of a policy
+void Print(char const * policy, Trace const & trace, std::vector<std::uint64_t> const & capacities,
+           std::vector<Result> const & results)
+{
+    for (std::size_t i = 0; i < capacities.size(); ++i)
+    {
+        std::printf("%s,%llu,%llu,%lld,%.6f,%.6f\n",
+                    policy,
+                    (unsigned long long)capacities[i],
+                    (unsigned long long)trace.accesses.size(),
+                    results[i].misses,
+                    trace.accesses.empty() ? 0.0 : (double)results[i].misses / (double)trace.accesses.size(),
+                    (trace.totalBytes == 0) ? 0.0 : (double)results[i].missBytes / (double)trace.totalBytes);
+    }
+}
+
+// Prints the usage and exits
+void Usage()
+{
+    std::fprintf(stderr,
+                 "Usage: CacheSimulator <trace> [--text] [--policy <lru|fifo|cache|opt|all>,...] "
+                 "[--capacities <bytes>,<bytes>,...] [--points <count>] [--element-size <bytes>]\n");
+    std::exit(2);
+}
+
+} // anonymous namespace
+
+int main(int argc, char ** argv)
+{
+    char const *               path        = 0;
+    bool                       text        = false;
+    bool                       lru         = false;
+    bool                       fifo        = false;
+    bool                       cache       = false;
+    bool                       opt         = false;
+    std::vector<std::uint64_t> capacities;
+    std::size_t                points      = 20;
+    std::uint64_t              elementSize = 1;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (argv[i][0] != '-')
+        {
+            path = argv[i];
+        }
+        else if (std::strcmp(argv[i], "--text") == 0)
+        {
+            text = true;
+        }
+        else if (i + 1 < argc && std::strcmp(argv[i], "--policy") == 0)
+        {
+            for (char const * p = argv[++i]; *p != 0; p += (*p == ',') ? 1 : 0)
+            {
+                std::size_t length = std::strcspn(p, ",");
+                std::string name(p, length);
+                if (name == "lru" || name == "all")
+                {
+                    lru = true;
+                }
+                if (name == "fifo" || name == "all")
+                {
+                    fifo = true;
+                }
+                if (name == "cache" || name == "all")
+                {
+                    cache = true;
+                }
+                if (name == "opt" || name == "all")
+                {
+                    opt = true;
+                }
+                if (name != "lru" && name != "fifo" && name != "cache" && name != "opt" && name != "all")
+                {
+                    Usage();
+                }
+                p += length;
+            }
+        }
+        else if (i + 1 < argc && std::strcmp(argv[i], "--capacities") == 0)
+        {
+            for (char const * p = argv[++i]; *p != 0; p += (*p == ',') ? 1 : 0)
+            {
+                char * pEnd;
+                capacities.push_back(std::strtoull(p, &pEnd, 10));
+                if (pEnd == p)
+                {
+                    Usage();
+                }
+                p = pEnd;
+            }
+        }
+        else if (i + 1 < argc && std::strcmp(argv[i], "--points") == 0)
+        {
+            points = (std::size_t)std::strtoull(argv[++i], 0, 10);
+        }
+        else if (i + 1 < argc && std::strcmp(argv[i], "--element-size") == 0)
+        {
+            elementSize = std::strtoull(argv[++i], 0, 10);
+        }
+        else
+        {
+            Usage();
+        }
+    }
+    if (path == 0 || points == 0 || elementSize == 0)
+    {
+        Usage();
+    }
+
+    Trace                                          trace = { std::vector<Access>(), 0, 0, 0 };
+    std::unordered_map<std::string, std::uint32_t> ids;
+    if (!(text ? LoadTextTrace(path, elementSize, trace, ids) : LoadAccessTrace(path, elementSize, trace, ids)))
+    {
+        std::fprintf(stderr, "CacheSimulator: cannot read %s\n", path);
+        return 1;
+    }
+    trace.keyCount = (std::uint32_t)ids.size();
+
+    std::vector<std::uint64_t> sizes(trace.keyCount, 0);
+    for (std::vector<Access>::const_iterator a = trace.accesses.begin(); a != trace.accesses.end(); ++a)
+    {
+        sizes[a->id] = a->size;
+    }
+    for (std::vector<std::uint64_t>::const_iterator s = sizes.begin(); s != sizes.end(); ++s)
+    {
+        trace.distinctBytes += *s;
+    }
+
+    if (capacities.empty())
+    {
+        for (std::size_t i = 1; i <= points; ++i)
+        {
+            capacities.push_back((trace.distinctBytes * i + points - 1) / points);
+        }
+    }
+    std::sort(capacities.begin(), capacities.end());
+    capacities.erase(std::unique(capacities.begin(), capacities.end()), capacities.end());
+
+    if (!lru && !fifo && !cache && !opt)
+    {
+        lru = fifo = cache = opt = true;
+    }
+
+    std::vector<Result> results(capacities.size());
+    std::vector<Result> cacheResults(capacities.size());
+    std::vector<Result> optResults(capacities.size());
+    std::printf("policy,capacity,accesses,misses,miss_ratio,byte_miss_ratio\n");
+    if (lru)
+    {
+        SimulateLru(trace, capacities, results);
+        Print("lru", trace, capacities, results);
+    }
+    if (fifo)
+    {
+        SimulateFifo(trace, capacities, results);
+        Print("fifo", trace, capacities, results);
+    }
+    if (cache)
+    {
+        SimulateCache(trace, capacities, cacheResults);
+        Print("cache", trace, capacities, cacheResults);
+    }
+    if (opt)
+    {
+        SimulateOptimal(trace, capacities, optResults);
+        Print("opt", trace, capacities, optResults);
+    }
+
+    // The headroom is the number of misses that a perfect policy would avoid
+
+    if (cache && opt)
+    {
+        for (std::size_t i = 0; i < capacities.size(); ++i)
+        {
+            results[i].misses    = cacheResults[i].misses - optResults[i].misses;
+            results[i].missBytes = cacheResults[i].missBytes - optResults[i].missBytes;
+        }
+        Print("headroom", trace, capacities, results);
+    }
+    return 0;
+}
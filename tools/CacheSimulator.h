@@ -0,0 +1,337 @@
+/** @file *//********************************************************************************************************
+
+                                                   CacheSimulator.h
+
+                                            Copyright 2006, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/AsynchronousCache/tools/CacheSimulator.h#1 $
+
+    $NoKeywords: $
+
+********************************************************************************************************************/
+
+//! The policies simulated by CacheSimulator (see CacheSimulator.cpp). Each function simulates a policy on a key
+//! trace at a list of capacities, in increasing order, and stores the result for each capacity.
+
+#pragma once
+
+#include <AsynchronousCache/AsynchronousCache.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// An access in the trace
+struct Access
+{
+    std::uint32_t id;   // Dense index of the key
+    std::uint64_t size; // Size of the element
+};
+
+// The result of simulating one capacity
+struct Result
+{
+    long long misses;       // Number of accesses that missed
+    long long missBytes;    // Number of bytes loaded by the misses
+};
+
+// A key trace
+struct Trace
+{
+    std::vector<Access> accesses;   // The accesses, in order
+    std::uint32_t keyCount;         // Number of distinct keys
+    std::uint64_t totalBytes;       // Total size of the accesses
+    std::uint64_t distinctBytes;    // Total size of the distinct elements (the size of the last access of each)
+};
+
+// Adds an access to a trace, assigning a dense index to a new key
+inline void AddAccess(Trace & trace, std::unordered_map<std::string, std::uint32_t> & ids, std::string const & key,
+                      std::uint64_t size)
+{
+    std::pair<std::unordered_map<std::string, std::uint32_t>::iterator, bool> inserted =
+        ids.insert(std::make_pair(key, (std::uint32_t)ids.size()));
+    Access access = { inserted.first->second, size };
+    trace.accesses.push_back(access);
+    trace.totalBytes += size;
+}
+
+// A Fenwick tree of byte counts indexed by time
+class FenwickTree
+{
+public:
+
+    explicit FenwickTree(std::size_t size) : m_tree(size + 1, 0) {}
+
+    // Adds a value at an index
+    void Add(std::size_t index, std::int64_t value)
+    {
+        for (std::size_t i = index + 1; i < m_tree.size(); i += i & (0 - i))
+        {
+            m_tree[i] += value;
+        }
+    }
+
+    // Returns the sum of the values at indexes less than an index
+    std::int64_t Sum(std::size_t index) const
+    {
+        std::int64_t sum = 0;
+        for (std::size_t i = index; i > 0; i -= i & (0 - i))
+        {
+            sum += m_tree[i];
+        }
+        return sum;
+    }
+
+private:
+
+    std::vector<std::int64_t> m_tree;
+};
+
+// Simulates LRU at every capacity in one pass. The reuse distance of an access is the total size of the distinct
+// elements accessed since the previous access of the same key, plus the size of the element. An access hits in an
+// LRU cache exactly when its reuse distance is no more than the capacity.
+inline void SimulateLru(Trace const & trace, std::vector<std::uint64_t> const & capacities,
+                        std::vector<Result> & results)
+{
+    std::size_t const          NEVER = ~std::size_t(0);
+    std::vector<std::size_t>   last(trace.keyCount, NEVER);     // Time of the previous access of each key
+    std::vector<std::uint64_t> lastSize(trace.keyCount, 0);     // Size of the element at its previous access
+    FenwickTree                bytes(trace.accesses.size());    // Sizes of the elements at their previous accesses
+
+    // hits[i] counts the accesses whose smallest capacity that hits is capacities[i]
+
+    std::vector<unsigned long long> hits(capacities.size(), 0);
+    std::vector<unsigned long long> hitBytes(capacities.size(), 0);
+
+    for (std::size_t t = 0; t < trace.accesses.size(); ++t)
+    {
+        Access const & access = trace.accesses[t];
+        std::size_t    prev   = last[access.id];
+        if (prev != NEVER)
+        {
+            std::uint64_t distance = (std::uint64_t)(bytes.Sum(t) - bytes.Sum(prev + 1)) + access.size;
+            std::size_t   i = std::lower_bound(capacities.begin(), capacities.end(), distance) - capacities.begin();
+            if (i < capacities.size())
+            {
+                ++hits[i];
+                hitBytes[i] += access.size;
+            }
+            bytes.Add(prev, -(std::int64_t)lastSize[access.id]);
+        }
+        bytes.Add(t, (std::int64_t)access.size);
+        last[access.id]     = t;
+        lastSize[access.id] = access.size;
+    }
+
+    unsigned long long totalHits     = 0;
+    unsigned long long totalHitBytes = 0;
+    for (std::size_t i = 0; i < capacities.size(); ++i)
+    {
+        totalHits     += hits[i];
+        totalHitBytes += hitBytes[i];
+        results[i].misses    = (long long)(trace.accesses.size() - totalHits);
+        results[i].missBytes = (long long)(trace.totalBytes - totalHitBytes);
+    }
+}
+
+// Simulates FIFO at every capacity, with a separate cache (and a separate pass over the trace) for each capacity
+inline void SimulateFifo(Trace const & trace, std::vector<std::uint64_t> const & capacities,
+                         std::vector<Result> & results)
+{
+    for (std::size_t c = 0; c < capacities.size(); ++c)
+    {
+        std::deque<Access> queue;
+        std::vector<bool>  resident(trace.keyCount, false);
+        std::uint64_t      bytesInUse = 0;
+        Result             result     = { 0, 0 };
+
+        for (std::vector<Access>::const_iterator a = trace.accesses.begin(); a != trace.accesses.end(); ++a)
+        {
+            if (resident[a->id])
+            {
+                continue;
+            }
+
+            ++result.misses;
+            result.missBytes += (long long)a->size;
+            if (a->size > capacities[c])
+            {
+                continue;   // Never fits
+            }
+            while (bytesInUse + a->size > capacities[c])
+            {
+                resident[queue.front().id] = false;
+                bytesInUse -= queue.front().size;
+                queue.pop_front();
+            }
+            queue.push_back(*a);
+            resident[a->id] = true;
+            bytesInUse     += a->size;
+        }
+        results[c] = result;
+    }
+}
+
+// An element of the simulated AsynchronousCache
+struct SimulatedElement
+{
+    std::uint64_t size; // Size of the element
+};
+
+// An AsynchronousCache with a synchronous backend of a fixed capacity
+class SimulatedCache : public AsynchronousCache<SimulatedElement, std::uint32_t, SimulatedElement *>
+{
+public:
+
+    explicit SimulatedCache(std::uint64_t capacity)
+        : m_capacity(capacity),
+        m_bytesInUse(0),
+        m_size(0),
+        m_loads(0)
+    {
+    }
+
+    virtual ~SimulatedCache()
+    {
+        Clear();
+    }
+
+    // Sets the size of the element about to be accessed
+    void SetSize(std::uint64_t size) { m_size = size; }
+
+    // Returns the number of loads
+    unsigned long long GetLoads() const { return m_loads; }
+
+protected:
+
+    virtual SimulatedElement * Load(std::uint32_t const & /* key */) override
+    {
+        SimulatedElement * pElement = new SimulatedElement;
+        pElement->size = m_size;
+        m_bytesInUse  += m_size;
+        ++m_loads;
+        return pElement;
+    }
+
+    virtual void Unload(SimulatedElement * const & pElement) override
+    {
+        m_bytesInUse -= pElement->size;
+        delete pElement;
+    }
+
+    virtual bool HasRoomFor(std::uint32_t const & /* key */) override
+    {
+        return m_bytesInUse + m_size <= m_capacity;
+    }
+
+    virtual SimulatedElement * GetElement(SimulatedElement * const & pElement) override
+    {
+        return pElement;
+    }
+
+    virtual std::size_t SizeOf(std::uint32_t const & /* key */) override
+    {
+        return (std::size_t)m_size;
+    }
+
+private:
+
+    std::uint64_t m_capacity;       // Capacity of the backend in bytes
+    std::uint64_t m_bytesInUse;     // Number of bytes loaded
+    std::uint64_t m_size;           // Size of the element being accessed
+    unsigned long long m_loads;     // Number of loads
+};
+
+// Simulates AsynchronousCache at every capacity, with a separate cache for each capacity
+inline void SimulateCache(Trace const & trace, std::vector<std::uint64_t> const & capacities,
+                          std::vector<Result> & results)
+{
+    for (std::size_t c = 0; c < capacities.size(); ++c)
+    {
+        SimulatedCache cache(capacities[c]);
+        Result         result = { 0, 0 };
+
+        for (std::vector<Access>::const_iterator a = trace.accesses.begin(); a != trace.accesses.end(); ++a)
+        {
+            unsigned long long loads = cache.GetLoads();
+            cache.SetSize(a->size);
+            if (cache.Request(a->id) && cache.Get(a->id) != 0)
+            {
+                cache.Release(a->id);
+            }
+            if (cache.GetLoads() != loads || !cache.IsCached(a->id))
+            {
+                ++result.misses;
+                result.missBytes += (long long)a->size;
+            }
+        }
+        results[c] = result;
+    }
+}
+
+// Simulates Belady's MIN at every capacity, with a separate cache for each capacity
+inline void SimulateOptimal(Trace const & trace, std::vector<std::uint64_t> const & capacities,
+                            std::vector<Result> & results)
+{
+    // Find the time of the next access of the same key after each access
+
+    std::size_t const        NEVER = ~std::size_t(0);
+    std::vector<std::size_t> next(trace.accesses.size(), NEVER);
+    {
+        std::vector<std::size_t> following(trace.keyCount, NEVER);
+        for (std::size_t t = trace.accesses.size(); t-- > 0;)
+        {
+            next[t] = following[trace.accesses[t].id];
+            following[trace.accesses[t].id] = t;
+        }
+    }
+
+    for (std::size_t c = 0; c < capacities.size(); ++c)
+    {
+        // The resident elements are ordered by their next accesses, so the last one is used furthest in the future
+
+        std::set<std::pair<std::size_t, std::uint32_t>> resident;
+        std::vector<std::size_t>   nextUse(trace.keyCount, NEVER);  // Next access of each resident element
+        std::vector<std::uint64_t> sizes(trace.keyCount, 0);        // Size of each resident element (0 if not)
+        std::uint64_t              bytesInUse = 0;
+        Result                     result     = { 0, 0 };
+
+        for (std::size_t t = 0; t < trace.accesses.size(); ++t)
+        {
+            Access const & access = trace.accesses[t];
+            if (sizes[access.id] != 0)
+            {
+                resident.erase(std::make_pair(nextUse[access.id], access.id));
+                nextUse[access.id] = next[t];
+                resident.insert(std::make_pair(next[t], access.id));
+                continue;
+            }
+
+            ++result.misses;
+            result.missBytes += (long long)access.size;
+            if (access.size > capacities[c] || next[t] == NEVER)
+            {
+                continue;   // Never fits, or never used again
+            }
+
+            nextUse[access.id] = next[t];
+            sizes[access.id]   = access.size;
+            bytesInUse        += access.size;
+            resident.insert(std::make_pair(next[t], access.id));
+            while (bytesInUse > capacities[c])
+            {
+                std::set<std::pair<std::size_t, std::uint32_t>>::iterator pFurthest = --resident.end();
+                bytesInUse              -= sizes[pFurthest->second];
+                sizes[pFurthest->second] = 0;
+                resident.erase(pFurthest);
+            }
+        }
+        results[c] = result;
+    }
+}
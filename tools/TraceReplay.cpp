@@ -0,0 +1,318 @@
+/** @file *//********************************************************************************************************
+
+                                                   TraceReplay.cpp
+
+                                            Copyright 2006, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/AsynchronousCache/tools/TraceReplay.cpp#1 $
+
+    $NoKeywords: $
+
+********************************************************************************************************************/
+
+//! Replays an access trace recorded by RecordingCache against a cache with a simulated backend.
+//!
+//! Usage: TraceReplay <trace> [--capacity <bytes>] [--latency-us <microseconds>] [--max-loads <count>]
+//!                            [--element-size <bytes>]
+//!
+//! The backend has a fixed capacity in bytes (0 means unlimited), and every load takes the same time. Time is
+//! simulated: the clock is set to the time of each record before the call is replayed, so a replay is
+//! deterministic and runs as fast as the cache allows. Keys are replayed as strings of their recorded bytes, and
+//! the sizes of the elements are those recorded by Request() and Prefetch() (or --element-size if none was
+//! recorded). The tool reports the cache's statistics, how many Get() calls had a different result than when they
+//! were recorded, and how long the replay took.
+
+#include <AsynchronousCache/AccessTrace.h>
+#include <AsynchronousCache/AsynchronousCache.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+
+namespace
+{
+
+// An element of the simulated cache
+struct ReplayElement
+{
+    std::uint64_t size; // Size of the element
+};
+
+// A load in the simulated backend
+struct ReplayLoad
+{
+    std::uint64_t ready;    // Simulated time when the load completes
+    ReplayElement element;  // The element
+};
+
+// A cache with a simulated backend
+class ReplayCache : public AsynchronousCache<ReplayElement, std::string, ReplayLoad *>
+{
+public:
+
+    ReplayCache(std::uint64_t capacity, std::uint64_t latency, std::uint64_t elementSize)
+        : m_capacity(capacity),
+        m_latency(latency),
+        m_elementSize(elementSize),
+        m_bytesInUse(0),
+        m_now(0)
+    {
+    }
+
+    virtual ~ReplayCache()
+    {
+        Clear();
+    }
+
+    // Sets the simulated time
+    void SetNow(std::uint64_t now) { m_now = now; }
+
+    // Sets the size of an element
+    void SetSize(std::string const & key, std::uint64_t size) { m_sizes[key] = size; }
+
+protected:
+
+    virtual ReplayLoad * Load(std::string const & key) override
+    {
+        ReplayLoad * pLoad = new ReplayLoad;
+        pLoad->ready        = m_now + m_latency;
+        pLoad->element.size = SizeOf(key);
+        m_bytesInUse       += pLoad->element.size;
+        return pLoad;
+    }
+
+    virtual void Unload(ReplayLoad * const & pLoad) override
+    {
+        m_bytesInUse -= pLoad->element.size;
+        delete pLoad;
+    }
+
+    virtual bool HasRoomFor(std::string const & key) override
+    {
+        return m_capacity == 0 || m_bytesInUse + SizeOf(key) <= m_capacity;
+    }
+
+    virtual ReplayElement * GetElement(ReplayLoad * const & pLoad) override
+    {
+        return (m_now >= pLoad->ready) ? &pLoad->element : 0;
+    }
+
+    virtual std::size_t SizeOf(std::string const & key) override
+    {
+        std::unordered_map<std::string, std::uint64_t>::const_iterator i = m_sizes.find(key);
+        return (std::size_t)((i != m_sizes.end() && i->second > 0) ? i->second : m_elementSize);
+    }
+
+private:
+
+    std::uint64_t m_capacity;       // Capacity of the backend in bytes (0 means unlimited)
+    std::uint64_t m_latency;        // Time taken by a load, in nanoseconds
+    std::uint64_t m_elementSize;    // Size of an element whose size was not recorded
+    std::uint64_t m_bytesInUse;     // Number of bytes loaded (or loading)
+    std::uint64_t m_now;            // Simulated time, in nanoseconds
+    std::unordered_map<std::string, std::uint64_t> m_sizes; // Recorded sizes of the elements
+};
+
+// Prints the usage and exits
+void Usage()
+{
+    std::fprintf(stderr,
+                 "Usage: TraceReplay <trace> [--capacity <bytes>] [--latency-us <microseconds>] "
+                 "[--max-loads <count>] [--element-size <bytes>]\n");
+    std::exit(2);
+}
+
+} // anonymous namespace
+
+int main(int argc, char ** argv)
+{
+    char const *  path        = 0;
+    std::uint64_t capacity    = 0;
+    std::uint64_t latency     = 1000;
+    std::uint64_t maxLoads    = 0;
+    std::uint64_t elementSize = 1;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (argv[i][0] != '-')
+        {
+            path = argv[i];
+        }
+        else if (i + 1 < argc && std::strcmp(argv[i], "--capacity") == 0)
+        {
+            capacity = std::strtoull(argv[++i], 0, 10);
+        }
+        else if (i + 1 < argc && std::strcmp(argv[i], "--latency-us") == 0)
+        {
+            latency = std::strtoull(argv[++i], 0, 10);
+        }
+        else if (i + 1 < argc && std::strcmp(argv[i], "--max-loads") == 0)
+        {
+            maxLoads = std::strtoull(argv[++i], 0, 10);
+        }
+        else if (i + 1 < argc && std::strcmp(argv[i], "--element-size") == 0)
+        {
+            elementSize = std::strtoull(argv[++i], 0, 10);
+        }
+        else
+        {
+            Usage();
+        }
+    }
+    if (path == 0)
+    {
+        Usage();
+    }
+
+    std::FILE * pFile = std::fopen(path, "rb");
+    if (pFile == 0)
+    {
+        std::fprintf(stderr, "TraceReplay: cannot open %s\n", path);
+        return 1;
+    }
+
+    AccessTraceReader reader(pFile);
+    if (!reader.IsGood())
+    {
+        std::fprintf(stderr, "TraceReplay: %s is not an access trace\n", path);
+        std::fclose(pFile);
+        return 1;
+    }
+
+    ReplayCache cache(capacity, latency * 1000, elementSize);
+    cache.SetLoadLimits((std::size_t)maxLoads);
+
+    // The addresses returned by Get() are remembered so that releases by address are replayed by address
+
+    std::unordered_map<std::string, ReplayElement *> elements;
+
+    AccessRecord       record;
+    unsigned long long calls[ACCESS_OP_COUNT] = { 0 };
+    unsigned long long diverged  = 0;
+    std::uint64_t      traceTime = 0;
+
+    // Deadlines are replayed relative to the start of the trace, so they do not depend on how fast it is replayed
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point epoch = start;
+    while (reader.Read(record))
+    {
+        ++calls[record.op];
+        traceTime = record.time;
+        cache.SetNow(record.time);
+        if (record.size > 0)
+        {
+            cache.SetSize(record.key, record.size);
+        }
+
+        switch (record.op)
+        {
+            case ACCESS_REQUEST:
+                cache.Request(record.key);
+                break;
+
+            case ACCESS_REQUEST_DEADLINE:
+            {
+                std::chrono::nanoseconds deadline(record.time + record.deadline);
+                cache.Request(record.key, epoch + deadline);
+                break;
+            }
+
+            case ACCESS_PREFETCH:
+                cache.Prefetch(record.key);
+                break;
+
+            case ACCESS_GET:
+            {
+                ReplayElement * pElement = cache.Get(record.key);
+                if ((pElement != 0) != ((record.flags & AccessRecord::FLAG_RESULT) != 0))
+                {
+                    ++diverged;
+                }
+                if (pElement != 0)
+                {
+                    elements[record.key] = pElement;
+                }
+                break;
+            }
+
+            case ACCESS_RELEASE:
+                elements.erase(record.key);
+                cache.Release(record.key, (record.flags & AccessRecord::FLAG_FORCE) != 0);
+                break;
+
+            case ACCESS_RELEASE_POINTER:
+            {
+                std::unordered_map<std::string, ReplayElement *>::iterator i = elements.find(record.key);
+                if (i != elements.end())
+                {
+                    cache.Release(i->second, (record.flags & AccessRecord::FLAG_FORCE) != 0);
+                    elements.erase(i);
+                }
+                else
+                {
+                    cache.Release(record.key, (record.flags & AccessRecord::FLAG_FORCE) != 0);
+                }
+                break;
+            }
+
+            case ACCESS_CLEAR:
+                elements.clear();
+                cache.Clear();
+                break;
+
+            case ACCESS_UPDATE:
+                cache.Update();
+                break;
+
+            default:
+                break;
+        }
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    bool corrupt = !reader.IsGood();
+    std::fclose(pFile);
+
+    unsigned long long total = 0;
+    for (int op = 0; op < ACCESS_OP_COUNT; ++op)
+    {
+        total += calls[op];
+    }
+
+    ReplayCache::Statistics const & statistics = cache.GetStatistics();
+    unsigned long long              gets       = statistics.getHits + statistics.getMisses;
+
+    std::printf("calls             %llu over %.3f s of trace\n", total, (double)traceTime * 1e-9);
+    std::printf("  request         %llu (%llu with deadlines)\n",
+                calls[ACCESS_REQUEST] + calls[ACCESS_REQUEST_DEADLINE], calls[ACCESS_REQUEST_DEADLINE]);
+    std::printf("  prefetch        %llu\n", calls[ACCESS_PREFETCH]);
+    std::printf("  get             %llu\n", calls[ACCESS_GET]);
+    std::printf("  release         %llu (%llu by address)\n",
+                calls[ACCESS_RELEASE] + calls[ACCESS_RELEASE_POINTER], calls[ACCESS_RELEASE_POINTER]);
+    std::printf("  clear           %llu\n", calls[ACCESS_CLEAR]);
+    std::printf("  update          %llu\n", calls[ACCESS_UPDATE]);
+    std::printf("get hit ratio     %.4f\n", (gets > 0) ? (double)statistics.getHits / (double)gets : 0.0);
+    std::printf("get diverged      %llu\n", diverged);
+    std::printf("request hits      %llu\n", statistics.requestHits);
+    std::printf("prefetch hits     %llu\n", statistics.prefetchHits);
+    std::printf("reloads           %llu\n", statistics.reloads);
+    std::printf("request misses    %llu\n", statistics.requestMisses);
+    std::printf("request failures  %llu\n", statistics.requestFailures);
+    std::printf("prefetches        %llu (%llu refused)\n", statistics.prefetches, statistics.prefetchFailures);
+    std::printf("evictions         %llu\n", statistics.evictions);
+    std::printf("replay time       %.3f s (%.1f ns per call)\n",
+                elapsed, (total > 0) ? elapsed * 1e9 / (double)total : 0.0);
+
+    if (corrupt)
+    {
+        std::fprintf(stderr, "TraceReplay: %s is corrupt after %llu calls\n", path, total);
+        return 1;
+    }
+    return 0;
+}